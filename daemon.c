@@ -0,0 +1,415 @@
+/*
+
+    ReadSave: daemon.c
+
+    Copyright (C) 2022  Johnathan K Burchill
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "daemon.h"
+#include "readsave.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <limits.h>
+#include <unistd.h>
+#include <signal.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+static volatile sig_atomic_t stopDaemon = 0;
+
+static void handleStopSignal(int signal)
+{
+    (void)signal;
+    stopDaemon = 1;
+}
+
+static int serveRequest(FileCache *cache, int client);
+static int sendAll(int fd, const char *data, size_t n);
+static int respond(FileCache *cache, char *request, FILE *response);
+
+int runDaemon(char *socketPath, size_t maxCacheBytes)
+{
+    if (socketPath == NULL)
+        return READSAVE_ARGUMENTS;
+
+    struct sockaddr_un address = {0};
+    if (strlen(socketPath) >= sizeof(address.sun_path))
+        return READSAVE_ARGUMENTS;
+
+    int server = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (server < 0)
+        return READSAVE_INPUT_FILE;
+
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, socketPath);
+    unlink(socketPath);
+    if (bind(server, (struct sockaddr*)&address, sizeof(address)) != 0 || listen(server, 16) != 0)
+    {
+        close(server);
+        return READSAVE_INPUT_FILE;
+    }
+
+    // A client hanging up mid-response must not take the daemon down
+    signal(SIGPIPE, SIG_IGN);
+    struct sigaction stopAction = {0};
+    stopAction.sa_handler = handleStopSignal;
+    sigaction(SIGINT, &stopAction, NULL);
+    sigaction(SIGTERM, &stopAction, NULL);
+
+    FileCache cache = {0};
+    cache.maxMemorySize = maxCacheBytes;
+
+    int client = -1;
+    while (!stopDaemon)
+    {
+        client = accept(server, NULL, NULL);
+        if (client < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        // A stalled client must not hold up the others
+        struct timeval timeout = {DAEMON_CLIENT_TIMEOUT_SECONDS, 0};
+        setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        serveRequest(&cache, client);
+        close(client);
+    }
+
+    close(server);
+    unlink(socketPath);
+
+    CacheEntry *entry = cache.entries;
+    CacheEntry *next = NULL;
+    while (entry != NULL)
+    {
+        next = entry->next;
+        freeCacheEntry(entry);
+        entry = next;
+    }
+
+    return READSAVE_OK;
+}
+
+static int serveRequest(FileCache *cache, int client)
+{
+    char request[DAEMON_MAX_REQUEST] = {0};
+    size_t nRead = 0;
+    ssize_t n = 0;
+    while (nRead < sizeof(request) - 1)
+    {
+        n = read(client, request + nRead, sizeof(request) - 1 - nRead);
+        if (n <= 0)
+            break;
+        nRead += n;
+        if (memchr(request, '\n', nRead) != NULL)
+            break;
+    }
+    char *newline = strchr(request, '\n');
+    if (newline == NULL)
+        return READSAVE_ARGUMENTS;
+    *newline = '\0';
+
+    // The response is a status line, then the text the CLI would print
+    char *body = NULL;
+    size_t bodySize = 0;
+    FILE *response = open_memstream(&body, &bodySize);
+    if (response == NULL)
+        return READSAVE_MEM;
+
+    int status = respond(cache, request, response);
+
+    fclose(response);
+    char statusLine[32] = {0};
+    int length = snprintf(statusLine, sizeof(statusLine), "%d\n", status);
+    if (sendAll(client, statusLine, length) == 0)
+        sendAll(client, body, bodySize);
+    free(body);
+
+    return status;
+}
+
+static int sendAll(int fd, const char *data, size_t n)
+{
+    ssize_t nWritten = 0;
+    while (n > 0)
+    {
+        nWritten = write(fd, data, n);
+        if (nWritten < 0 && errno == EINTR)
+            continue;
+        if (nWritten <= 0)
+            return -1;
+        data += nWritten;
+        n -= nWritten;
+    }
+
+    return 0;
+}
+
+static int respond(FileCache *cache, char *request, FILE *response)
+{
+    // <type>\t<file>\t<variable>\t<start>\t<count>
+    char *fields[5] = {0};
+    char *cursor = request;
+    for (int i = 0; i < 5; i++)
+        fields[i] = strsep(&cursor, "\t");
+    if (fields[4] == NULL)
+    {
+        fprintf(response, "Error: malformed request\n");
+        return READSAVE_ARGUMENTS;
+    }
+
+    int requestType = atoi(fields[0]);
+    char *variableName = strlen(fields[2]) > 0 ? fields[2] : NULL;
+    long start = atol(fields[3]);
+    long count = atol(fields[4]);
+
+    int status = READSAVE_OK;
+    CacheEntry *entry = cachedFile(cache, fields[1], &status);
+    if (entry == NULL)
+    {
+        fprintf(response, "Error: unable to read %s (status %d)\n", fields[1], status);
+        return status;
+    }
+
+    Variable *selectedVar = NULL;
+    if (variableName != NULL)
+    {
+        selectedVar = findVariable(&entry->variables, variableName);
+        if (selectedVar == NULL)
+        {
+            fprintf(response, "Error: no variable %s in %s\n", variableName, fields[1]);
+            return READSAVE_ARGUMENTS;
+        }
+    }
+
+    switch (requestType)
+    {
+        case DaemonRequestSummary:
+            fprintf(response, "SAV file created %s by %s.\n", entry->info.date, entry->info.operator);
+            if (selectedVar == NULL)
+            {
+                fprintf(response, "Variables:\n");
+                for (size_t i = 0; i < entry->variables.nVariables; i++)
+                    fprintf(response, " %s\n", entry->variables.variableList[i].name);
+            }
+            else
+                fsummarizeVariable(response, selectedVar);
+            break;
+
+        case DaemonRequestVariable:
+            start = 0;
+            count = -1;
+            // fall through
+        case DaemonRequestSlice:
+            if (selectedVar == NULL)
+            {
+                fprintf(response, "Error: a variable name is required\n");
+                return READSAVE_ARGUMENTS;
+            }
+            status = fprintVariableData(response, selectedVar, start, count);
+            break;
+
+        default:
+            fprintf(response, "Error: unknown request type %d\n", requestType);
+            return READSAVE_ARGUMENTS;
+    }
+
+    return status;
+}
+
+CacheEntry * cachedFile(FileCache *cache, char *filename, int *status)
+{
+    if (cache == NULL || filename == NULL || status == NULL)
+        return NULL;
+
+    struct stat fileInfo = {0};
+    if (stat(filename, &fileInfo) != 0)
+    {
+        *status = READSAVE_INPUT_FILE;
+        return NULL;
+    }
+
+    CacheEntry **link = &cache->entries;
+    CacheEntry *entry = NULL;
+    while (*link != NULL)
+    {
+        entry = *link;
+        if (strcmp(entry->filename, filename) == 0)
+        {
+            if (entry->mtime.tv_sec == fileInfo.st_mtim.tv_sec && entry->mtime.tv_nsec == fileInfo.st_mtim.tv_nsec && entry->fileSize == fileInfo.st_size)
+            {
+                entry->lastUsed = ++cache->useCounter;
+                *status = READSAVE_OK;
+                return entry;
+            }
+            // File changed on disk since it was cached
+            *link = entry->next;
+            cache->memorySize -= entry->memorySize;
+            freeCacheEntry(entry);
+            break;
+        }
+        link = &entry->next;
+    }
+
+    entry = calloc(1, sizeof(CacheEntry));
+    if (entry == NULL)
+    {
+        *status = READSAVE_MEM;
+        return NULL;
+    }
+    entry->filename = strdup(filename);
+    if (entry->filename == NULL)
+    {
+        free(entry);
+        *status = READSAVE_MEM;
+        return NULL;
+    }
+    entry->mtime = fileInfo.st_mtim;
+    entry->fileSize = fileInfo.st_size;
+
+    *status = readSave(filename, &entry->info, &entry->variables);
+    if (*status != READSAVE_OK)
+    {
+        freeCacheEntry(entry);
+        return NULL;
+    }
+
+    entry->memorySize = sizeof(CacheEntry);
+    for (size_t i = 0; i < entry->variables.nVariables; i++)
+        entry->memorySize += variableMemorySize(&entry->variables.variableList[i]);
+    entry->lastUsed = ++cache->useCounter;
+    entry->next = cache->entries;
+    cache->entries = entry;
+    cache->memorySize += entry->memorySize;
+
+    evictCacheEntries(cache, entry);
+
+    return entry;
+}
+
+void evictCacheEntries(FileCache *cache, CacheEntry *keep)
+{
+    if (cache == NULL)
+        return;
+
+    CacheEntry **link = NULL;
+    CacheEntry **oldest = NULL;
+    while (cache->memorySize > cache->maxMemorySize)
+    {
+        oldest = NULL;
+        for (link = &cache->entries; *link != NULL; link = &(*link)->next)
+            if (*link != keep && (oldest == NULL || (*link)->lastUsed < (*oldest)->lastUsed))
+                oldest = link;
+        // A single file larger than the cache is kept until the next request
+        if (oldest == NULL)
+            break;
+        CacheEntry *entry = *oldest;
+        *oldest = entry->next;
+        cache->memorySize -= entry->memorySize;
+        freeCacheEntry(entry);
+    }
+
+    return;
+}
+
+void freeCacheEntry(CacheEntry *entry)
+{
+    if (entry == NULL)
+        return;
+
+    free(entry->filename);
+    freeSaveInfo(&entry->info);
+    freeVariableList(&entry->variables);
+    free(entry);
+
+    return;
+}
+
+int queryDaemon(char *socketPath, int requestType, char *savFile, char *variableName, long start, long count)
+{
+    if (socketPath == NULL || savFile == NULL)
+        return READSAVE_ARGUMENTS;
+
+    struct sockaddr_un address = {0};
+    if (strlen(socketPath) >= sizeof(address.sun_path))
+        return READSAVE_ARGUMENTS;
+
+    // The daemon may have a different working directory
+    char path[PATH_MAX] = {0};
+    if (realpath(savFile, path) == NULL)
+        return READSAVE_INPUT_FILE;
+
+    char request[DAEMON_MAX_REQUEST] = {0};
+    int length = snprintf(request, sizeof(request), "%d\t%s\t%s\t%ld\t%ld\n", requestType, path, variableName == NULL ? "" : variableName, start, count);
+    if (length < 0 || (size_t)length >= sizeof(request))
+        return READSAVE_ARGUMENTS;
+
+    int server = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (server < 0)
+        return READSAVE_INPUT_FILE;
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, socketPath);
+    if (connect(server, (struct sockaddr*)&address, sizeof(address)) != 0)
+    {
+        close(server);
+        return READSAVE_INPUT_FILE;
+    }
+
+    if (write(server, request, length) != length)
+    {
+        close(server);
+        return READSAVE_INPUT_FILE;
+    }
+
+    // The daemon's status line, then its output
+    char buffer[65536];
+    ssize_t n = 0;
+    char statusLine[32] = {0};
+    size_t statusLength = 0;
+    bool haveStatus = false;
+    char *body = NULL;
+    while ((n = read(server, buffer, sizeof(buffer))) > 0)
+    {
+        body = buffer;
+        while (!haveStatus && body < buffer + n)
+        {
+            if (*body == '\n')
+                haveStatus = true;
+            else if (statusLength < sizeof(statusLine) - 1)
+                statusLine[statusLength++] = *body;
+            body++;
+        }
+        if (haveStatus)
+            fwrite(body, 1, buffer + n - body, stdout);
+    }
+    close(server);
+    fflush(stdout);
+
+    char *end = NULL;
+    long status = strtol(statusLine, &end, 10);
+    if (!haveStatus || end == statusLine || *end != '\0')
+        return READSAVE_INPUT_FILE;
+
+    return (int)status;
+}
@@ -0,0 +1,70 @@
+/*
+
+    ReadSave: daemon.h
+
+    Copyright (C) 2022  Johnathan K Burchill
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef _DAEMON_H
+#define _DAEMON_H
+
+#include "readsave.h"
+
+#include <sys/stat.h>
+#include <time.h>
+
+#define DAEMON_DEFAULT_CACHE_MB 1024
+#define DAEMON_MAX_REQUEST 4096
+// A client must send its request, and take the response, within this time
+#define DAEMON_CLIENT_TIMEOUT_SECONDS 5
+
+enum DaemonRequestTypes
+{
+    DaemonRequestSummary = 0,
+    DaemonRequestVariable = 1,
+    DaemonRequestSlice = 2
+};
+
+typedef struct CacheEntry
+{
+    char *filename;
+    struct timespec mtime;
+    off_t fileSize;
+    SaveInfo info;
+    VariableList variables;
+    size_t memorySize;
+    unsigned long lastUsed;
+    struct CacheEntry *next;
+
+} CacheEntry;
+
+typedef struct FileCache
+{
+    CacheEntry *entries;
+    size_t memorySize;
+    size_t maxMemorySize;
+    unsigned long useCounter;
+
+} FileCache;
+
+int runDaemon(char *socketPath, size_t maxCacheBytes);
+int queryDaemon(char *socketPath, int requestType, char *savFile, char *variableName, long start, long count);
+
+CacheEntry * cachedFile(FileCache *cache, char *filename, int *status);
+void evictCacheEntries(FileCache *cache, CacheEntry *keep);
+void freeCacheEntry(CacheEntry *entry);
+
+#endif // _DAEMON_H
@@ -22,7 +22,14 @@
 #define _READSAVE_H
 
 #include <stdlib.h>
+#include <stdio.h>
 #include <stdbool.h>
+#include <stdint.h>
+
+#define READSAVE_STRUCTURE_ELEMENTS_PER_THREAD 4096
+#define READSAVE_MAX_TAG_DEPTH 42
+#define READSAVE_TRANSPOSE_TILE 32
+#define READSAVE_TRANSPOSE_ELEMENTS_PER_THREAD (1L << 20)
 
 enum RecordTypes
 {
@@ -106,12 +113,34 @@ typedef struct Variable
     bool isArray;
     ArrayInfo arrayInfo;
     StructureInfo structInfo;
+    // Numeric scalars are stored here rather than on the heap
+    bool hasInlineData;
+    unsigned char inlineData[16];
+    // Tags left out of a projection keep their description but no data
+    bool skipped;
+    // For filtered structure arrays, the index in the file of each element
+    long *elementIndices;
+    // Array data is in C order, with dims[nDims-1] varying fastest
+    bool rowMajor;
+    // Set when array values were converted on decode from fileDataType
+    // to dataType as value * scaleFactor + addOffset
+    long fileDataType;
+    double scaleFactor;
+    double addOffset;
+    // Hash of a variable's record, see variableRecordHash() in savehash.h;
+    // 0 unless read with ReadSaveOptions.hashRecords
+    uint64_t recordHash;
+    // Set when the name and strings of this variable come from a StringPool;
+    // freeVariable() leaves them to freeStringPool()
+    bool pooledStrings;
 } Variable;
 
 typedef struct VariableList
 {
     Variable *variableList;
     size_t nVariables;
+    // Names and long string values of these variables (see savestrings.h)
+    struct StringPool *stringPool;
 } VariableList;
 
 typedef struct SaveInfo
@@ -121,6 +150,52 @@ typedef struct SaveInfo
 
 } SaveInfo;
 
+enum ReadSaveComparison
+{
+    ReadSaveEqual = 0,
+    ReadSaveNotEqual = 1,
+    ReadSaveLess = 2,
+    ReadSaveLessEqual = 3,
+    ReadSaveGreater = 4,
+    ReadSaveGreaterEqual = 5
+};
+
+// A condition on a scalar tag of a structure array, e.g. SKYMAP.SITE_UID == "rank"
+typedef struct ReadSavePredicate
+{
+    char *tagPath;
+    int comparison;
+    double value;
+    // Compared instead of value for string tags
+    char *string;
+
+} ReadSavePredicate;
+
+typedef struct ReadSaveOptions
+{
+    // Dotted paths of the variables and tags to decode, e.g. SKYMAP.FULL_ELEVATION.
+    // Everything is read when there are none.
+    char **tagPaths;
+    int nTagPaths;
+    // Only structure array elements meeting all predicates are decoded
+    ReadSavePredicate *predicates;
+    int nPredicates;
+    // Numeric arrays of two or more dimensions are decoded in C order
+    // rather than IDL order; the dims are unchanged
+    bool rowMajor;
+    // If DataTypeFloat or DataTypeDouble, real numeric arrays are converted
+    // to that type as value * scaleFactor + addOffset while decoding
+    long convertTo;
+    double scaleFactor;
+    double addOffset;
+    // Upper limit on the threads decoding a large array or structure array;
+    // 0 for one per online processor
+    int nThreads;
+    // Sets each variable's recordHash
+    bool hashRecords;
+
+} ReadSaveOptions;
+
 enum ReadSave
 {
     READSAVE_OK = 0,
@@ -131,11 +206,16 @@ enum ReadSave
     READSAVE_READ_STRUCTURE = 5,
     READSAVE_READ_VARIABLE = 6,
     READSAVE_FILE_VERSION = 7,
-    READSAVE_ARGUMENTS = 8
+    READSAVE_ARGUMENTS = 8,
+    READSAVE_VARIABLE_NOT_FOUND = 9,
+    READSAVE_CORRUPT_RECORD = 10
 
 };
 
 int readSave(char *filename, SaveInfo *info, VariableList *variables);
+int readSaveWithOptions(char *filename, ReadSaveOptions *options, SaveInfo *info, VariableList *variables);
+void readRecordHeader(unsigned char *bytes, long nBytes, long *offset, long *recordType, long *nextOffset);
+bool recordExtentValid(long recordType, long offset, long nextOffset, long nBytes);
 
 int readString(unsigned char *bytes, long nBytes, long *offset, char **str);
 float readFloat(unsigned char *bytes, long nBytes, long *offset);
@@ -155,10 +235,30 @@ int copyStructure(Variable *dst, Variable *src);
 int copyStructureInfo(StructureInfo *dst, StructureInfo *src);
 int readStructure(unsigned char *bytes, long nBytes, long *offset, Variable *variable);
 
+long skipScalar(unsigned char *bytes, long nBytes, long *offset, long dataType);
+long skipArray(unsigned char *bytes, long nBytes, long *offset, Variable *var);
+long skipStructure(unsigned char *bytes, long nBytes, long *offset, Variable *var);
+
 int summarizeVariables(VariableList *variables);
 int summarizeVariable(Variable *var);
 int summarizeStructure(Variable *variable, int indent);
+int fsummarizeVariable(FILE *out, Variable *var);
+int fsummarizeStructure(FILE *out, Variable *variable, int indent);
 Variable * variableData(Variable *variable, char *dottedTagName);
+int tagPath(char *dottedTagName, char **buffer, char **fields, int maxFields);
+Variable * findVariable(VariableList *variables, char *dottedTagName);
+int printVariableData(Variable *var, long start, long count);
+int fprintVariableData(FILE *out, Variable *var, long start, long count);
+char *stringArrayElement(Variable *var, long index);
+long dataTypeSize(long dataType);
 void dataTypeName(long dataType, char *name);
 
+size_t variableMemorySize(Variable *var);
+void freeStructureInfo(StructureInfo *info);
+// Frees var's data and, unless var->pooledStrings, its strings. Elements
+// and tags of a VariableList may be freed this way.
+void freeVariable(Variable *var);
+void freeVariableList(VariableList *variables);
+void freeSaveInfo(SaveInfo *info);
+
 #endif // _READSAVE_H
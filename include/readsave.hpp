@@ -0,0 +1,300 @@
+/*
+
+    ReadSave: include/readsave.hpp
+
+    Copyright (C) 2022  Johnathan K Burchill
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Typed C++17 access to decoded variables. The data type is checked once
+// per array; elements are then read through plain pointers.
+
+#ifndef _READSAVE_HPP
+#define _READSAVE_HPP
+
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+#include <strings.h>
+
+// SaveInfo has a member named operator, which is a C++ keyword
+#define operator operatorName
+extern "C"
+{
+#include "readsave.h"
+}
+#undef operator
+
+namespace readsave
+{
+
+// Element type of each numeric data type as held in memory after decoding
+template <long dataType>
+struct DataTypeTraits
+{
+    static constexpr bool isNumeric = false;
+};
+
+template <typename T>
+struct ElementTraits
+{
+    static constexpr bool isNumeric = false;
+};
+
+#define READSAVE_ELEMENT_TYPE(dataTypeValue, cType) \
+    template <> struct DataTypeTraits<dataTypeValue> \
+    { \
+        static constexpr bool isNumeric = true; \
+        using type = cType; \
+    }; \
+    template <> struct ElementTraits<cType> \
+    { \
+        static constexpr bool isNumeric = true; \
+        static constexpr long dataType = dataTypeValue; \
+    };
+
+READSAVE_ELEMENT_TYPE(DataTypeByte, uint8_t)
+READSAVE_ELEMENT_TYPE(DataTypeInt16, int16_t)
+READSAVE_ELEMENT_TYPE(DataTypeUInt16, uint16_t)
+READSAVE_ELEMENT_TYPE(DataTypeInt32, int32_t)
+READSAVE_ELEMENT_TYPE(DataTypeUInt32, uint32_t)
+READSAVE_ELEMENT_TYPE(DataTypeInt64, int64_t)
+READSAVE_ELEMENT_TYPE(DataTypeUInt64, uint64_t)
+READSAVE_ELEMENT_TYPE(DataTypeFloat, float)
+READSAVE_ELEMENT_TYPE(DataTypeDouble, double)
+READSAVE_ELEMENT_TYPE(DataTypeComplexFloat, std::complex<float>)
+READSAVE_ELEMENT_TYPE(DataTypeComplexDouble, std::complex<double>)
+
+#undef READSAVE_ELEMENT_TYPE
+
+template <typename T>
+constexpr bool isElementType = ElementTraits<std::remove_const_t<T>>::isNumeric;
+
+// Number of elements of a variable, 1 for scalars
+inline long elementCount(const Variable &var)
+{
+    return var.isArray ? var.arrayInfo.nElements : 1;
+}
+
+// A contiguous, non-owning view of the elements of a numeric variable.
+// The view is empty if the variable does not hold elements of type T.
+template <typename T>
+class TypedArray
+{
+    static_assert(isElementType<T>, "TypedArray<T> needs an element type of a numeric DataTypes value");
+
+public:
+    using value_type = std::remove_const_t<T>;
+    using iterator = T *;
+
+    TypedArray() = default;
+    TypedArray(T *data, long size, const ArrayInfo *info, bool rowMajor = false) : elements(data), nElements(size), arrayInfo(info), cOrder(rowMajor) {}
+
+    T *data() const { return elements; }
+    long size() const { return nElements; }
+    bool empty() const { return nElements == 0; }
+    explicit operator bool() const { return elements != nullptr; }
+
+    T &operator[](long index) const { return elements[index]; }
+    iterator begin() const { return elements; }
+    iterator end() const { return elements + nElements; }
+
+    // IDL dimensions, fastest varying first. Scalars have none.
+    long nDims() const { return arrayInfo == nullptr ? 0 : arrayInfo->nDims; }
+    long dim(long index) const { return arrayInfo == nullptr ? 1 : arrayInfo->dims[index]; }
+
+    // Whether the data is in C order (see ReadSaveOptions.rowMajor)
+    bool rowMajor() const { return cOrder; }
+
+    // Indexing of a 2-D array by IDL subscripts, in either order
+    T &operator()(long i, long j) const { return cOrder ? elements[i * dim(1) + j] : elements[i + dim(0) * j]; }
+
+private:
+    T *elements = nullptr;
+    long nElements = 0;
+    const ArrayInfo *arrayInfo = nullptr;
+    bool cOrder = false;
+};
+
+// Scalar strings and string arrays, indexed as for stringArrayElement()
+class StringArray
+{
+public:
+    StringArray() = default;
+    explicit StringArray(Variable *var) : variable(var) {}
+
+    long size() const { return variable == nullptr ? 0 : elementCount(*variable); }
+    explicit operator bool() const { return variable != nullptr; }
+
+    const char *operator[](long index) const
+    {
+        if (!variable->isArray)
+            return static_cast<const char *>(variable->data);
+        return stringArrayElement(variable, index);
+    }
+
+private:
+    Variable *variable = nullptr;
+};
+
+template <typename T>
+TypedArray<T> get(Variable *var)
+{
+    static_assert(isElementType<T>, "get<T>() needs an element type of a numeric DataTypes value");
+
+    if (var == nullptr || var->data == nullptr || var->isStructure || var->dataType != ElementTraits<std::remove_const_t<T>>::dataType)
+        return TypedArray<T>();
+
+    return TypedArray<T>(static_cast<T *>(var->data), elementCount(*var), var->isArray ? &var->arrayInfo : nullptr, var->rowMajor);
+}
+
+// Looks up a dotted name as findVariable() does
+template <typename T>
+TypedArray<T> get(VariableList *variables, const char *dottedTagName)
+{
+    return get<T>(findVariable(variables, const_cast<char *>(dottedTagName)));
+}
+
+inline StringArray getStrings(Variable *var)
+{
+    if (var == nullptr || var->data == nullptr || var->dataType != DataTypeString)
+        return StringArray();
+
+    return StringArray(var);
+}
+
+inline StringArray getStrings(VariableList *variables, const char *dottedTagName)
+{
+    return getStrings(findVariable(variables, const_cast<char *>(dottedTagName)));
+}
+
+// Calls visitor once with the TypedArray matching the data type of a numeric
+// variable, so the per-element loop in the visitor is type specific.
+// Returns false without calling visitor for strings, structures and unread data.
+template <typename Visitor>
+bool visit(Variable *var, Visitor &&visitor)
+{
+    if (var == nullptr || var->data == nullptr || var->isStructure)
+        return false;
+
+    switch (var->dataType)
+    {
+        case DataTypeByte:
+            visitor(get<uint8_t>(var));
+            return true;
+        case DataTypeInt16:
+            visitor(get<int16_t>(var));
+            return true;
+        case DataTypeUInt16:
+            visitor(get<uint16_t>(var));
+            return true;
+        case DataTypeInt32:
+            visitor(get<int32_t>(var));
+            return true;
+        case DataTypeUInt32:
+            visitor(get<uint32_t>(var));
+            return true;
+        case DataTypeInt64:
+            visitor(get<int64_t>(var));
+            return true;
+        case DataTypeUInt64:
+            visitor(get<uint64_t>(var));
+            return true;
+        case DataTypeFloat:
+            visitor(get<float>(var));
+            return true;
+        case DataTypeDouble:
+            visitor(get<double>(var));
+            return true;
+        case DataTypeComplexFloat:
+            visitor(get<std::complex<float>>(var));
+            return true;
+        case DataTypeComplexDouble:
+            visitor(get<std::complex<double>>(var));
+            return true;
+        default:
+            return false;
+    }
+}
+
+// As visit(), skipping complex types so that visitor only needs to handle
+// real numbers
+template <typename Visitor>
+bool visitReal(Variable *var, Visitor &&visitor)
+{
+    if (var == nullptr || var->dataType == DataTypeComplexFloat || var->dataType == DataTypeComplexDouble)
+        return false;
+
+    return visit(var, [&](auto array)
+    {
+        using Element = typename decltype(array)::value_type;
+        if constexpr (std::is_arithmetic_v<Element>)
+            visitor(array);
+    });
+}
+
+// Converts up to count elements to Out, e.g. double, in a single typed loop
+template <typename Out>
+long copyAs(Variable *var, Out *values, long count)
+{
+    long n = 0;
+    visitReal(var, [&](auto array)
+    {
+        n = array.size() < count ? array.size() : count;
+        for (long i = 0; i < n; i++)
+            values[i] = static_cast<Out>(array[i]);
+    });
+
+    return n;
+}
+
+// Tag of a structure by name, without the leading variable name
+inline Variable *tag(Variable *structure, const char *tagName)
+{
+    if (structure == nullptr || !structure->isStructure || structure->isArray || structure->data == nullptr)
+        return nullptr;
+
+    Variable *tags = static_cast<Variable *>(structure->data);
+    for (long i = 0; i < structure->structInfo.nTags; i++)
+        if (tags[i].name != nullptr && strcasecmp(tags[i].name, tagName) == 0)
+            return &tags[i];
+
+    return nullptr;
+}
+
+// Calls function with each element of an array of structures, or with a
+// single structure
+template <typename Function>
+void forEachElement(Variable *var, Function &&function)
+{
+    if (var == nullptr || !var->isStructure || var->data == nullptr)
+        return;
+
+    if (!var->isArray)
+    {
+        function(var);
+        return;
+    }
+
+    Variable *elements = static_cast<Variable *>(var->data);
+    for (long i = 0; i < var->arrayInfo.nElements; i++)
+        function(&elements[i]);
+}
+
+} // namespace readsave
+
+#endif // _READSAVE_HPP
@@ -0,0 +1,115 @@
+/*
+
+    ReadSave: include/savecache.h
+
+    Copyright (C) 2022  Johnathan K Burchill
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef _SAVECACHE_H
+#define _SAVECACHE_H
+
+#include "readsave.h"
+
+#include <stdlib.h>
+#include <stdbool.h>
+
+#define SAVE_CACHE_MAGIC "RSCACHE1"
+#define SAVE_CACHE_INDEX_MAGIC "RSCINDEX"
+#define SAVE_CACHE_BYTE_ORDER 0x0102030405060708L
+#define SAVE_CACHE_ALIGNMENT 64
+#define SAVE_CACHE_NAME_LENGTH 256
+#define SAVE_CACHE_MAX_DIMS 9
+#define SAVE_CACHE_CHUNK_SIZE (1L << 20)
+#define SAVE_CACHE_ZSTD_LEVEL 3
+
+enum SaveCacheCompression
+{
+    SaveCacheCompressionNone = 0,
+    SaveCacheCompressionLZ4 = 1,
+    SaveCacheCompressionZstd = 2
+};
+
+// Cache file layout: header, native-endian columns each aligned to
+// SAVE_CACHE_ALIGNMENT, column index, trailer. Structure array tags are
+// stored as one column per tag (e.g. SKYMAP.FULL_ELEVATION) with the
+// structure element count appended as the slowest dimension.
+// String columns hold nElements + 1 offsets followed by NUL-terminated text.
+// Compressed numeric columns are split into chunks of whole slabs along
+// the slowest dimension; a table of CacheChunk entries follows the chunks.
+typedef struct CacheHeader
+{
+    char magic[8];
+    long byteOrder;
+    char reserved[SAVE_CACHE_ALIGNMENT - 16];
+
+} CacheHeader;
+
+typedef struct CacheColumn
+{
+    char name[SAVE_CACHE_NAME_LENGTH];
+    long dataType;
+    long nBytesPerElement;
+    long nElements;
+    long nDims;
+    long dims[SAVE_CACHE_MAX_DIMS];
+    long dataOffset;
+    long nBytes;
+    long compression;
+    long nChunks;
+    long chunkElements;
+    long chunkTableOffset;
+
+} CacheColumn;
+
+// A chunk stored with nBytes == rawBytes was not compressible and is raw
+typedef struct CacheChunk
+{
+    long offset;
+    long nBytes;
+    long rawBytes;
+
+} CacheChunk;
+
+typedef struct CacheTrailer
+{
+    long nColumns;
+    long indexOffset;
+    char magic[8];
+
+} CacheTrailer;
+
+typedef struct SaveCache
+{
+    int fd;
+    unsigned char *bytes;
+    long nBytes;
+    CacheColumn *columns;
+    long nColumns;
+
+} SaveCache;
+
+// Returns READSAVE_ARGUMENTS if any array was decoded with ReadSaveOptions.rowMajor
+int writeSaveCache(char *filename, VariableList *variables, long *nColumns);
+int writeCompressedSaveCache(char *filename, VariableList *variables, int compression, long chunkSize, long *nColumns);
+bool cacheCompressionAvailable(int compression);
+int openSaveCache(char *filename, SaveCache *cache);
+void closeSaveCache(SaveCache *cache);
+CacheColumn *findCacheColumn(SaveCache *cache, char *name);
+void *cacheColumnData(SaveCache *cache, CacheColumn *column);
+char *cacheString(SaveCache *cache, CacheColumn *column, long index);
+int readCacheColumn(SaveCache *cache, CacheColumn *column, long start, long count, void *buffer, int nThreads);
+
+#endif // _SAVECACHE_H
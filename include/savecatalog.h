@@ -0,0 +1,107 @@
+/*
+
+    ReadSave: include/savecatalog.h
+
+    Copyright (C) 2022  Johnathan K Burchill
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef _SAVECATALOG_H
+#define _SAVECATALOG_H
+
+#include "readsave.h"
+
+#include <stdbool.h>
+
+#define SAVE_CATALOG_MAGIC "RSCATLG1"
+#define SAVE_CATALOG_BYTE_ORDER 0x0102030405060708L
+#define SAVE_CATALOG_MAX_DIMS 8
+#define SAVE_CATALOG_UNKNOWN_TIME (-1L)
+
+// Catalog file layout: header, files sorted by path, entries sorted by name
+// and then file, NUL-terminated strings. Everything is native-endian and is
+// used in place after mmap(). Each variable has an entry, and so does each
+// tag of a structure under its dotted name (e.g. SKYMAP.FULL_ELEVATION).
+typedef struct CatalogHeader
+{
+    char magic[8];
+    long byteOrder;
+    long nFiles;
+    long nEntries;
+    long filesOffset;
+    long entriesOffset;
+    long stringsOffset;
+    long nStringBytes;
+
+} CatalogHeader;
+
+typedef struct CatalogFile
+{
+    long pathOffset;
+    long fileSize;
+    long modificationTime;
+    // Save time in seconds since 1970, SAVE_CATALOG_UNKNOWN_TIME if unknown
+    long timestamp;
+    int status;
+    int nEntries;
+
+} CatalogFile;
+
+typedef struct CatalogEntry
+{
+    long nameOffset;
+    long nElements;
+    int file;
+    int dataType;
+    int flags;
+    int nDims;
+    int dims[SAVE_CATALOG_MAX_DIMS];
+
+} CatalogEntry;
+
+typedef struct SaveCatalog
+{
+    int fd;
+    unsigned char *bytes;
+    long nBytes;
+    CatalogHeader *header;
+    CatalogFile *files;
+    CatalogEntry *entries;
+    char *strings;
+
+} SaveCatalog;
+
+// Conditions of a search; a NULL name, nDims < 0 and unknown times match anything
+typedef struct CatalogQuery
+{
+    char *name;
+    long nDims;
+    long dims[SAVE_CATALOG_MAX_DIMS];
+    long after;
+    long before;
+
+} CatalogQuery;
+
+int buildSaveCatalog(char *filename, char **files, long nFiles, int nThreads, long *nEntries);
+int openSaveCatalog(char *filename, SaveCatalog *catalog);
+void closeSaveCatalog(SaveCatalog *catalog);
+
+char *catalogString(SaveCatalog *catalog, long offset);
+long findCatalogEntries(SaveCatalog *catalog, char *name, long *first);
+bool catalogFileMatches(SaveCatalog *catalog, long file, CatalogQuery *query);
+bool catalogEntryMatches(SaveCatalog *catalog, CatalogEntry *entry, CatalogQuery *query);
+long parseSaveTime(char *text);
+
+#endif // _SAVECATALOG_H
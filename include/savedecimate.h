@@ -0,0 +1,42 @@
+/*
+
+    ReadSave: include/savedecimate.h
+
+    Copyright (C) 2022  Johnathan K Burchill
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef _SAVEDECIMATE_H
+#define _SAVEDECIMATE_H
+
+#include "readsave.h"
+#include "saveview.h"
+
+enum DecimationMode
+{
+    DecimationStride = 0,
+    DecimationBlockMean = 1
+};
+
+// Reduces a real numeric array by factors[d] along each IDL dimension d;
+// dimensions past nFactors are kept. Output dimensions are rounded up.
+// Stride decimation keeps every factors[d]-th value in its own type and reads
+// only those values. Block means are doubles, leaving out NaN values, and
+// edge blocks average the values they cover.
+// The result is an unnamed array Variable, released with freeVariable().
+int decimateArrayView(ArrayView *view, long *factors, int nFactors, int mode, Variable *decimated);
+int decimateVariable(SaveView *view, char *dottedName, long element, long *factors, int nFactors, int mode, Variable *decimated);
+
+#endif // _SAVEDECIMATE_H
@@ -0,0 +1,70 @@
+/*
+
+    ReadSave: include/savefile.h
+
+    Copyright (C) 2022  Johnathan K Burchill
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef _SAVEFILE_H
+#define _SAVEFILE_H
+
+#include "readsave.h"
+#include "savestrings.h"
+
+#define SAVE_FILE_DEFINITION_READ_SIZE (64L * 1024L)
+
+// A variable record and its definition, parsed once when the file is opened
+typedef struct SaveFileRecord
+{
+    char *name;
+    long start;
+    long end;
+    long dataOffset;
+    Variable definition;
+
+} SaveFileRecord;
+
+// An open save file shared by any number of threads. Nothing in it changes
+// after openReadSaveFile() returns; each thread reads through its own
+// ReadSaveContext with pread(), so no locks are taken.
+typedef struct ReadSaveFile
+{
+    int fd;
+    long nBytes;
+    SaveInfo info;
+    SaveFileRecord *records;
+    long nRecords;
+    StringPool *stringPool;
+
+} ReadSaveFile;
+
+// Per-thread scratch buffer for record bytes
+typedef struct ReadSaveContext
+{
+    unsigned char *buffer;
+    long size;
+
+} ReadSaveContext;
+
+int openReadSaveFile(char *filename, ReadSaveFile *file);
+void closeReadSaveFile(ReadSaveFile *file);
+SaveFileRecord *findSaveFileRecord(ReadSaveFile *file, char *variableName);
+
+int readSaveFileVariable(ReadSaveFile *file, ReadSaveContext *context, char *variableName, VariableList *variables);
+int readSaveFileSlice(ReadSaveFile *file, ReadSaveContext *context, char *dottedName, long element, long start, long count, void *values);
+void freeReadSaveContext(ReadSaveContext *context);
+
+#endif // _SAVEFILE_H
@@ -0,0 +1,56 @@
+/*
+
+    ReadSave: include/savehash.h
+
+    Copyright (C) 2022  Johnathan K Burchill
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef _SAVEHASH_H
+#define _SAVEHASH_H
+
+#include "readsave.h"
+#include "saveview.h"
+
+#include <stdint.h>
+
+// Hash of one variable record of a save file
+typedef struct RecordHash
+{
+    char *name;
+    long file;
+    long offset;
+    long nBytes;
+    uint64_t hash;
+
+} RecordHash;
+
+// XXH64 of nBytes bytes; not for security
+uint64_t hashBytes(const void *bytes, long nBytes, uint64_t seed);
+
+// Hash of a variable record from just after its name to its end, i.e. its
+// type, dimensions, any structure definition and its data. Records that
+// hash equal hold the same values, whatever their names.
+uint64_t variableRecordHash(unsigned char *bytes, long recordEnd, long offset);
+
+int hashSaveRecords(SaveView *view, long file, RecordHash **hashes, long *nHashes);
+
+// Hashes the variable records of the files with nThreads threads. The
+// result is sorted by hash, size and file, so duplicates are adjacent.
+// statuses[f] is the status of file f; unreadable files have no hashes.
+int hashSaveFiles(char **files, long nFiles, int nThreads, int *statuses, RecordHash **hashes, long *nHashes);
+void freeRecordHashes(RecordHash *hashes, long nHashes);
+
+#endif // _SAVEHASH_H
@@ -0,0 +1,57 @@
+/*
+
+    ReadSave: include/saveio.h
+
+    Copyright (C) 2022  Johnathan K Burchill
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef _SAVEIO_H
+#define _SAVEIO_H
+
+#include "readsave.h"
+
+#include <stdbool.h>
+#include <pthread.h>
+
+#define READ_PIPELINE_CHUNK_SIZE (4L * 1024L * 1024L)
+#define READ_PIPELINE_READAHEAD_CHUNKS 4
+#define READ_PIPELINE_FILES_IN_FLIGHT 4
+
+// A reader thread fills bytes[] front to back with pread() while the
+// caller parses the records that have already arrived.
+typedef struct ReadPipeline
+{
+    int fd;
+    unsigned char *bytes;
+    long nBytes;
+    long nAvailable;
+    long chunkSize;
+    int status;
+    bool cancel;
+    bool running;
+    pthread_mutex_t mutex;
+    pthread_cond_t arrived;
+    pthread_t thread;
+
+} ReadPipeline;
+
+int startReadPipeline(char *filename, long chunkSize, ReadPipeline *pipeline);
+int waitForBytes(ReadPipeline *pipeline, long nBytes);
+void stopReadPipeline(ReadPipeline *pipeline);
+
+int readSaveFiles(char **filenames, long nFiles, SaveInfo *infos, VariableList *variables, int *statuses, int nInFlight);
+
+#endif // _SAVEIO_H
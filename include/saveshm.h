@@ -0,0 +1,63 @@
+/*
+
+    ReadSave: include/saveshm.h
+
+    Copyright (C) 2022  Johnathan K Burchill
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef _SAVESHM_H
+#define _SAVESHM_H
+
+#include "readsave.h"
+
+#include <stdlib.h>
+
+#define SHARED_VARIABLE_MAGIC "RSSHM001"
+#define SHARED_VARIABLE_ALIGNMENT 64
+#define SHARED_VARIABLE_NAME_LENGTH 256
+
+// Segment layout: descriptor, padding to SHARED_VARIABLE_ALIGNMENT, native-endian data.
+// Dimensions are in IDL order; strides are in bytes, and describe C order
+// data for variables decoded with ReadSaveOptions.rowMajor.
+typedef struct SharedArrayDescriptor
+{
+    char magic[8];
+    long dataType;
+    long nBytesPerElement;
+    long nElements;
+    long nDims;
+    long dims[8];
+    long strides[8];
+    long dataOffset;
+    long nBytes;
+    char variableName[SHARED_VARIABLE_NAME_LENGTH];
+
+} SharedArrayDescriptor;
+
+typedef struct SharedVariable
+{
+    SharedArrayDescriptor *descriptor;
+    void *data;
+    size_t mappedSize;
+
+} SharedVariable;
+
+int exportSharedVariable(Variable *var, char *segmentName, SharedVariable *shared);
+int attachSharedVariable(char *segmentName, SharedVariable *shared);
+int detachSharedVariable(SharedVariable *shared);
+int unlinkSharedVariable(char *segmentName);
+
+#endif // _SAVESHM_H
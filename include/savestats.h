@@ -0,0 +1,53 @@
+/*
+
+    ReadSave: include/savestats.h
+
+    Copyright (C) 2022  Johnathan K Burchill
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef _SAVESTATS_H
+#define _SAVESTATS_H
+
+#include "readsave.h"
+#include "saveview.h"
+
+#define STATS_BLOCK_SIZE 2048
+#define STATS_MIN_ELEMENTS_PER_THREAD (1L << 18)
+
+typedef struct ArrayStats
+{
+    long nValues;
+    long nNaN;
+    double min;
+    double max;
+    double sum;
+    double mean;
+    long nBins;
+    double binMin;
+    double binMax;
+    long *histogram;
+
+} ArrayStats;
+
+int initArrayStats(ArrayStats *stats, long nBins, double binMin, double binMax);
+void freeArrayStats(ArrayStats *stats);
+void finishArrayStats(ArrayStats *stats);
+
+int accumulateArrayStats(ArrayView *view, ArrayStats *stats, int nThreads);
+int readArrayStats(unsigned char *bytes, long nBytes, long *offset, Variable *var, ArrayStats *stats, int nThreads);
+int variableStats(SaveView *view, char *dottedName, ArrayStats *stats, int nThreads);
+
+#endif // _SAVESTATS_H
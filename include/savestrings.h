@@ -0,0 +1,66 @@
+/*
+
+    ReadSave: include/savestrings.h
+
+    Copyright (C) 2022  Johnathan K Burchill
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef _SAVESTRINGS_H
+#define _SAVESTRINGS_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#define STRING_POOL_BLOCK_SIZE (64L * 1024L)
+#define STRING_POOL_INITIAL_SLOTS 1024
+
+typedef struct StringPoolBlock
+{
+    struct StringPoolBlock *next;
+    long size;
+    long used;
+    char bytes[];
+
+} StringPoolBlock;
+
+// Interned, NUL-terminated strings that live until the pool is freed.
+// Equal strings from one pool have equal pointers. poolString() may be
+// called from several threads.
+typedef struct StringPool
+{
+    StringPoolBlock *blocks;
+    char **slots;
+    long nSlots;
+    long nStrings;
+    pthread_mutex_t mutex;
+
+} StringPool;
+
+StringPool *newStringPool(void);
+void freeStringPool(StringPool *pool);
+char *poolString(StringPool *pool, const char *str, long length);
+char *findPooledString(StringPool *pool, const char *str);
+
+// readSave() makes the file's pool active on its thread; strings created
+// with newString() then come from that pool and are released with it.
+// freeString() is for strings made while no pool was active.
+StringPool *setActiveStringPool(StringPool *pool);
+StringPool *activeStringPool(void);
+char *newString(const char *str, long length);
+void freeString(char *str);
+
+#endif // _SAVESTRINGS_H
@@ -0,0 +1,34 @@
+/*
+
+    ReadSave: include/savesummary.h
+
+    Copyright (C) 2022  Johnathan K Burchill
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef _SAVESUMMARY_H
+#define _SAVESUMMARY_H
+
+#include "readsave.h"
+#include "saveview.h"
+
+// Prints the type and dimensions of each variable, or only of variableName,
+// and the layout of each structure once with its element count. Only record
+// headers and definitions are read. With tagStats, numeric arrays and tags
+// also get min, max, mean and NaN count, reduced over all elements by
+// variableStats().
+int summarizeLayout(SaveView *view, char *variableName, bool tagStats, int nThreads);
+
+#endif // _SAVESUMMARY_H
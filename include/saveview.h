@@ -0,0 +1,121 @@
+/*
+
+    ReadSave: include/saveview.h
+
+    Copyright (C) 2022  Johnathan K Burchill
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef _SAVEVIEW_H
+#define _SAVEVIEW_H
+
+#include "readsave.h"
+
+#include <stdint.h>
+#include <string.h>
+
+typedef struct SaveView
+{
+    int fd;
+    unsigned char *bytes;
+    long nBytes;
+
+} SaveView;
+
+// Typed view of big-endian values in a mapped save file. Values are
+// converted only when accessed.
+typedef struct ArrayView
+{
+    unsigned char *bytes;
+    long dataType;
+    long nElements;
+    long stride;
+    long nDims;
+    long dims[8];
+
+} ArrayView;
+
+int openSaveView(char *filename, SaveView *view);
+void closeSaveView(SaveView *view);
+
+int findVariableRecord(SaveView *view, char *variableName, long *dataOffset, Variable *definition);
+int readVariableDefinition(unsigned char *bytes, long nBytes, long *offset, Variable *definition);
+long fileElementSize(long dataType);
+int findTagView(unsigned char *bytes, long nBytes, long *offset, Variable *definition, char **tagFields, int nTagFields, ArrayView *arrayView);
+int findArrayView(SaveView *view, char *dottedName, long element, ArrayView *arrayView);
+
+int viewElement(ArrayView *view, long index, void *value);
+double viewValue(ArrayView *view, long index);
+int materializeRange(ArrayView *view, long start, long count, void *values);
+
+static inline uint8_t viewByte(ArrayView *view, long index)
+{
+    return view->bytes[index * view->stride];
+}
+
+static inline uint16_t viewUInt16(ArrayView *view, long index)
+{
+    // 16-bit values occupy the low half of a big-endian 32-bit word
+    uint16_t value;
+    memcpy(&value, view->bytes + index * view->stride + 2, sizeof(value));
+    return __builtin_bswap16(value);
+}
+
+static inline int16_t viewInt16(ArrayView *view, long index)
+{
+    return (int16_t)viewUInt16(view, index);
+}
+
+static inline uint32_t viewUInt32(ArrayView *view, long index)
+{
+    uint32_t value;
+    memcpy(&value, view->bytes + index * view->stride, sizeof(value));
+    return __builtin_bswap32(value);
+}
+
+static inline int32_t viewInt32(ArrayView *view, long index)
+{
+    return (int32_t)viewUInt32(view, index);
+}
+
+static inline uint64_t viewUInt64(ArrayView *view, long index)
+{
+    uint64_t value;
+    memcpy(&value, view->bytes + index * view->stride, sizeof(value));
+    return __builtin_bswap64(value);
+}
+
+static inline int64_t viewInt64(ArrayView *view, long index)
+{
+    return (int64_t)viewUInt64(view, index);
+}
+
+static inline float viewFloat(ArrayView *view, long index)
+{
+    uint32_t bits = viewUInt32(view, index);
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static inline double viewDouble(ArrayView *view, long index)
+{
+    uint64_t bits = viewUInt64(view, index);
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+#endif // _SAVEVIEW_H
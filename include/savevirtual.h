@@ -0,0 +1,70 @@
+/*
+
+    ReadSave: include/savevirtual.h
+
+    Copyright (C) 2022  Johnathan K Burchill
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef _SAVEVIRTUAL_H
+#define _SAVEVIRTUAL_H
+
+#include "readsave.h"
+
+#include <stdbool.h>
+
+#define VIRTUAL_DATASET_MAX_DIMS 8
+
+// One file's part of a virtual dataset
+typedef struct VirtualFile
+{
+    char *path;
+    // Index of the first value in the dataset, and the number of values
+    long first;
+    long nElements;
+
+} VirtualFile;
+
+// A numeric variable or structure array tag spread over several save files,
+// seen as one array concatenated along its slowest IDL dimension. For a
+// plain array that is its last dimension; for a structure array tag it is
+// the structure element, after the tag's own dimensions.
+typedef struct VirtualDataset
+{
+    char *variableName;
+    long dataType;
+    bool isStructureTag;
+    long nDims;
+    long dims[VIRTUAL_DATASET_MAX_DIMS];
+    long nElements;
+    // Values per step along the concatenated dimension
+    long nElementsPerStep;
+    VirtualFile *files;
+    long nFiles;
+    // Index of the file that made openVirtualDataset() fail, or -1
+    long failedFile;
+
+} VirtualDataset;
+
+// Reads only the definitions of the files, with nThreads threads, and checks
+// that the data types, the other dimensions and any structure layouts agree
+int openVirtualDataset(char **files, long nFiles, char *dottedName, int nThreads, VirtualDataset *dataset);
+void closeVirtualDataset(VirtualDataset *dataset);
+
+// Decodes count values from start, in IDL order, as materializeRange() does.
+// Only files overlapping the range are mapped, nThreads at a time.
+int readVirtualSlice(VirtualDataset *dataset, long start, long count, void *values, int nThreads);
+
+#endif // _SAVEVIRTUAL_H
@@ -0,0 +1,54 @@
+/*
+
+    ReadSave: include/savewriter.h
+
+    Copyright (C) 2022  Johnathan K Burchill
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef _SAVEWRITER_H
+#define _SAVEWRITER_H
+
+#include "readsave.h"
+
+#include <stdio.h>
+#include <stdint.h>
+
+#define SAVEWRITER_BLOCK_SIZE (1L << 16)
+#define SAVEWRITER_FILE_BUFFER_SIZE (1L << 20)
+#define SAVEWRITER_FORMAT_VERSION 9
+
+typedef struct SaveWriter
+{
+    FILE *file;
+    long offset;
+    int status;
+    unsigned char *block;
+    char *fileBuffer;
+
+} SaveWriter;
+
+int writeSaveOpen(char *filename, SaveWriter *writer);
+// Returns READSAVE_ARGUMENTS for variables holding heap pointers, object
+// references, undefined values or arrays decoded with ReadSaveOptions.rowMajor.
+// Structure tags left out of a projection are left out of the written structure.
+int writeVariable(SaveWriter *writer, Variable *var);
+int writeSaveClose(SaveWriter *writer);
+
+long variableRecordSize(Variable *var);
+
+int extractSaveRecords(char *inputFile, char *outputFile, char **variableNames, int nVariableNames, long *nCopied);
+
+#endif // _SAVEWRITER_H
@@ -20,11 +20,26 @@
 
 #include "main.h"
 #include "readsave.h"
+#include "daemon.h"
+#include "saveshm.h"
+#include "saveview.h"
+#include "savestats.h"
+#include "saveio.h"
+#include "savewriter.h"
+#include "savecache.h"
+#include "savedecimate.h"
+#include "savesummary.h"
+#include "savecatalog.h"
+#include "savevirtual.h"
+#include "savehash.h"
 
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <strings.h>
 #include <stdint.h>
+#include <math.h>
+#include <time.h>
 
 int main(int argc, char **argv)
 {
@@ -32,7 +47,41 @@ int main(int argc, char **argv)
 
     int nOptions = 0;
     bool summarize = false;
+    bool layoutSummary = false;
+    bool tagStats = false;
     char *variableName = NULL;
+    char *daemonSocket = NULL;
+    char *querySocket = NULL;
+    size_t cacheSizeMB = DAEMON_DEFAULT_CACHE_MB;
+    long sliceStart = 0;
+    long sliceCount = -1;
+    bool slice = false;
+    char *sharedMemoryName = NULL;
+    bool statsOnly = false;
+    long nBins = 0;
+    double binMin = 0.0;
+    double binMax = 0.0;
+    int nThreads = 1;
+    int nInFlight = READ_PIPELINE_FILES_IN_FLIGHT;
+    char *extractFile = NULL;
+    char *cacheFile = NULL;
+    int compression = SaveCacheCompressionNone;
+    bool rowMajor = false;
+    long decimationFactors[8] = {0};
+    int nDecimationFactors = 0;
+    int decimationMode = DecimationStride;
+    long convertTo = DataTypeUndefined;
+    double scaleFactor = 1.0;
+    double addOffset = 0.0;
+    char *catalogFile = NULL;
+    char *fileList = NULL;
+    bool concatenate = false;
+    bool duplicates = false;
+    CatalogQuery query = {.nDims = -1, .after = SAVE_CATALOG_UNKNOWN_TIME, .before = SAVE_CATALOG_UNKNOWN_TIME};
+    ReadSavePredicate *predicates = calloc(argc, sizeof(ReadSavePredicate));
+    int nPredicates = 0;
+    if (predicates == NULL)
+        return EXIT_FAILURE;
 
     for (int i = 0; i < argc; i++)
     {
@@ -51,6 +100,12 @@ int main(int argc, char **argv)
             nOptions++;
             summarize = true;
         }
+        else if (strcmp(argv[i], "--layout-summary") == 0 || strcmp(argv[i], "--layout-summary=stats") == 0)
+        {
+            nOptions++;
+            layoutSummary = true;
+            tagStats = argv[i][16] == '=';
+        }
         else if (strncmp(argv[i], "--variable=", 11) == 0)
         {
             if (strlen(argv[i]) == 11)
@@ -61,6 +116,193 @@ int main(int argc, char **argv)
             nOptions++;
             variableName = argv[i] + 11;
         }
+        else if (strncmp(argv[i], "--daemon=", 9) == 0)
+        {
+            nOptions++;
+            daemonSocket = argv[i] + 9;
+        }
+        else if (strncmp(argv[i], "--cache-size=", 13) == 0)
+        {
+            nOptions++;
+            cacheSizeMB = atol(argv[i] + 13);
+        }
+        else if (strncmp(argv[i], "--socket=", 9) == 0)
+        {
+            nOptions++;
+            querySocket = argv[i] + 9;
+        }
+        else if (strncmp(argv[i], "--shm-export=", 13) == 0)
+        {
+            if (strlen(argv[i]) == 13)
+            {
+                fprintf(stderr, "Missing segment name for %s\n", argv[i]);
+                return EXIT_FAILURE;
+            }
+            nOptions++;
+            sharedMemoryName = argv[i] + 13;
+        }
+        else if (strcmp(argv[i], "--stats-only") == 0)
+        {
+            nOptions++;
+            statsOnly = true;
+        }
+        else if (strncmp(argv[i], "--decimate=", 11) == 0)
+        {
+            nOptions++;
+            if (parseDecimation(argv[i] + 11, decimationFactors, &nDecimationFactors, &decimationMode) != READSAVE_OK)
+            {
+                fprintf(stderr, "Expected --decimate=<factor1>[,<factor2>...][,mean] with up to 8 factors of at least 1\n");
+                return EXIT_FAILURE;
+            }
+        }
+        else if (strncmp(argv[i], "--histogram=", 12) == 0)
+        {
+            nOptions++;
+            if (sscanf(argv[i] + 12, "%ld,%lf,%lf", &nBins, &binMin, &binMax) != 3 || nBins <= 0 || !(binMax > binMin))
+            {
+                fprintf(stderr, "Expected --histogram=<nBins>,<min>,<max>\n");
+                return EXIT_FAILURE;
+            }
+        }
+        else if (strncmp(argv[i], "--threads=", 10) == 0)
+        {
+            nOptions++;
+            nThreads = atoi(argv[i] + 10);
+            if (nThreads < 1)
+                nThreads = 1;
+        }
+        else if (strncmp(argv[i], "--in-flight=", 12) == 0)
+        {
+            nOptions++;
+            nInFlight = atoi(argv[i] + 12);
+        }
+        else if (strncmp(argv[i], "--extract-to=", 13) == 0)
+        {
+            if (strlen(argv[i]) == 13)
+            {
+                fprintf(stderr, "Missing output file for %s\n", argv[i]);
+                return EXIT_FAILURE;
+            }
+            nOptions++;
+            extractFile = argv[i] + 13;
+        }
+        else if (strncmp(argv[i], "--convert-to-cache=", 19) == 0)
+        {
+            if (strlen(argv[i]) == 19)
+            {
+                fprintf(stderr, "Missing cache file for %s\n", argv[i]);
+                return EXIT_FAILURE;
+            }
+            nOptions++;
+            cacheFile = argv[i] + 19;
+        }
+        else if (strncmp(argv[i], "--compress=", 11) == 0)
+        {
+            nOptions++;
+            if (strcasecmp(argv[i] + 11, "lz4") == 0)
+                compression = SaveCacheCompressionLZ4;
+            else if (strcasecmp(argv[i] + 11, "zstd") == 0)
+                compression = SaveCacheCompressionZstd;
+            else
+            {
+                fprintf(stderr, "Expected --compress=lz4 or --compress=zstd\n");
+                return EXIT_FAILURE;
+            }
+            if (!cacheCompressionAvailable(compression))
+            {
+                fprintf(stderr, "readsave was built without %s support\n", argv[i] + 11);
+                return EXIT_FAILURE;
+            }
+        }
+        else if (strncmp(argv[i], "--where=", 8) == 0)
+        {
+            nOptions++;
+            if (parsePredicate(argv[i] + 8, &predicates[nPredicates++]) != READSAVE_OK)
+            {
+                fprintf(stderr, "Expected --where=<variableName.tag><op><value> with op one of ==, !=, <, <=, >, >=\n");
+                return EXIT_FAILURE;
+            }
+        }
+        else if (strcmp(argv[i], "--duplicates") == 0)
+        {
+            nOptions++;
+            duplicates = true;
+        }
+        else if (strcmp(argv[i], "--concat") == 0)
+        {
+            nOptions++;
+            concatenate = true;
+        }
+        else if (strcmp(argv[i], "--row-major") == 0)
+        {
+            nOptions++;
+            rowMajor = true;
+        }
+        else if (strncmp(argv[i], "--convert=", 10) == 0)
+        {
+            nOptions++;
+            char typeName[8] = {0};
+            int nFields = sscanf(argv[i] + 10, "%7[a-z],%lf,%lf", typeName, &scaleFactor, &addOffset);
+            if (strcmp(typeName, "float") == 0)
+                convertTo = DataTypeFloat;
+            else if (strcmp(typeName, "double") == 0)
+                convertTo = DataTypeDouble;
+            if (convertTo == DataTypeUndefined || (nFields != 1 && nFields != 3))
+            {
+                fprintf(stderr, "Expected --convert=float|double[,<scale>,<offset>]\n");
+                return EXIT_FAILURE;
+            }
+        }
+        else if (strncmp(argv[i], "--build-catalog=", 16) == 0)
+        {
+            if (strlen(argv[i]) == 16)
+            {
+                fprintf(stderr, "Missing catalog file for %s\n", argv[i]);
+                return EXIT_FAILURE;
+            }
+            nOptions++;
+            catalogFile = argv[i] + 16;
+        }
+        else if (strncmp(argv[i], "--file-list=", 12) == 0)
+        {
+            nOptions++;
+            fileList = argv[i] + 12;
+        }
+        else if (strncmp(argv[i], "--dims=", 7) == 0)
+        {
+            nOptions++;
+            query.nDims = parseCatalogDims(argv[i] + 7, query.dims);
+            if (query.nDims < 1)
+            {
+                fprintf(stderr, "Expected --dims=<dim1>[,<dim2>...] with at most %d dimensions\n", SAVE_CATALOG_MAX_DIMS);
+                return EXIT_FAILURE;
+            }
+        }
+        else if (strncmp(argv[i], "--after=", 8) == 0 || strncmp(argv[i], "--before=", 9) == 0)
+        {
+            nOptions++;
+            bool after = argv[i][2] == 'a';
+            long time = parseSaveTime(argv[i] + (after ? 8 : 9));
+            if (time == SAVE_CATALOG_UNKNOWN_TIME)
+            {
+                fprintf(stderr, "Expected a time such as 2013-01-07, 2013-01-07T12:34:56 or \"Mon Jan 07 12:34:56 2013\" for %s\n", argv[i]);
+                return EXIT_FAILURE;
+            }
+            if (after)
+                query.after = time;
+            else
+                query.before = time;
+        }
+        else if (strncmp(argv[i], "--slice=", 8) == 0)
+        {
+            nOptions++;
+            if (sscanf(argv[i] + 8, "%ld,%ld", &sliceStart, &sliceCount) != 2 || sliceStart < 0 || sliceCount < 0)
+            {
+                fprintf(stderr, "Expected --slice=<start>,<count>\n");
+                return EXIT_FAILURE;
+            }
+            slice = true;
+        }
         else if (strncmp(argv[i], "--", 2) == 0)
         {
             fprintf(stderr, "Unknown option %s\n", argv[i]);
@@ -68,6 +310,59 @@ int main(int argc, char **argv)
         }
     }
 
+    if (daemonSocket != NULL)
+    {
+        if (argc - nOptions != 1)
+        {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+        status = runDaemon(daemonSocket, cacheSizeMB * 1024 * 1024);
+        if (status != READSAVE_OK)
+        {
+            fprintf(stderr, "Unable to run daemon on socket %s (status %d)\n", daemonSocket, status);
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+
+    if (catalogFile != NULL)
+    {
+        status = buildCatalog(catalogFile, argv, argc, fileList, nThreads);
+        return status == READSAVE_OK ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if (duplicates)
+    {
+        status = printDuplicateRecords(argv, argc, fileList, nThreads);
+        return status == READSAVE_OK ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if (concatenate)
+    {
+        if (variableName == NULL)
+        {
+            fprintf(stderr, "--concat requires --variable\n");
+            return EXIT_FAILURE;
+        }
+        status = printConcatenatedVariable(argv, argc, fileList, variableName, sliceStart, sliceCount, nThreads);
+        return status == READSAVE_OK ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if (argc - nOptions > 2)
+    {
+        long nFiles = 0;
+        char **files = calloc(argc, sizeof(char*));
+        if (files == NULL)
+            return EXIT_FAILURE;
+        for (int i = 1; i < argc; i++)
+            if (strncmp(argv[i], "--", 2) != 0)
+                files[nFiles++] = argv[i];
+        status = scanFiles(files, nFiles, variableName, nInFlight);
+        free(files);
+        return status == READSAVE_OK ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
     if (argc - nOptions != 2)
     {
         usage(argv[0]);
@@ -75,19 +370,116 @@ int main(int argc, char **argv)
     }
 
     char *savFile = argv[1];
-    if (strcmp(savFile + strlen(savFile)-4, ".sav") != 0)
+    if (strlen(savFile) > 5 && strcmp(savFile + strlen(savFile)-5, ".rcat") == 0)
+    {
+        query.name = variableName;
+        status = printCatalogMatches(savFile, &query);
+        return status == READSAVE_OK ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    if (strlen(savFile) > 4 && strcmp(savFile + strlen(savFile)-4, ".rsc") == 0)
+    {
+        status = printCacheFile(savFile, variableName, sliceStart, sliceCount, nThreads);
+        return status == READSAVE_OK ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    if (strlen(savFile) < 4 || strcmp(savFile + strlen(savFile)-4, ".sav") != 0)
+    {
+        fprintf(stderr, "Expected first argument to be a save file with extension .sav, a cache file with extension .rsc or a catalog with extension .rcat.\n");
+        return EXIT_FAILURE;
+    }
+
+    if (querySocket != NULL)
+    {
+        int requestType = DaemonRequestVariable;
+        if (summarize)
+            requestType = DaemonRequestSummary;
+        else if (slice)
+            requestType = DaemonRequestSlice;
+        // Errors reported by the daemon are printed with its response
+        status = queryDaemon(querySocket, requestType, savFile, variableName, sliceStart, sliceCount);
+        if (status != READSAVE_OK)
+        {
+            fprintf(stderr, "Daemon query on socket %s failed (status %d)\n", querySocket, status);
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+
+    if (statsOnly)
+    {
+        if (variableName == NULL)
+        {
+            fprintf(stderr, "--stats-only requires --variable\n");
+            return EXIT_FAILURE;
+        }
+        status = printVariableStats(savFile, variableName, nBins, binMin, binMax, nThreads);
+        return status == READSAVE_OK ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if (layoutSummary)
+    {
+        status = printLayoutSummary(savFile, variableName, tagStats, nThreads);
+        return status == READSAVE_OK ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if (nDecimationFactors > 0)
+    {
+        if (variableName == NULL)
+        {
+            fprintf(stderr, "--decimate requires --variable\n");
+            return EXIT_FAILURE;
+        }
+        status = printDecimatedVariable(savFile, variableName, decimationFactors, nDecimationFactors, decimationMode);
+        return status == READSAVE_OK ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if (extractFile != NULL)
     {
-        fprintf(stderr, "Expected first argument to be a save file with extension .sav.\n");
+        status = extractVariables(savFile, extractFile, variableName);
+        return status == READSAVE_OK ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if (rowMajor && cacheFile != NULL)
+    {
+        fprintf(stderr, "--row-major cannot be used with --convert-to-cache; cache columns are stored in IDL order\n");
         return EXIT_FAILURE;
     }
 
     VariableList variables = {0};
     SaveInfo fileInfo = {0};
 
-    status = readSave(savFile, &fileInfo, &variables);
+    // Only the requested variable or tag is decoded unless the whole file is converted
+    ReadSaveOptions options = {0};
+    if (variableName != NULL && cacheFile == NULL)
+    {
+        options.tagPaths = &variableName;
+        options.nTagPaths = 1;
+    }
+    options.predicates = predicates;
+    options.nPredicates = nPredicates;
+    options.rowMajor = rowMajor;
+    options.convertTo = convertTo;
+    options.scaleFactor = scaleFactor;
+    options.addOffset = addOffset;
+    status = readSaveWithOptions(savFile, &options, &fileInfo, &variables);
+    if (status == READSAVE_CORRUPT_RECORD || status == READSAVE_READ_ARRAY)
+        fprintf(stderr, "%s is truncated or corrupt (status %d); variables after the damage were not read\n", savFile, status);
 
     fprintf(stdout, "SAV file created %s by %s.\n", fileInfo.date, fileInfo.operator);
 
+    if (cacheFile != NULL)
+    {
+        long nColumns = 0;
+        if (status == READSAVE_OK)
+            status = writeCompressedSaveCache(cacheFile, &variables, compression, SAVE_CACHE_CHUNK_SIZE, &nColumns);
+        if (status == READSAVE_OK)
+            fprintf(stdout, "Wrote %ld columns to %s\n", nColumns, cacheFile);
+        else
+            fprintf(stderr, "Unable to convert %s to cache file %s (status %d)\n", savFile, cacheFile, status);
+        freeSaveInfo(&fileInfo);
+        freeVariableList(&variables);
+        return status == READSAVE_OK ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
     Variable *var = NULL;
     Variable *selectedVar = NULL;
     if (summarize)
@@ -128,122 +520,702 @@ int main(int argc, char **argv)
     }
     // Other things to do
 
+    if (sharedMemoryName != NULL)
+    {
+        selectedVar = findVariable(&variables, variableName);
+        SharedVariable shared = {0};
+        status = exportSharedVariable(selectedVar, sharedMemoryName, &shared);
+        if (status != READSAVE_OK)
+        {
+            fprintf(stderr, "Unable to export %s to shared memory segment %s (status %d)\n", variableName == NULL ? "<no variable>" : variableName, sharedMemoryName, status);
+            freeSaveInfo(&fileInfo);
+            freeVariableList(&variables);
+            return EXIT_FAILURE;
+        }
+        fprintf(stdout, "Exported %s to shared memory segment %s (%ld elements, %ld bytes)\n", variableName, sharedMemoryName, shared.descriptor->nElements, shared.descriptor->nBytes);
+        detachSharedVariable(&shared);
+        freeSaveInfo(&fileInfo);
+        freeVariableList(&variables);
+        return EXIT_SUCCESS;
+    }
+
+    if (nPredicates > 0)
+    {
+        if (status != READSAVE_OK)
+            fprintf(stderr, "Unable to filter %s (status %d)\n", savFile, status);
+        printSelectedElements(&variables, variableName, sliceStart, sliceCount);
+        freeSaveInfo(&fileInfo);
+        freeVariableList(&variables);
+        free(predicates);
+        return status == READSAVE_OK ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
     bool extract = true;
     if (extract)
     {
-        for (int i = 0; i < variables.nVariables; i++)
+        selectedVar = findVariable(&variables, variableName);
+        if (selectedVar != NULL)
+            printVariableData(selectedVar, sliceStart, sliceCount);
+    }
+
+    freeSaveInfo(&fileInfo);
+    freeVariableList(&variables);
+
+    return EXIT_SUCCESS;
+
+}
+
+int scanFiles(char **files, long nFiles, char *variableName, int nInFlight)
+{
+    SaveInfo *infos = calloc(nFiles, sizeof(SaveInfo));
+    VariableList *variables = calloc(nFiles, sizeof(VariableList));
+    int *statuses = calloc(nFiles, sizeof(int));
+    if (infos == NULL || variables == NULL || statuses == NULL)
+    {
+        free(infos);
+        free(variables);
+        free(statuses);
+        return READSAVE_MEM;
+    }
+
+    int status = readSaveFiles(files, nFiles, infos, variables, statuses, nInFlight);
+
+    Variable *selectedVar = NULL;
+    for (long f = 0; status == READSAVE_OK && f < nFiles; f++)
+    {
+        if (statuses[f] != READSAVE_OK)
+            fprintf(stdout, "%s: unable to read (status %d)\n", files[f], statuses[f]);
+        else
         {
-            var = &variables.variableList[i];
-            if (var->isArray && var->isStructure)
-            {
-                for (int v = 0; v < 1; v++)
-                {
-                    selectedVar = variableData(&((Variable*)var->data)[v], variableName);
-                }
-            }
+            fprintf(stdout, "%s: SAV file created %s by %s.\n", files[f], infos[f].date, infos[f].operator);
+            if (variableName == NULL)
+                for (int i = 0; i < variables[f].nVariables; i++)
+                    fprintf(stdout, " %s\n", variables[f].variableList[i].name);
             else
             {
-                selectedVar = variableData(var, variableName);
+                selectedVar = findVariable(&variables[f], variableName);
                 if (selectedVar != NULL)
-                {
                     summarizeVariable(selectedVar);
-                    break;
-                }
             }
-            if (selectedVar != NULL)
-            {
-                void *data = selectedVar->data;
-                if (selectedVar->arrayInfo.nElements == 0)
-                {
-                    switch(selectedVar->dataType)
-                    {
-                        case DataTypeByte:
-                            printf("%d\n", *(uint8_t*)data);
-                            break;
-                        case DataTypeInt16:
-                            printf("%d\n", *(int16_t*)data);
-                            break;
-                        case DataTypeUInt16:
-                            printf("%u\n", *(uint16_t*)data);
-                            break;
-                        case DataTypeInt32:
-                            printf("%d\n", *(int32_t*)data);
-                            break;
-                        case DataTypeUInt32:
-                            printf("%u\n", *(uint32_t*)data);
-                            break;
-                        case DataTypeInt64:
-                            printf("%ld\n", *(int64_t*)data);
-                            break;
-                        case DataTypeUInt64:
-                            printf("%ld\n", *(uint64_t*)data);
-                            break;
-                        case DataTypeFloat:
-                            printf("%f\n", *(float*)data);
-                            break;
-                        case DataTypeDouble:
-                            printf("%lf\n", *(double*)data);
-                            break;
-                        default:
-                    }
+        }
+        freeSaveInfo(&infos[f]);
+        freeVariableList(&variables[f]);
+    }
 
-                }
-                else
-                    for (int i = 0; i < selectedVar->arrayInfo.nElements; i++)
-                    {
-                        switch(selectedVar->dataType)
-                        {
-                            case DataTypeByte:
-                                printf("%d\n", ((uint8_t*)data)[i]);
-                                break;
-                            case DataTypeInt16:
-                                printf("%d\n", ((int16_t*)data)[i]);
-                                break;
-                            case DataTypeUInt16:
-                                printf("%u\n", ((uint16_t*)data)[i]);
-                                break;
-                            case DataTypeInt32:
-                                printf("%d\n", ((int32_t*)data)[i]);
-                                break;
-                            case DataTypeUInt32:
-                                printf("%u\n", ((uint32_t*)data)[i]);
-                                break;
-                            case DataTypeInt64:
-                                printf("%ld\n", ((int64_t*)data)[i]);
-                                break;
-                            case DataTypeUInt64:
-                                printf("%ld\n", ((uint64_t*)data)[i]);
-                                break;
-                            case DataTypeFloat:
-                                printf("%f\n", ((float*)data)[i]);
-                                break;
-                            case DataTypeDouble:
-                                printf("%lf\n", ((double*)data)[i]);
-                                break;
-                            default:
-                        }
-                    }
+    free(infos);
+    free(variables);
+    free(statuses);
+
+    return status;
+}
+
+int printVariableStats(char *savFile, char *variableName, long nBins, double binMin, double binMax, int nThreads)
+{
+    SaveView view = {0};
+    int status = openSaveView(savFile, &view);
+    if (status != READSAVE_OK)
+    {
+        fprintf(stderr, "Unable to open %s (status %d)\n", savFile, status);
+        return status;
+    }
+
+    ArrayStats stats = {0};
+    status = initArrayStats(&stats, nBins, binMin, binMax);
+    if (status == READSAVE_OK)
+        status = variableStats(&view, variableName, &stats, nThreads);
+    closeSaveView(&view);
+    if (status != READSAVE_OK)
+    {
+        fprintf(stderr, "Unable to compute statistics of %s (status %d)\n", variableName, status);
+        freeArrayStats(&stats);
+        return status;
+    }
+
+    fprintf(stdout, "%s: %ld values, %ld NaN\n", variableName, stats.nValues, stats.nNaN);
+    fprintf(stdout, " min %lg max %lg sum %lg mean %lg\n", stats.min, stats.max, stats.sum, stats.mean);
+    double binWidth = (binMax - binMin) / (double)(nBins > 0 ? nBins : 1);
+    for (long b = 0; b < stats.nBins; b++)
+        fprintf(stdout, " [%lg, %lg) %ld\n", binMin + b * binWidth, binMin + (b + 1) * binWidth, stats.histogram[b]);
+
+    freeArrayStats(&stats);
+
+    return READSAVE_OK;
+}
+
+int printLayoutSummary(char *savFile, char *variableName, bool tagStats, int nThreads)
+{
+    SaveView view = {0};
+    int status = openSaveView(savFile, &view);
+    if (status != READSAVE_OK)
+    {
+        fprintf(stderr, "Unable to open %s (status %d)\n", savFile, status);
+        return status;
+    }
+
+    status = summarizeLayout(&view, variableName, tagStats, nThreads);
+    closeSaveView(&view);
+    if (status == READSAVE_VARIABLE_NOT_FOUND)
+        fprintf(stderr, "%s not found in %s\n", variableName, savFile);
+    else if (status != READSAVE_OK)
+        fprintf(stderr, "Unable to summarize %s (status %d)\n", savFile, status);
+
+    return status;
+}
+
+// Factors for the leading dimensions, optionally followed by "mean"
+int parseDecimation(char *text, long *factors, int *nFactors, int *mode)
+{
+    char *end = NULL;
+    *nFactors = 0;
+    *mode = DecimationStride;
+    while (*text != '\0')
+    {
+        if (strcmp(text, "mean") == 0)
+        {
+            *mode = DecimationBlockMean;
+            break;
+        }
+        if (*nFactors >= 8)
+            return READSAVE_ARGUMENTS;
+        factors[*nFactors] = strtol(text, &end, 10);
+        if (end == text || factors[*nFactors] < 1 || (*end != ',' && *end != '\0'))
+            return READSAVE_ARGUMENTS;
+        (*nFactors)++;
+        text = *end == ',' ? end + 1 : end;
+    }
+
+    return *nFactors > 0 ? READSAVE_OK : READSAVE_ARGUMENTS;
+}
+
+int printDecimatedVariable(char *savFile, char *variableName, long *factors, int nFactors, int mode)
+{
+    SaveView view = {0};
+    int status = openSaveView(savFile, &view);
+    if (status != READSAVE_OK)
+    {
+        fprintf(stderr, "Unable to open %s (status %d)\n", savFile, status);
+        return status;
+    }
+
+    // Structure array tags are taken from the first element
+    Variable decimated = {0};
+    status = decimateVariable(&view, variableName, 0, factors, nFactors, mode, &decimated);
+    closeSaveView(&view);
+    if (status != READSAVE_OK)
+    {
+        fprintf(stderr, "Unable to decimate %s (status %d)\n", variableName, status);
+        return status;
+    }
+
+    fprintf(stdout, "%s: %s decimated to", variableName, mode == DecimationBlockMean ? "block mean" : "stride");
+    for (long d = 0; d < decimated.arrayInfo.nDims; d++)
+        fprintf(stdout, "%s%ld", d == 0 ? " " : " x ", decimated.arrayInfo.dims[d]);
+    fprintf(stdout, "\n");
+    printVariableData(&decimated, 0, -1);
+    freeVariable(&decimated);
+
+    return READSAVE_OK;
+}
+
+int extractVariables(char *savFile, char *extractFile, char *variableNames)
+{
+    // --variable may list several comma-separated names
+    char *buffer = NULL;
+    char **names = NULL;
+    int nNames = 0;
+    if (variableNames != NULL)
+    {
+        buffer = strdup(variableNames);
+        names = calloc(strlen(variableNames) + 1, sizeof(char*));
+        if (buffer == NULL || names == NULL)
+        {
+            free(buffer);
+            free(names);
+            return READSAVE_MEM;
+        }
+        char *rest = buffer;
+        char *name = NULL;
+        while ((name = strsep(&rest, ",")) != NULL)
+            if (strlen(name) > 0)
+                names[nNames++] = name;
+    }
+
+    long nCopied = 0;
+    int status = extractSaveRecords(savFile, extractFile, names, nNames, &nCopied);
+    free(names);
+    free(buffer);
+    if (status != READSAVE_OK)
+    {
+        fprintf(stderr, "Unable to extract variables from %s to %s (status %d)\n", savFile, extractFile, status);
+        return status;
+    }
+    fprintf(stdout, "Copied %ld variable%s to %s\n", nCopied, nCopied == 1 ? "" : "s", extractFile);
+    if (nNames > 0 && nCopied < nNames)
+        fprintf(stderr, "%ld of %d requested variables not found\n", nNames - nCopied, nNames);
+
+    return READSAVE_OK;
+}
+
+// Files are given on the command line, in a list file with one path per line, or both.
+// Paths from the list are allocated; those from the command line are not.
+int collectFiles(char **argv, int argc, char *fileList, char ***files, long *nFiles, long *nCommandLineFiles)
+{
+    long maxFiles = argc;
+    *nFiles = 0;
+    *files = calloc(maxFiles, sizeof(char*));
+    if (*files == NULL)
+        return READSAVE_MEM;
+    for (int i = 1; i < argc; i++)
+        if (strncmp(argv[i], "--", 2) != 0)
+            (*files)[(*nFiles)++] = argv[i];
+    *nCommandLineFiles = *nFiles;
+    if (fileList == NULL)
+        return READSAVE_OK;
+
+    FILE *list = fopen(fileList, "r");
+    if (list == NULL)
+    {
+        fprintf(stderr, "Unable to open file list %s\n", fileList);
+        return READSAVE_INPUT_FILE;
+    }
+    int status = READSAVE_OK;
+    char *line = NULL;
+    size_t lineSize = 0;
+    ssize_t length = 0;
+    void *mem = NULL;
+    while (status == READSAVE_OK && (length = getline(&line, &lineSize, list)) != -1)
+    {
+        while (length > 0 && (line[length - 1] == '\n' || line[length - 1] == '\r'))
+            line[--length] = '\0';
+        if (length == 0)
+            continue;
+        if (*nFiles == maxFiles)
+        {
+            mem = realloc(*files, 2 * maxFiles * sizeof(char*));
+            if (mem == NULL)
+            {
+                status = READSAVE_MEM;
+                break;
             }
+            *files = mem;
+            maxFiles *= 2;
+        }
+        (*files)[*nFiles] = strdup(line);
+        if ((*files)[*nFiles] == NULL)
+            status = READSAVE_MEM;
+        else
+            (*nFiles)++;
+    }
+    free(line);
+    fclose(list);
+
+    return status;
+}
+
+void freeFiles(char **files, long nFiles, long nCommandLineFiles)
+{
+    for (long f = nCommandLineFiles; f < nFiles; f++)
+        free(files[f]);
+    free(files);
+
+    return;
+}
+
+int buildCatalog(char *catalogFile, char **argv, int argc, char *fileList, int nThreads)
+{
+    char **files = NULL;
+    long nFiles = 0;
+    long nCommandLineFiles = 0;
+    int status = collectFiles(argv, argc, fileList, &files, &nFiles, &nCommandLineFiles);
+
+    long nEntries = 0;
+    if (status == READSAVE_OK)
+        status = buildSaveCatalog(catalogFile, files, nFiles, nThreads, &nEntries);
+    if (status == READSAVE_OK)
+        fprintf(stdout, "Cataloged %ld variables and tags from %ld paths to %s\n", nEntries, nFiles, catalogFile);
+    else
+        fprintf(stderr, "Unable to build catalog %s (status %d)\n", catalogFile, status);
+
+    freeFiles(files, nFiles, nCommandLineFiles);
+
+    return status;
+}
+
+int printConcatenatedVariable(char **argv, int argc, char *fileList, char *variableName, long start, long count, int nThreads)
+{
+    char **files = NULL;
+    long nFiles = 0;
+    long nCommandLineFiles = 0;
+    int status = collectFiles(argv, argc, fileList, &files, &nFiles, &nCommandLineFiles);
+
+    VirtualDataset dataset = {0};
+    if (status == READSAVE_OK)
+        status = openVirtualDataset(files, nFiles, variableName, nThreads, &dataset);
+    if (status != READSAVE_OK)
+    {
+        if (dataset.failedFile > 0 && status == READSAVE_ARGUMENTS)
+            fprintf(stderr, "Unable to concatenate %s: its layout in %s differs from that in %s\n", variableName, files[dataset.failedFile], files[0]);
+        else if (dataset.failedFile >= 0)
+            fprintf(stderr, "Unable to concatenate %s from %s (status %d)\n", variableName, files[dataset.failedFile], status);
+        else
+            fprintf(stderr, "Unable to concatenate %s (status %d)\n", variableName, status);
+        freeFiles(files, nFiles, nCommandLineFiles);
+        return status;
+    }
+    freeFiles(files, nFiles, nCommandLineFiles);
+
+    char typeName[255] = {0};
+    dataTypeName(dataset.dataType, typeName);
+    fprintf(stdout, "%s: %s", variableName, typeName);
+    for (long d = 0; d < dataset.nDims; d++)
+        fprintf(stdout, "%s%ld", d == 0 ? " " : " x ", dataset.dims[d]);
+    fprintf(stdout, " from %ld files\n", dataset.nFiles);
+
+    if (start > dataset.nElements)
+        start = dataset.nElements;
+    if (count < 0 || start + count > dataset.nElements)
+        count = dataset.nElements - start;
+    Variable var = {0};
+    var.dataType = dataset.dataType;
+    var.isArray = true;
+    var.arrayInfo.nElements = count;
+    var.data = malloc(count * dataTypeSize(dataset.dataType) + 1);
+    if (var.data == NULL)
+        status = READSAVE_MEM;
+    else
+        status = readVirtualSlice(&dataset, start, count, var.data, nThreads);
+    if (status == READSAVE_OK)
+        printVariableData(&var, 0, count);
+    else
+        fprintf(stderr, "Unable to read %s (status %d)\n", variableName, status);
+    free(var.data);
+    closeVirtualDataset(&dataset);
+
+    return status;
+}
+
+// Groups of variable records with equal hashes and sizes, within and across files
+int printDuplicateRecords(char **argv, int argc, char *fileList, int nThreads)
+{
+    char **files = NULL;
+    long nFiles = 0;
+    long nCommandLineFiles = 0;
+    int status = collectFiles(argv, argc, fileList, &files, &nFiles, &nCommandLineFiles);
+    int *statuses = calloc(nFiles > 0 ? nFiles : 1, sizeof(int));
+    if (status == READSAVE_OK && statuses == NULL)
+        status = READSAVE_MEM;
+
+    RecordHash *hashes = NULL;
+    long nHashes = 0;
+    if (status == READSAVE_OK)
+        status = hashSaveFiles(files, nFiles, nThreads, statuses, &hashes, &nHashes);
+    if (status != READSAVE_OK)
+    {
+        fprintf(stderr, "Unable to hash save files (status %d)\n", status);
+        free(statuses);
+        freeFiles(files, nFiles, nCommandLineFiles);
+        return status;
+    }
+
+    for (long f = 0; f < nFiles; f++)
+        if (statuses[f] != READSAVE_OK)
+            fprintf(stdout, "%s: unable to read (status %d)\n", files[f], statuses[f]);
+
+    long nGroups = 0;
+    long nDuplicates = 0;
+    long nDuplicateBytes = 0;
+    long last = 0;
+    for (long first = 0; first < nHashes; first = last)
+    {
+        last = first + 1;
+        while (last < nHashes && hashes[last].hash == hashes[first].hash && hashes[last].nBytes == hashes[first].nBytes)
+            last++;
+        if (last - first < 2)
+            continue;
+        nGroups++;
+        nDuplicates += last - first - 1;
+        nDuplicateBytes += (last - first - 1) * hashes[first].nBytes;
+        fprintf(stdout, "%016lx %ld bytes x %ld\n", (unsigned long)hashes[first].hash, hashes[first].nBytes, last - first);
+        for (long i = first; i < last; i++)
+            fprintf(stdout, " %s %s\n", files[hashes[i].file], hashes[i].name);
+    }
+    fprintf(stdout, "%ld variable records in %ld files; %ld groups with %ld duplicates holding %ld bytes\n", nHashes, nFiles, nGroups, nDuplicates, nDuplicateBytes);
+
+    freeRecordHashes(hashes, nHashes);
+    free(statuses);
+    freeFiles(files, nFiles, nCommandLineFiles);
+
+    return READSAVE_OK;
+}
+
+int parseCatalogDims(char *text, long *dims)
+{
+    int nDims = 0;
+    char *end = NULL;
+    while (nDims < SAVE_CATALOG_MAX_DIMS)
+    {
+        dims[nDims++] = strtol(text, &end, 10);
+        if (end == text || dims[nDims - 1] < 1)
+            return 0;
+        if (*end == '\0')
+            return nDims;
+        if (*end != ',')
+            return 0;
+        text = end + 1;
+    }
+
+    return 0;
+}
+
+static void printCatalogTime(long timestamp)
+{
+    char text[32] = "unknown time";
+    time_t seconds = (time_t)timestamp;
+    struct tm fields = {0};
+    if (timestamp != SAVE_CATALOG_UNKNOWN_TIME && gmtime_r(&seconds, &fields) != NULL)
+        strftime(text, sizeof(text), "%Y-%m-%dT%H:%M:%S", &fields);
+    fprintf(stdout, "%s", text);
+
+    return;
+}
+
+static void printCatalogEntry(SaveCatalog *catalog, CatalogEntry *entry)
+{
+    char typeName[255] = {0};
+    CatalogFile *file = &catalog->files[entry->file];
+    dataTypeName(entry->dataType, typeName);
+    fprintf(stdout, "%s %s %s [", catalogString(catalog, file->pathOffset), catalogString(catalog, entry->nameOffset), typeName);
+    for (int d = 0; d < entry->nDims; d++)
+        fprintf(stdout, "%s%d", d > 0 ? "," : "", entry->dims[d]);
+    fprintf(stdout, "] ");
+    printCatalogTime(file->timestamp);
+    fprintf(stdout, "\n");
+
+    return;
+}
+
+// Lists matching variables, or the cataloged files if neither a name nor dimensions are given
+int printCatalogMatches(char *catalogFile, CatalogQuery *query)
+{
+    SaveCatalog catalog = {0};
+    int status = openSaveCatalog(catalogFile, &catalog);
+    if (status != READSAVE_OK)
+    {
+        fprintf(stderr, "Unable to open catalog %s (status %d)\n", catalogFile, status);
+        return status;
+    }
+
+    CatalogFile *file = NULL;
+    if (query->name == NULL && query->nDims < 0)
+    {
+        for (long f = 0; f < catalog.header->nFiles; f++)
+        {
+            if (!catalogFileMatches(&catalog, f, query))
+                continue;
+            file = &catalog.files[f];
+            fprintf(stdout, "%s ", catalogString(&catalog, file->pathOffset));
+            printCatalogTime(file->timestamp);
+            if (file->status != READSAVE_OK)
+                fprintf(stdout, " unable to read (status %d)\n", file->status);
+            else
+                fprintf(stdout, " %d variables and tags\n", file->nEntries);
         }
+        closeSaveCatalog(&catalog);
+        return READSAVE_OK;
+    }
 
+    long first = 0;
+    long count = catalog.header->nEntries;
+    if (query->name != NULL)
+        count = findCatalogEntries(&catalog, query->name, &first);
+    for (long e = first; e < first + count; e++)
+        if (catalogEntryMatches(&catalog, &catalog.entries[e], query))
+            printCatalogEntry(&catalog, &catalog.entries[e]);
+
+    closeSaveCatalog(&catalog);
+
+    return READSAVE_OK;
+}
+
+int printCacheFile(char *cacheFile, char *columnName, long start, long count, int nThreads)
+{
+    SaveCache cache = {0};
+    int status = openSaveCache(cacheFile, &cache);
+    if (status != READSAVE_OK)
+    {
+        fprintf(stderr, "Unable to open cache file %s (status %d)\n", cacheFile, status);
+        return status;
     }
 
-    // TODO ReadSave needs a comprehensive memory free on VariableList variables.
+    char typeName[255] = {0};
+    CacheColumn *column = NULL;
+    if (columnName == NULL)
+    {
+        fprintf(stdout, "Columns:\n");
+        for (long c = 0; c < cache.nColumns; c++)
+        {
+            column = &cache.columns[c];
+            dataTypeName(column->dataType, typeName);
+            fprintf(stdout, " %s %s [", column->name, typeName);
+            for (long d = 0; d < column->nDims; d++)
+                fprintf(stdout, "%s%ld", d > 0 ? "," : "", column->dims[d]);
+            fprintf(stdout, "]");
+            if (column->compression != SaveCacheCompressionNone)
+                fprintf(stdout, " %ld chunks, %ld bytes", column->nChunks, column->nBytes);
+            fprintf(stdout, "\n");
+        }
+        closeSaveCache(&cache);
+        return READSAVE_OK;
+    }
 
-    return EXIT_SUCCESS;
+    column = findCacheColumn(&cache, columnName);
+    if (column == NULL)
+    {
+        fprintf(stderr, "No column %s in %s\n", columnName, cacheFile);
+        closeSaveCache(&cache);
+        return READSAVE_VARIABLE_NOT_FOUND;
+    }
+
+    if (count < 0 || start + count > column->nElements)
+        count = column->nElements - start;
+    if (column->dataType == DataTypeString)
+        for (long i = start; i < start + count; i++)
+            fprintf(stdout, "%s\n", cacheString(&cache, column, i));
+    else
+    {
+        // Print straight from the mapped column unless it is compressed
+        Variable var = {0};
+        var.name = column->name;
+        var.dataType = column->dataType;
+        var.isArray = true;
+        var.arrayInfo.nElements = column->nElements;
+        var.data = cacheColumnData(&cache, column);
+        if (var.data == NULL)
+        {
+            var.arrayInfo.nElements = count;
+            var.data = malloc(count * column->nBytesPerElement + 1);
+            if (var.data == NULL)
+                status = READSAVE_MEM;
+            else
+                status = readCacheColumn(&cache, column, start, count, var.data, nThreads);
+            start = 0;
+        }
+        if (status == READSAVE_OK)
+            printVariableData(&var, start, count);
+        else
+            fprintf(stderr, "Unable to read column %s (status %d)\n", column->name, status);
+        if (var.data != cacheColumnData(&cache, column))
+            free(var.data);
+    }
+
+    closeSaveCache(&cache);
+
+    return status;
+}
+
+// <variableName.tag><op><value>; the text is split in place
+int parsePredicate(char *text, ReadSavePredicate *predicate)
+{
+    char *op = strpbrk(text, "=!<>");
+    if (op == NULL || op == text)
+        return READSAVE_ARGUMENTS;
+
+    char *value = op + 1;
+    if (strncmp(op, "==", 2) == 0)
+        predicate->comparison = ReadSaveEqual;
+    else if (strncmp(op, "!=", 2) == 0)
+        predicate->comparison = ReadSaveNotEqual;
+    else if (strncmp(op, "<=", 2) == 0)
+        predicate->comparison = ReadSaveLessEqual;
+    else if (strncmp(op, ">=", 2) == 0)
+        predicate->comparison = ReadSaveGreaterEqual;
+    else if (*op == '<')
+        predicate->comparison = ReadSaveLess;
+    else if (*op == '>')
+        predicate->comparison = ReadSaveGreater;
+    else if (*op == '=')
+        predicate->comparison = ReadSaveEqual;
+    else
+        return READSAVE_ARGUMENTS;
+    if (op[1] == '=')
+        value++;
+
+    char *end = NULL;
+    predicate->value = strtod(value, &end);
+    if (end == value || *end != '\0')
+        predicate->value = NAN;
+    predicate->string = value;
+    *op = '\0';
+    predicate->tagPath = text;
+
+    return READSAVE_OK;
+}
+
+// Structure array elements that met the --where predicates, with their index in the file
+int printSelectedElements(VariableList *variables, char *variableName, long start, long count)
+{
+    Variable *var = NULL;
+    Variable *elements = NULL;
+    Variable *tag = NULL;
+    for (size_t i = 0; i < variables->nVariables; i++)
+    {
+        var = &variables->variableList[i];
+        if (var->elementIndices == NULL)
+            continue;
+        fprintf(stdout, "%s: %ld elements selected\n", var->name, var->arrayInfo.nElements);
+        elements = (Variable*)var->data;
+        for (long e = 0; e < var->arrayInfo.nElements; e++)
+        {
+            fprintf(stdout, "[%ld]\n", var->elementIndices[e]);
+            tag = variableName == NULL ? NULL : variableData(&elements[e], variableName);
+            if (tag != NULL && tag != &elements[e])
+                printVariableData(tag, start, count);
+        }
+    }
 
+    return READSAVE_OK;
 }
 
 void usage(char *name)
 {
-    fprintf(stdout, "Usage: %s <file.sav> [--variable-summary] [--variable=<variableName[.tag1][.tag2]...>] [--help] [--about]\n", name);
+    fprintf(stdout, "Usage: %s <file.sav> [--variable-summary] [--layout-summary[=stats]] [--variable=<variableName[.tag1][.tag2]...>] [--slice=<start>,<count>] [--row-major] [--convert=float|double[,<scale>,<offset>]] [--where=<variableName.tag><op><value>] [--decimate=<factor1>[,<factor2>...][,mean]] [--stats-only [--histogram=<nBins>,<min>,<max>] [--threads=<n>]] [--shm-export=<name>] [--extract-to=<out.sav>] [--convert-to-cache=<out.rsc> [--compress=lz4|zstd]] [--socket=<path>] [--help] [--about]\n", name);
+    fprintf(stdout, "       %s <file1.sav> <file2.sav> ... [--variable=<variableName[.tag1][.tag2]...>] [--in-flight=<n>]\n", name);
+    fprintf(stdout, "       %s <file.rsc> [--variable=<variableName[.tag1][.tag2]...>] [--slice=<start>,<count>] [--threads=<n>]\n", name);
+    fprintf(stdout, "       %s <file1.sav> <file2.sav> ... --build-catalog=<out.rcat> [--file-list=<paths.txt>] [--threads=<n>]\n", name);
+    fprintf(stdout, "       %s <file1.sav> <file2.sav> ... --concat --variable=<variableName[.tag1][.tag2]...> [--file-list=<paths.txt>] [--slice=<start>,<count>] [--threads=<n>]\n", name);
+    fprintf(stdout, "       %s <file1.sav> <file2.sav> ... --duplicates [--file-list=<paths.txt>] [--threads=<n>]\n", name);
+    fprintf(stdout, "       %s <catalog.rcat> [--variable=<variableName[.tag1][.tag2]...>] [--dims=<dim1>[,<dim2>...]] [--after=<time>] [--before=<time>]\n", name);
+    fprintf(stdout, "       %s --daemon=<path> [--cache-size=<MB>]\n", name);
     fprintf(stdout, "Reads an IDL save file.\n");
     fprintf(stdout, "Options:\n");
     fprintf(stdout, "%20s : summary of save file variables.\n", "--variable-summary");
+    fprintf(stdout, "%20s : types, dimensions and structure layouts from the definitions only, each structure printed once; =stats adds min, max, mean and NaN count of numeric arrays and tags\n", "--layout-summary[=stats]");
     fprintf(stdout, "%20s : this summary\n", "--help");
     fprintf(stdout, "%20s : author and license information\n", "--about");
     fprintf(stdout, "%s\n", "--variable=<variableName[.tag1][.tag2]...>");
     fprintf(stdout, "%s : operate on variableName, with optional structures tags tag1, tag2, etc., e.g., --variable=SKYMAP.PROJECT_UID\n", "");
+    fprintf(stdout, "%20s : print only <count> values starting at element <start>\n", "--slice=<start>,<count>");
+    fprintf(stdout, "%20s : decode arrays of two or more dimensions in C order, last dimension varying fastest\n", "--row-major");
+    fprintf(stdout, "%20s : convert numeric arrays to float or double as value * scale + offset while decoding\n", "--convert=float|double[,<scale>,<offset>]");
+    fprintf(stdout, "%20s : decode only structure array elements where the scalar tag meets the condition (repeatable; op is ==, !=, <, <=, >, >=)\n", "--where=<variableName.tag><op><value>");
+    fprintf(stdout, "%20s : with several save files, number of files read concurrently (default %d)\n", "--in-flight=<n>", READ_PIPELINE_FILES_IN_FLIGHT);
+    fprintf(stdout, "%20s : print the selected array reduced by a factor along each leading dimension, by stride or block mean, reading only what is needed\n", "--decimate=<factor1>[,<factor2>...][,mean]");
+    fprintf(stdout, "%20s : print min, max, sum, mean and NaN count of the selected variable without decoding it\n", "--stats-only");
+    fprintf(stdout, "%20s : with --stats-only, also print a histogram of <nBins> bins over [min, max)\n", "--histogram=<nBins>,<min>,<max>");
+    fprintf(stdout, "%20s : number of threads used by --stats-only, --build-catalog, --concat and --duplicates, and to decompress cache columns (default 1)\n", "--threads=<n>");
+    fprintf(stdout, "%20s : decode the selected variable into POSIX shared memory segment <name>\n", "--shm-export=<name>");
+    fprintf(stdout, "%20s : copy the --variable records (comma-separated, default all) to <out.sav> without decoding them\n", "--extract-to=<out.sav>");
+    fprintf(stdout, "%20s : write a native-endian columnar cache of the save file to <out.rsc> for fast repeated reads\n", "--convert-to-cache=<out.rsc>");
+    fprintf(stdout, "%20s : compress cache columns in chunks along the slowest dimension\n", "--compress=lz4|zstd");
+    fprintf(stdout, "%20s : treat the variable in the given save files as one array joined along its slowest dimension (structure elements for structure tags), reading only the files the slice touches\n", "--concat");
+    fprintf(stdout, "%20s : list variable records whose types, dimensions and values are identical, by a 64-bit hash of each record\n", "--duplicates");
+    fprintf(stdout, "%20s : scan the definitions of the given save files with --threads threads and write a sorted catalog of their variables to <out.rcat>\n", "--build-catalog=<out.rcat>");
+    fprintf(stdout, "%20s : with --build-catalog, --concat or --duplicates, also use the save files listed one per line in <paths.txt>\n", "--file-list=<paths.txt>");
+    fprintf(stdout, "%20s : with a catalog, list only variables with these dimensions\n", "--dims=<dim1>[,<dim2>...]");
+    fprintf(stdout, "%20s : with a catalog, list only files saved at or after (before) <time>, e.g. 2013-01-07 or 2013-01-07T12:34:56 (UTC)\n", "--after|--before=<time>");
+    fprintf(stdout, "%20s : serve requests on Unix domain socket <path>, caching parsed files\n", "--daemon=<path>");
+    fprintf(stdout, "%20s : memory bound of the daemon's file cache (default %d MB)\n", "--cache-size=<MB>", DAEMON_DEFAULT_CACHE_MB);
+    fprintf(stdout, "%20s : send the request to the daemon listening on <path>\n", "--socket=<path>");
     return;
 }
 
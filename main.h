@@ -21,7 +21,26 @@
 #ifndef _MAIN_H
 #define _MAIN_H
 
-
+#include "readsave.h"
+#include "savecatalog.h"
+
+
+int scanFiles(char **files, long nFiles, char *variableName, int nInFlight);
+int printVariableStats(char *savFile, char *variableName, long nBins, double binMin, double binMax, int nThreads);
+int printLayoutSummary(char *savFile, char *variableName, bool tagStats, int nThreads);
+int parseDecimation(char *text, long *factors, int *nFactors, int *mode);
+int printDecimatedVariable(char *savFile, char *variableName, long *factors, int nFactors, int mode);
+int extractVariables(char *savFile, char *extractFile, char *variableNames);
+int collectFiles(char **argv, int argc, char *fileList, char ***files, long *nFiles, long *nCommandLineFiles);
+void freeFiles(char **files, long nFiles, long nCommandLineFiles);
+int buildCatalog(char *catalogFile, char **argv, int argc, char *fileList, int nThreads);
+int parseCatalogDims(char *text, long *dims);
+int printCatalogMatches(char *catalogFile, CatalogQuery *query);
+int printDuplicateRecords(char **argv, int argc, char *fileList, int nThreads);
+int printConcatenatedVariable(char **argv, int argc, char *fileList, char *variableName, long start, long count, int nThreads);
+int printCacheFile(char *cacheFile, char *columnName, long start, long count, int nThreads);
+int parsePredicate(char *text, ReadSavePredicate *predicate);
+int printSelectedElements(VariableList *variables, char *variableName, long start, long count);
 void usage(char *name);
 void aboutThisProgram(void);
 
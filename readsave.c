@@ -19,6 +19,9 @@
 */
 
 #include "readsave.h"
+#include "saveio.h"
+#include "savestrings.h"
+#include "savehash.h"
 
 #include <stdlib.h>
 #include <stdio.h>
@@ -27,56 +30,153 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <ctype.h>
+#include <strings.h>
+#include <unistd.h>
+#include <pthread.h>
+
+// Dotted paths from ReadSaveOptions, split into upper case fields,
+// and the predicates that filter structure array elements
+typedef struct TagProjection
+{
+    int nPaths;
+    char **buffers;
+    char *(*fields)[READSAVE_MAX_TAG_DEPTH];
+    int *nFields;
+    ReadSavePredicate *predicates;
+    int nPredicates;
+    bool rowMajor;
+    long convertTo;
+    double scaleFactor;
+    double addOffset;
+    int nThreads;
+    bool hashRecords;
+
+} TagProjection;
+
+// ReadSaveOptions.nThreads for the read in progress on this thread
+static __thread long threadLimit = 0;
+
+static int readProjectedVariable(unsigned char *bytes, long nBytes, long *offset, VariableList *variables, TagProjection *projection);
+static long skipTag(unsigned char *bytes, long nBytes, long *offset, Variable *tag);
+static long arrayFileSize(Variable *var);
+static void markStructureArrays(Variable *structure, TagProjection *projection);
+static void markArray(Variable *var, TagProjection *projection);
+static long fileDataType(Variable *var);
+static int readArrayRowMajor(unsigned char *bytes, long nBytes, long *offset, Variable *var);
+
+static void freeTagProjection(TagProjection *projection)
+{
+    for (int p = 0; p < projection->nPaths; p++)
+        free(projection->buffers[p]);
+    free(projection->buffers);
+    free(projection->fields);
+    free(projection->nFields);
+    bzero(projection, sizeof(TagProjection));
+
+    return;
+}
+
+static int initTagProjection(ReadSaveOptions *options, TagProjection *projection)
+{
+    bzero(projection, sizeof(TagProjection));
+    if (options == NULL)
+        return READSAVE_OK;
+    projection->rowMajor = options->rowMajor;
+    projection->hashRecords = options->hashRecords;
+    if (options->convertTo != DataTypeUndefined && options->convertTo != DataTypeFloat && options->convertTo != DataTypeDouble)
+        return READSAVE_ARGUMENTS;
+    projection->convertTo = options->convertTo;
+    projection->scaleFactor = options->scaleFactor;
+    projection->addOffset = options->addOffset;
+    if (options->nThreads < 0)
+        return READSAVE_ARGUMENTS;
+    projection->nThreads = options->nThreads;
+    if (options->nPredicates > 0)
+    {
+        if (options->predicates == NULL)
+            return READSAVE_ARGUMENTS;
+        projection->predicates = options->predicates;
+        projection->nPredicates = options->nPredicates;
+    }
+    if (options->nTagPaths <= 0)
+        return READSAVE_OK;
+    if (options->tagPaths == NULL)
+        return READSAVE_ARGUMENTS;
+
+    projection->buffers = calloc(options->nTagPaths, sizeof(char*));
+    projection->fields = calloc(options->nTagPaths, sizeof(*projection->fields));
+    projection->nFields = calloc(options->nTagPaths, sizeof(int));
+    if (projection->buffers == NULL || projection->fields == NULL || projection->nFields == NULL)
+    {
+        freeTagProjection(projection);
+        return READSAVE_MEM;
+    }
+    projection->nPaths = options->nTagPaths;
+    for (int p = 0; p < options->nTagPaths; p++)
+        projection->nFields[p] = tagPath(options->tagPaths[p], &projection->buffers[p], projection->fields[p], READSAVE_MAX_TAG_DEPTH);
+
+    return READSAVE_OK;
+}
 
 int readSave(char *savFile, SaveInfo *info, VariableList *variables)
+{
+    return readSaveWithOptions(savFile, NULL, info, variables);
+}
+
+int readSaveWithOptions(char *savFile, ReadSaveOptions *options, SaveInfo *info, VariableList *variables)
 {
     if (savFile == NULL || info == NULL || variables == NULL)
         return READSAVE_ARGUMENTS;
 
-    int status = READSAVE_OK;
-    
-    struct stat fileInfo = {0};
-    status = stat(savFile, &fileInfo);
-    if (status != 0)
-        return READSAVE_INPUT_FILE;
-
-    FILE *f = fopen(savFile, "r");
-    if (f == NULL)
-        return READSAVE_INPUT_FILE;
+    TagProjection projection = {0};
+    int status = initTagProjection(options, &projection);
+    if (status != READSAVE_OK)
+        return status;
 
-    unsigned char *bytes = calloc(fileInfo.st_size, 1);
-    if (bytes == NULL)
+    // Records are parsed as soon as they arrive from the reader thread
+    ReadPipeline pipeline = {0};
+    status = startReadPipeline(savFile, READ_PIPELINE_CHUNK_SIZE, &pipeline);
+    if (status != READSAVE_OK)
     {
-        fclose(f);
-        return READSAVE_MEM;
+        freeTagProjection(&projection);
+        return status;
     }
 
-    long nBytes = fileInfo.st_size;
-    size_t read = fread(bytes, 1, fileInfo.st_size, f);
-    fclose(f);
-    if (read != (size_t)nBytes)
+    unsigned char *bytes = pipeline.bytes;
+    long nBytes = pipeline.nBytes;
+
+    status = waitForBytes(&pipeline, 4);
+    if (status != READSAVE_OK || nBytes < 4)
     {
-        free(bytes);
+        stopReadPipeline(&pipeline);
+        freeTagProjection(&projection);
         return READSAVE_INPUT_FILE;
     }
 
     if (strncmp(bytes, "SR", 2) != 0)
     {
-        free(bytes);
+        stopReadPipeline(&pipeline);
+        freeTagProjection(&projection);
         return READSAVE_INPUT_FILE;
     }
 
     if (bytes[2] != 0 || (bytes[3] != 4 && bytes[3] != 5))
     {
-        free(bytes);
+        stopReadPipeline(&pipeline);
+        freeTagProjection(&projection);
         return READSAVE_FILE_VERSION;
     }
 
     long offset = 4;
 
+    // Names repeated across structure elements are stored once
+    if (variables->stringPool == NULL)
+        variables->stringPool = newStringPool();
+    StringPool *previousPool = setActiveStringPool(variables->stringPool);
+    long previousThreadLimit = threadLimit;
+    threadLimit = projection.nThreads;
+
     long recordType = RecordTypeNotHandled;
-    long nextRecordLowWord = 0;
-    long nextRecordHighWord = 0;
     long nextOffset = 0;
 
     char *savInfo[6] = {0};
@@ -85,12 +185,19 @@ int readSave(char *savFile, SaveInfo *info, VariableList *variables)
 
     while (recordType != RecordTypeEndMarker && offset > 0 && offset < nBytes - 4)
     {
-        recordType = readLong(bytes, nBytes, &offset);
-
-        nextRecordLowWord = readULong(bytes, nBytes, &offset);
-        nextRecordHighWord = readULong(bytes, nBytes, &offset);
-        nextOffset = nextRecordLowWord + 65536*nextRecordHighWord;
-        offset += 4;
+        status = waitForBytes(&pipeline, offset + 16);
+        if (status != 0)
+            goto cleanup;
+        readRecordHeader(bytes, nBytes, &offset, &recordType, &nextOffset);
+        if (!recordExtentValid(recordType, offset, nextOffset, nBytes))
+        {
+            status = READSAVE_CORRUPT_RECORD;
+            goto cleanup;
+        }
+        // The whole record must be present before it is decoded
+        status = waitForBytes(&pipeline, recordType == RecordTypeEndMarker ? offset : nextOffset);
+        if (status != 0)
+            goto cleanup;
 
         switch(recordType)
         {
@@ -98,7 +205,7 @@ int readSave(char *savFile, SaveInfo *info, VariableList *variables)
                 offset += 4 * 256;
                 for (int i = 0; i < 3; i++)
                 {
-                    status = readString(bytes, nBytes, &offset, &(savInfo[i]));
+                    status = readString(bytes, nextOffset, &offset, &(savInfo[i]));
                     if (status != 0)
                         goto cleanup;
                 }
@@ -117,7 +224,7 @@ int readSave(char *savFile, SaveInfo *info, VariableList *variables)
             case RecordTypeVersion:
                 for (int i = 3; i < 6; i++)
                 {
-                    status = readString(bytes, nBytes, &offset, &(savInfo[i]));
+                    status = readString(bytes, nextOffset, &offset, &(savInfo[i]));
                     if (status != 0)
                         goto cleanup;
                 }
@@ -128,7 +235,8 @@ int readSave(char *savFile, SaveInfo *info, VariableList *variables)
                 break;
 
             case RecordTypeVariable:
-                status = readVariable(bytes, nBytes, &offset, variables);
+                // Nothing in a variable is read past the end of its record
+                status = readProjectedVariable(bytes, nextOffset, &offset, variables, projection.nPaths > 0 || projection.nPredicates > 0 || projection.rowMajor || projection.convertTo != DataTypeUndefined || projection.hashRecords ? &projection : NULL);
                 if (status != 0)
                     goto cleanup;
                 offset = nextOffset;
@@ -143,16 +251,41 @@ int readSave(char *savFile, SaveInfo *info, VariableList *variables)
 
 cleanup:
 
-    if (bytes != NULL)
-        free(bytes);
-    for (int i = 0; i < 6; i++)
-        if (savInfo[i] != NULL)
-            free(savInfo[i]);
+    stopReadPipeline(&pipeline);
+    // Pooled when the pool could be made
+    for (int i = 0; variables->stringPool == NULL && i < 6; i++)
+        freeString(savInfo[i]);
+    setActiveStringPool(previousPool);
+    threadLimit = previousThreadLimit;
+    freeTagProjection(&projection);
 
     return status;
 
 }
 
+void readRecordHeader(unsigned char *bytes, long nBytes, long *offset, long *recordType, long *nextOffset)
+{
+    *recordType = readLong(bytes, nBytes, offset);
+
+    long nextRecordLowWord = readULong(bytes, nBytes, offset);
+    long nextRecordHighWord = readULong(bytes, nBytes, offset);
+    *nextOffset = nextRecordLowWord + (nextRecordHighWord << 32);
+    *offset += 4;
+
+    return;
+}
+
+// Records other than the end marker must lie within the file and advance the offset
+bool recordExtentValid(long recordType, long offset, long nextOffset, long nBytes)
+{
+    if (offset > nBytes)
+        return false;
+    if (recordType == RecordTypeEndMarker)
+        return true;
+
+    return nextOffset >= offset && nextOffset <= nBytes;
+}
+
 void about(void)
 {
     fprintf(stdout, "ReadSave: IDL save file (.sav) variable reader (C library).\n");
@@ -168,7 +301,9 @@ void about(void)
 int readString(unsigned char *bytes, long nBytes, long *offset, char **str)
 {
     long strLength = readLong(bytes, nBytes, offset);
-    *str = strndup((unsigned char *)(bytes + *offset), (unsigned int) strLength);
+    if (strLength < 0 || *offset + strLength > nBytes)
+        return READSAVE_READ_SCALAR;
+    *str = newString((char *)(bytes + *offset), strLength);
     if (*str == NULL)
         return READSAVE_MEM;
     long padded = 0;
@@ -197,7 +332,7 @@ float readFloat(unsigned char *bytes, long nBytes, long *offset)
 
 double readDouble(unsigned char *bytes, long nBytes, long *offset)
 {
-    if (offset != NULL && bytes != NULL && *offset < nBytes - 3)
+    if (offset != NULL && bytes != NULL && *offset < nBytes - 7)
     {
         unsigned char f[8] = {0};
         for (int i = 0; i < 8; i++)
@@ -211,6 +346,14 @@ double readDouble(unsigned char *bytes, long nBytes, long *offset)
         return 0;
 }
 
+// For callers that have already checked the extent
+static inline long loadLong(unsigned char *bytes, long *offset)
+{
+    long value = (int32_t)((uint32_t)bytes[*offset] << 24 | (uint32_t)bytes[*offset + 1] << 16 | (uint32_t)bytes[*offset + 2] << 8 | bytes[*offset + 3]);
+    *offset += 4;
+    return value;
+}
+
 long readLong(unsigned char *bytes, long nBytes, long *offset)
 {
     if (offset != NULL && bytes != NULL && *offset < nBytes - 3)
@@ -225,9 +368,9 @@ long readLong(unsigned char *bytes, long nBytes, long *offset)
 
 unsigned long readULong(unsigned char *bytes, long nBytes, long *offset)
 {
-    if (offset != NULL && bytes != NULL && *offset < nBytes)
+    if (offset != NULL && bytes != NULL && *offset < nBytes - 3)
     {
-        unsigned long value = bytes[*offset + 3] + 256 * bytes[*offset + 2] + 256 * 256 * bytes[*offset + 1] + 256 * 256 * 256 * bytes[*offset];
+        unsigned long value = (unsigned long)bytes[*offset + 3] + 256UL * bytes[*offset + 2] + 256UL * 256 * bytes[*offset + 1] + 256UL * 256 * 256 * bytes[*offset];
         *offset+=4;
         return value; 
     }
@@ -237,7 +380,7 @@ unsigned long readULong(unsigned char *bytes, long nBytes, long *offset)
 
 short readShort(unsigned char *bytes, long nBytes, long *offset)
 {
-    if (offset != NULL && bytes != NULL && *offset < nBytes)
+    if (offset != NULL && bytes != NULL && *offset < nBytes - 3)
     {
         short value = (short)(bytes[*offset + 3] + 256 * bytes[*offset + 2]);
         *offset += 4;
@@ -249,7 +392,7 @@ short readShort(unsigned char *bytes, long nBytes, long *offset)
 
 unsigned short readUShort(unsigned char *bytes, long nBytes, long *offset)
 {
-    if (offset != NULL && bytes != NULL && *offset < nBytes)
+    if (offset != NULL && bytes != NULL && *offset < nBytes - 3)
     {
         unsigned short value = bytes[*offset + 3] + 256 * bytes[*offset + 2];
         *offset += 4;
@@ -261,7 +404,7 @@ unsigned short readUShort(unsigned char *bytes, long nBytes, long *offset)
 
 unsigned char readByte(unsigned char *bytes, long nBytes, long *offset)
 {
-    if (offset != NULL && bytes != NULL && *offset < nBytes)
+    if (offset != NULL && bytes != NULL && *offset < nBytes - 7)
     {
         long redundant = readLong(bytes, nBytes, offset);
         unsigned char value = bytes[*offset];
@@ -272,21 +415,482 @@ unsigned char readByte(unsigned char *bytes, long nBytes, long *offset)
         return 0;
 }
 
+typedef struct StructureTask
+{
+    unsigned char *bytes;
+    long nBytes;
+    Variable *elements;
+    long *offsets;
+    long first;
+    long count;
+    StringPool *pool;
+    long threadLimit;
+    int status;
+
+} StructureTask;
+
+// One thread per workPerThread units, up to the online processors or
+// the number set in ReadSaveOptions
+static long decodingThreads(long nUnits, long workPerThread)
+{
+    long nThreads = threadLimit > 0 ? threadLimit : sysconf(_SC_NPROCESSORS_ONLN);
+    if (nThreads > nUnits / workPerThread)
+        nThreads = nUnits / workPerThread;
+    if (nThreads < 1)
+        nThreads = 1;
+
+    return nThreads;
+}
+
+static void *structureThread(void *arg)
+{
+    StructureTask *task = (StructureTask*)arg;
+    StringPool *previousPool = setActiveStringPool(task->pool);
+    long previousThreadLimit = threadLimit;
+    threadLimit = task->threadLimit;
+
+    long offset = 0;
+    for (long e = task->first; e < task->first + task->count && task->status == READSAVE_OK; e++)
+    {
+        offset = task->offsets[e];
+        task->status = readStructure(task->bytes, task->nBytes, &offset, &task->elements[e]);
+    }
+
+    setActiveStringPool(previousPool);
+    threadLimit = previousThreadLimit;
+
+    return NULL;
+}
+
+// A predicate resolved to tag indices within one structure definition
+typedef struct ElementPredicate
+{
+    ReadSavePredicate *predicate;
+    int path[READSAVE_MAX_TAG_DEPTH];
+    int depth;
+    long dataType;
+
+} ElementPredicate;
+
+static int compileElementPredicates(Variable *definition, TagProjection *projection, ElementPredicate *compiled, int *nCompiled)
+{
+    *nCompiled = 0;
+    char *buffer = NULL;
+    char *fields[READSAVE_MAX_TAG_DEPTH] = {0};
+    int nFields = 0;
+    for (int p = 0; p < projection->nPredicates; p++)
+    {
+        nFields = tagPath(projection->predicates[p].tagPath, &buffer, fields, READSAVE_MAX_TAG_DEPTH);
+        if (nFields < 2 || strcasecmp(fields[0], definition->name) != 0)
+        {
+            free(buffer);
+            continue;
+        }
+        ElementPredicate *element = &compiled[(*nCompiled)++];
+        element->predicate = &projection->predicates[p];
+        element->depth = 0;
+        Variable *structure = definition;
+        Variable *tag = NULL;
+        for (int f = 1; f < nFields && structure != NULL; f++)
+        {
+            tag = NULL;
+            for (int t = 0; structure->isStructure && t < structure->structInfo.nTags; t++)
+                if (strcasecmp(((Variable*)structure->data)[t].name, fields[f]) == 0)
+                {
+                    tag = &((Variable*)structure->data)[t];
+                    element->path[element->depth++] = t;
+                    break;
+                }
+            structure = tag;
+        }
+        free(buffer);
+        // Conditions apply to scalar tags only
+        if (tag == NULL || element->depth != nFields - 1 || !tag->isScalar || (tag->dataType != DataTypeString && dataTypeSize(tag->dataType) == 0))
+            return READSAVE_ARGUMENTS;
+        element->dataType = tag->dataType;
+    }
+
+    return READSAVE_OK;
+}
+
+static bool compare(double a, double b, int comparison)
+{
+    switch (comparison)
+    {
+        case ReadSaveEqual:
+            return a == b;
+        case ReadSaveNotEqual:
+            return a != b;
+        case ReadSaveLess:
+            return a < b;
+        case ReadSaveLessEqual:
+            return a <= b;
+        case ReadSaveGreater:
+            return a > b;
+        case ReadSaveGreaterEqual:
+            return a >= b;
+        default:
+            return false;
+    }
+}
+
+// Evaluates a predicate on the raw big-endian bytes of one element
+static bool elementMatches(unsigned char *bytes, long nBytes, long offset, Variable *definition, ElementPredicate *element)
+{
+    Variable *structure = definition;
+    for (int d = 0; d < element->depth; d++)
+    {
+        for (int t = 0; t < element->path[d]; t++)
+            skipTag(bytes, nBytes, &offset, &((Variable*)structure->data)[t]);
+        structure = &((Variable*)structure->data)[element->path[d]];
+    }
+
+    double value = 0.0;
+    long length = 0;
+    char *string = NULL;
+    int difference = 0;
+    unsigned long high = 0;
+    unsigned long low = 0;
+    switch (element->dataType)
+    {
+        case DataTypeString:
+            length = readLong(bytes, nBytes, &offset);
+            if (length > 0)
+                length = readLong(bytes, nBytes, &offset);
+            if (length < 0 || offset + length > nBytes)
+                return false;
+            string = element->predicate->string == NULL ? "" : element->predicate->string;
+            difference = strncmp((char*)bytes + offset, string, length);
+            if (difference == 0 && string[length] != '\0')
+                difference = -1;
+            return compare((double)difference, 0.0, element->predicate->comparison);
+        case DataTypeByte:
+            value = readByte(bytes, nBytes, &offset);
+            break;
+        case DataTypeInt16:
+            value = readShort(bytes, nBytes, &offset);
+            break;
+        case DataTypeUInt16:
+            value = readUShort(bytes, nBytes, &offset);
+            break;
+        case DataTypeInt32:
+            value = (int32_t)readULong(bytes, nBytes, &offset);
+            break;
+        case DataTypeUInt32:
+            value = readULong(bytes, nBytes, &offset);
+            break;
+        case DataTypeInt64:
+        case DataTypeUInt64:
+            high = readULong(bytes, nBytes, &offset);
+            low = readULong(bytes, nBytes, &offset);
+            if (element->dataType == DataTypeInt64)
+                value = (int64_t)((high << 32) | low);
+            else
+                value = (high << 32) | low;
+            break;
+        case DataTypeFloat:
+            value = readFloat(bytes, nBytes, &offset);
+            break;
+        case DataTypeDouble:
+            value = readDouble(bytes, nBytes, &offset);
+            break;
+        default:
+            return false;
+    }
+
+    return compare(value, element->predicate->value, element->predicate->comparison);
+}
+
+// Strings make element sizes vary, so element offsets come from a cheap
+// skipStructure() prescan. Predicates are checked on the raw bytes during
+// the prescan, and only the elements that pass are created and decoded in parallel.
+static int readStructureElements(unsigned char *bytes, long nBytes, long *offset, Variable *var, Variable *definition, TagProjection *projection)
+{
+    long nElements = var->arrayInfo.nElements;
+    if (nElements < 1)
+        return READSAVE_OK;
+
+    ElementPredicate compiled[projection != NULL && projection->nPredicates > 0 ? projection->nPredicates : 1];
+    int nCompiled = 0;
+    int status = READSAVE_OK;
+    if (projection != NULL)
+    {
+        status = compileElementPredicates(definition, projection, compiled, &nCompiled);
+        if (status != READSAVE_OK)
+            return status;
+    }
+
+    long *offsets = malloc((nElements + 1) * sizeof(long));
+    long *indices = nCompiled > 0 ? malloc(nElements * sizeof(long)) : NULL;
+    if (offsets == NULL || (nCompiled > 0 && indices == NULL))
+    {
+        free(offsets);
+        free(indices);
+        return READSAVE_MEM;
+    }
+
+    long elementOffset = *offset;
+    long nSelected = 0;
+    bool selected = true;
+    for (long e = 0; e < nElements && elementOffset <= nBytes; e++)
+    {
+        // Selected offsets are packed at the front; e never trails nSelected
+        offsets[nSelected] = elementOffset;
+        skipStructure(bytes, nBytes, &elementOffset, definition);
+        selected = elementOffset <= nBytes;
+        for (int p = 0; p < nCompiled && selected; p++)
+            selected = elementMatches(bytes, nBytes, offsets[nSelected], definition, &compiled[p]);
+        if (selected && indices != NULL)
+            indices[nSelected] = e;
+        if (selected)
+            nSelected++;
+    }
+    if (elementOffset > nBytes)
+    {
+        free(offsets);
+        free(indices);
+        return READSAVE_READ_STRUCTURE;
+    }
+    *offset = elementOffset;
+
+    if (indices != NULL)
+    {
+        // Filtered elements form a one dimensional array
+        var->elementIndices = indices;
+        var->arrayInfo.nElements = nSelected;
+        var->arrayInfo.nBytes = nSelected * var->arrayInfo.nBytesPerElement;
+        var->arrayInfo.nDims = 1;
+        var->arrayInfo.dims[0] = nSelected;
+        for (int d = 1; d < 8; d++)
+            var->arrayInfo.dims[d] = 1;
+    }
+    if (nSelected == 0)
+    {
+        free(offsets);
+        return READSAVE_OK;
+    }
+
+    Variable *elements = calloc(nSelected, sizeof(Variable));
+    if (elements == NULL)
+    {
+        free(offsets);
+        return READSAVE_MEM;
+    }
+    var->data = elements;
+    for (long e = 0; e < nSelected && status == READSAVE_OK; e++)
+    {
+        status = copyStructure(&elements[e], definition);
+        elements[e].isArray = false;
+    }
+    if (status != READSAVE_OK)
+    {
+        free(offsets);
+        return status;
+    }
+
+    long nThreads = decodingThreads(nSelected, READSAVE_STRUCTURE_ELEMENTS_PER_THREAD);
+
+    StructureTask *tasks = calloc(nThreads, sizeof(StructureTask));
+    pthread_t *threads = calloc(nThreads, sizeof(pthread_t));
+    bool *started = calloc(nThreads, sizeof(bool));
+    if (tasks == NULL || threads == NULL || started == NULL)
+    {
+        free(tasks);
+        free(threads);
+        free(started);
+        free(offsets);
+        return READSAVE_MEM;
+    }
+
+    long perThread = (nSelected + nThreads - 1) / nThreads;
+    for (long t = 0; t < nThreads; t++)
+    {
+        tasks[t].bytes = bytes;
+        tasks[t].nBytes = nBytes;
+        tasks[t].elements = elements;
+        tasks[t].offsets = offsets;
+        tasks[t].first = t * perThread;
+        tasks[t].count = nSelected - tasks[t].first < perThread ? nSelected - tasks[t].first : perThread;
+        tasks[t].pool = activeStringPool();
+        tasks[t].threadLimit = threadLimit;
+        // The calling thread takes the last share
+        if (t < nThreads - 1)
+            started[t] = pthread_create(&threads[t], NULL, structureThread, &tasks[t]) == 0;
+    }
+    for (long t = 0; t < nThreads; t++)
+        if (!started[t])
+            structureThread(&tasks[t]);
+
+    for (long t = 0; t < nThreads; t++)
+    {
+        if (started[t])
+            pthread_join(threads[t], NULL);
+        if (tasks[t].status != READSAVE_OK)
+            status = tasks[t].status;
+    }
+
+    free(tasks);
+    free(threads);
+    free(started);
+    free(offsets);
+
+    return status;
+}
+
+// Whether a variable named by the length-prefixed string at offset is in the projection
+static bool variableSelected(unsigned char *bytes, long nBytes, long offset, TagProjection *projection)
+{
+    long nameLength = readLong(bytes, nBytes, &offset);
+    if (nameLength < 0 || offset + nameLength > nBytes)
+        return true;
+
+    for (int p = 0; p < projection->nPaths; p++)
+        if (projection->nFields[p] > 0 && strlen(projection->fields[p][0]) == (size_t)nameLength && strncasecmp(projection->fields[p][0], (char*)bytes + offset, nameLength) == 0)
+            return true;
+
+    return false;
+}
+
+static void markSkipped(Variable *var)
+{
+    var->skipped = true;
+    if (var->isStructure && var->data != NULL)
+        for (int i = 0; i < var->structInfo.nTags; i++)
+            markSkipped(&((Variable*)var->data)[i]);
+
+    return;
+}
+
+// Marks the tags of a structure that no path in the projection reaches.
+// matching[p] is true for paths whose fields up to depth name this structure.
+static void projectTags(Variable *structure, TagProjection *projection, bool *matching, int depth)
+{
+    bool nested[projection->nPaths];
+    bool whole = false;
+    bool partial = false;
+    Variable *tag = NULL;
+    for (int i = 0; i < structure->structInfo.nTags; i++)
+    {
+        tag = &((Variable*)structure->data)[i];
+        whole = false;
+        partial = false;
+        for (int p = 0; p < projection->nPaths; p++)
+        {
+            nested[p] = false;
+            if (!matching[p] || projection->nFields[p] <= depth || tag->name == NULL || strcasecmp(projection->fields[p][depth], tag->name) != 0)
+                continue;
+            if (projection->nFields[p] == depth + 1)
+                whole = true;
+            else
+                partial = nested[p] = true;
+        }
+        if (whole)
+            continue;
+        else if (partial && tag->isStructure)
+            projectTags(tag, projection, nested, depth + 1);
+        else
+            markSkipped(tag);
+    }
+
+    return;
+}
+
+// Applies the layout and conversion options to an array before it is decoded
+static void markArray(Variable *var, TagProjection *projection)
+{
+    var->rowMajor = projection->rowMajor;
+    if (projection->convertTo == DataTypeUndefined)
+        return;
+
+    switch (var->dataType)
+    {
+        case DataTypeByte:
+        case DataTypeInt16:
+        case DataTypeUInt16:
+        case DataTypeInt32:
+        case DataTypeUInt32:
+        case DataTypeInt64:
+        case DataTypeUInt64:
+        case DataTypeFloat:
+        case DataTypeDouble:
+            var->fileDataType = var->dataType;
+            var->dataType = projection->convertTo;
+            var->scaleFactor = projection->scaleFactor;
+            var->addOffset = projection->addOffset;
+            var->arrayInfo.nBytesPerElement = dataTypeSize(var->dataType);
+            var->arrayInfo.nBytes = var->arrayInfo.nElements * var->arrayInfo.nBytesPerElement;
+            break;
+        default:
+            break;
+    }
+
+    return;
+}
+
+static void markStructureArrays(Variable *structure, TagProjection *projection)
+{
+    Variable *tag = NULL;
+    for (int i = 0; i < structure->structInfo.nTags; i++)
+    {
+        tag = &((Variable*)structure->data)[i];
+        if (tag->skipped)
+            continue;
+        if (tag->isStructure)
+            markStructureArrays(tag, projection);
+        else if (tag->isArray)
+            markArray(tag, projection);
+    }
+
+    return;
+}
+
+static void projectStructure(Variable *structure, TagProjection *projection)
+{
+    bool matching[projection->nPaths];
+    for (int p = 0; p < projection->nPaths; p++)
+    {
+        matching[p] = projection->nFields[p] > 0 && strcasecmp(projection->fields[p][0], structure->name) == 0;
+        // The whole variable was asked for
+        if (matching[p] && projection->nFields[p] == 1)
+            return;
+    }
+    projectTags(structure, projection, matching, 1);
+
+    return;
+}
+
 int readVariable(unsigned char *bytes, long nBytes, long *offset, VariableList *variables)
 {
+    return readProjectedVariable(bytes, nBytes, offset, variables, NULL);
+}
+
+static int readProjectedVariable(unsigned char *bytes, long nBytes, long *offset, VariableList *variables, TagProjection *projection)
+{
+    if (projection != NULL && projection->nPaths > 0 && !variableSelected(bytes, nBytes, *offset, projection))
+        return READSAVE_OK;
+
     void *mem = realloc(variables->variableList, sizeof(Variable)*(variables->nVariables + 1));
     if (mem == NULL)
         return READSAVE_MEM;
 
+    // Inline scalars moved with the list
+    if (mem != variables->variableList)
+        for (size_t i = 0; i < variables->nVariables; i++)
+            if (((Variable*)mem)[i].hasInlineData)
+                ((Variable*)mem)[i].data = ((Variable*)mem)[i].inlineData;
     variables->variableList = mem;
     variables->nVariables++;
     Variable *var = &(variables->variableList[variables->nVariables-1]);
     bzero(var, sizeof(Variable));
+    var->pooledStrings = activeStringPool() != NULL;
 
     int status = 0;
     status = readString(bytes, nBytes, offset, &var->name);
     if (status != 0)
         return status;
+    // Taken while the record is at hand, so duplicates need no second pass
+    if (projection != NULL && projection->hashRecords)
+        var->recordHash = variableRecordHash(bytes, nBytes, *offset);
 
     long dataType = readLong(bytes, nBytes, offset);
     var->dataType = dataType;
@@ -299,11 +903,11 @@ int readVariable(unsigned char *bytes, long nBytes, long *offset, VariableList *
     long variableStart = 0;
 
     // Read additional variable information as required
-    Variable *tmp = NULL;
     if (var->isStructure)
     {
         Variable structDefinition = {0};
-        structDefinition.name = strdup(var->name);
+        structDefinition.name = newString(var->name, strlen(var->name));
+        structDefinition.pooledStrings = var->pooledStrings;
         structDefinition.isArray = true;
         structDefinition.isStructure = true;
         structDefinition.dataType = DataTypeStructure;
@@ -313,60 +917,54 @@ int readVariable(unsigned char *bytes, long nBytes, long *offset, VariableList *
             return status;
  
         status = initStructure(bytes, nBytes, offset, &structDefinition);
+        // The definition describes a single element
+        structDefinition.isArray = false;
         if (status != 0)
+        {
+            freeVariable(&structDefinition);
             return status;
- 
-        void *mem = calloc(structDefinition.arrayInfo.nElements, sizeof(Variable));
-        if (mem == NULL)
-            return READSAVE_MEM;
- 
-        var->data = mem;
+        }
+        if (projection != NULL && projection->nPaths > 0)
+            projectStructure(&structDefinition, projection);
+        if (projection != NULL)
+            markStructureArrays(&structDefinition, projection);
+
         memcpy(&var->arrayInfo, &structDefinition.arrayInfo, sizeof(ArrayInfo));
         status = copyStructureInfo(&var->structInfo, &structDefinition.structInfo);
-        if (status != 0)
-            return status;
- 
-        for (int i = 0; i < structDefinition.arrayInfo.nElements; i++)
-        {
-            tmp = &(((Variable*)var->data)[i]);
-            status = copyStructure(tmp, &structDefinition);
-            tmp->isArray=false;
-            if (status != 0)
-                return status;
-        }
+        if (status == 0 && readLong(bytes, nBytes, offset) != 7)
+            status = READSAVE_READ_VARIABLE;
+        // Elements are created once the filter has picked them
+        if (status == 0)
+            status = readStructureElements(bytes, nBytes, offset, var, &structDefinition, projection);
+        freeVariable(&structDefinition);
+
+        return status;
     }
     else if (var->isArray)
     {
         status = initArray(bytes, nBytes, offset, var);
         if (status != 0)
             return status;
+        // A corrupt element count must not drive the allocation
+        if (var->dataType != DataTypeString && *offset + 4 + arrayFileSize(var) > nBytes)
+            return READSAVE_READ_ARRAY;
+        if (projection != NULL)
+            markArray(var, projection);
+        var->data = calloc(var->arrayInfo.nElements, var->arrayInfo.nBytesPerElement);
+        if (var->data == NULL)
+            return READSAVE_MEM;
     }
     variableStart = readLong(bytes, nBytes, offset);
     if (variableStart != 7)
             return READSAVE_READ_VARIABLE;
-    if (var->isStructure)
-    {
-        for (int i = 0; i < var->arrayInfo.nElements; i++)
-        {
-            status = readStructure(bytes, nBytes, offset, &(((Variable*)var->data)[i]));
-            if (status != 0)
-                return status;
-        }
-    }
-    else if (var->isArray)
+    if (var->isArray)
     {
-        variableStart = readLong(bytes, nBytes, offset);
-        if (variableStart != 7)
-            return READSAVE_READ_VARIABLE;
         status = readArray(bytes, nBytes, offset, var);
         if (status != 0)
             return status;
     }
     else
     {
-        variableStart = readLong(bytes, nBytes, offset);
-        if (variableStart != 7)
-            return READSAVE_READ_VARIABLE;
         status = readScalar(bytes, nBytes, offset, var);
         if (status != 0)
             return status;
@@ -376,123 +974,569 @@ int readVariable(unsigned char *bytes, long nBytes, long *offset, VariableList *
 
 }
 
+typedef void (*ScalarDecoder)(unsigned char *bytes, unsigned char *value);
+
+typedef struct ScalarCodec
+{
+    long nFileBytes;
+    ScalarDecoder decode;
+
+} ScalarCodec;
+
+// Bytes are preceded by a redundant length
+static void decodeByte(unsigned char *bytes, unsigned char *value)
+{
+    value[0] = bytes[4];
+}
+
+// Shorts are padded to 32 bits
+static void decodeInt16(unsigned char *bytes, unsigned char *value)
+{
+    uint32_t word = 0;
+    memcpy(&word, bytes, 4);
+    int16_t v = (int16_t)__builtin_bswap32(word);
+    memcpy(value, &v, sizeof(v));
+}
+
+static void decode32(unsigned char *bytes, unsigned char *value)
+{
+    uint32_t word = 0;
+    memcpy(&word, bytes, 4);
+    word = __builtin_bswap32(word);
+    memcpy(value, &word, 4);
+}
+
+static void decode64(unsigned char *bytes, unsigned char *value)
+{
+    uint64_t word = 0;
+    memcpy(&word, bytes, 8);
+    word = __builtin_bswap64(word);
+    memcpy(value, &word, 8);
+}
+
+static void decodeComplexFloat(unsigned char *bytes, unsigned char *value)
+{
+    decode32(bytes, value);
+    decode32(bytes + 4, value + 4);
+}
+
+static void decodeComplexDouble(unsigned char *bytes, unsigned char *value)
+{
+    decode64(bytes, value);
+    decode64(bytes + 8, value + 8);
+}
+
+// Indexed by DataTypes. Heap pointers and object references keep their
+// 32-bit heap index.
+static const ScalarCodec scalarCodecs[] = {
+    [DataTypeByte] = {8, decodeByte},
+    [DataTypeInt16] = {4, decodeInt16},
+    [DataTypeInt32] = {4, decode32},
+    [DataTypeFloat] = {4, decode32},
+    [DataTypeDouble] = {8, decode64},
+    [DataTypeComplexFloat] = {8, decodeComplexFloat},
+    [DataTypeComplexDouble] = {16, decodeComplexDouble},
+    [DataTypeHeapPointer] = {4, decode32},
+    [DataTypeObjectReference] = {4, decode32},
+    [DataTypeUInt16] = {4, decodeInt16},
+    [DataTypeUInt32] = {4, decode32},
+    [DataTypeInt64] = {8, decode64},
+    [DataTypeUInt64] = {8, decode64},
+};
+
 int readScalar(unsigned char *bytes, long nBytes, long *offset, Variable *var)
 {
     if (offset == NULL || bytes == NULL || *offset >= nBytes || var == NULL)
         return READSAVE_ARGUMENTS;
 
-    void *mem = NULL;
+    if (var->dataType == DataTypeString)
+    {
+        // Empty strings have no second length or characters
+        long length = readLong(bytes, nBytes, offset) > 0 ? readLong(bytes, nBytes, offset) : 0;
+        if (length < 0 || *offset + length > nBytes)
+            return READSAVE_READ_SCALAR;
+        if (length < (long)sizeof(var->inlineData))
+        {
+            memcpy(var->inlineData, bytes + *offset, length);
+            var->inlineData[length] = '\0';
+            var->hasInlineData = true;
+            var->data = var->inlineData;
+        }
+        else
+        {
+            var->data = newString((char*)(bytes + *offset), length);
+            if (var->data == NULL)
+                return READSAVE_MEM;
+        }
+        *offset += 4 * ((length + 3) / 4);
+        return READSAVE_OK;
+    }
+
+    if (var->dataType < 0 || var->dataType >= (long)(sizeof(scalarCodecs) / sizeof(ScalarCodec)) || scalarCodecs[var->dataType].decode == NULL)
+        return READSAVE_OK;
+
+    const ScalarCodec *codec = &scalarCodecs[var->dataType];
+    if (*offset + codec->nFileBytes > nBytes)
+        return READSAVE_READ_SCALAR;
+
+    codec->decode(bytes + *offset, var->inlineData);
+    var->hasInlineData = true;
+    var->data = var->inlineData;
+    *offset += codec->nFileBytes;
+
+    return READSAVE_OK;
+}
+
+int initArray(unsigned char *bytes, long nBytes, long *offset, Variable *var)
+{
+    if (offset == NULL || bytes == NULL || *offset >= nBytes || var == NULL)
+        return READSAVE_ARGUMENTS;
+
+    // The eight descriptor longs are checked once
+    if (*offset + 4 * 8 > nBytes)
+        return READSAVE_READ_ARRAY;
+
+    long arrayStart = loadLong(bytes, offset);
+    if (arrayStart != 8)
+        return READSAVE_READ_ARRAY;
+
+    var->isArray = true;
 
     int status = 0;
 
-    long redundant = 0;
-    switch (var->dataType)
+    var->arrayInfo.nBytesPerElement = loadLong(bytes, offset);
+    if (var->isStructure)
+        var->arrayInfo.nBytesPerElement = sizeof(Variable);
+
+    var->arrayInfo.nBytes = loadLong(bytes, offset);
+    var->arrayInfo.nElements = loadLong(bytes, offset);
+    var->arrayInfo.nDims = loadLong(bytes, offset);
+    var->arrayInfo.unknown1 = loadLong(bytes, offset);
+    var->arrayInfo.unknown2 = loadLong(bytes, offset);
+    var->arrayInfo.nMax = loadLong(bytes, offset);
+
+    if (var->arrayInfo.nMax < 0 || var->arrayInfo.nMax > 8 || var->arrayInfo.nDims < 0 || var->arrayInfo.nDims > 8 || var->arrayInfo.nElements < 0 || *offset + 4 * var->arrayInfo.nMax > nBytes)
+        return READSAVE_READ_ARRAY;
+    // Decoding writes dataTypeSize() bytes per element
+    if (!var->isStructure && var->dataType != DataTypeString && dataTypeSize(var->dataType) > 0 && var->arrayInfo.nBytesPerElement != dataTypeSize(var->dataType))
+        return READSAVE_READ_ARRAY;
+
+    for (int i = 0; i < var->arrayInfo.nMax; i++)
+        var->arrayInfo.dims[i] = loadLong(bytes, offset);
+
+    return READSAVE_OK;
+}
+
+// The data type of array values in the file, before any conversion
+static long fileDataType(Variable *var)
+{
+    return var->fileDataType != DataTypeUndefined ? var->fileDataType : var->dataType;
+}
+
+// Bytes between consecutive array values in the file
+static long fileElementStride(long dataType)
+{
+    switch (dataType)
     {
-        case DataTypeString:
-            char *str = NULL;
-            long redundant = readLong(bytes, nBytes, offset);
-            status = readString(bytes, nBytes, offset, &str);
-            if (status != 0)
-                return status;
-            var->data = str;
+        case DataTypeInt16:
+        case DataTypeUInt16:
+            return 4;
+        default:
+            return dataTypeSize(dataType);
+    }
+}
+
+// Size of the array data in the file, including padding
+static long arrayFileSize(Variable *var)
+{
+    long nElements = var->arrayInfo.nElements;
+    long size = dataTypeSize(fileDataType(var));
+    switch (fileDataType(var))
+    {
+        case DataTypeByte:
+            // Preceded by a redundant length
+            return 4 + 4 * ((nElements + 3) / 4);
+        case DataTypeInt16:
+        case DataTypeUInt16:
+            return 4 * nElements;
+        default:
+            return size * nElements;
+    }
+}
+
+// String arrays are stored Arrow-style in one allocation: nElements + 1
+// offsets, then the NUL-terminated characters. A prescan sizes the blob.
+static int readStringArray(unsigned char *bytes, long nBytes, long *offset, Variable *var)
+{
+    long nElements = var->arrayInfo.nElements;
+    long start = *offset;
+    long nCharacters = 0;
+    long length = 0;
+    for (long i = 0; i < nElements; i++)
+    {
+        length = readLong(bytes, nBytes, offset) > 0 ? readLong(bytes, nBytes, offset) : 0;
+        if (length < 0 || *offset + length > nBytes)
+            return READSAVE_READ_ARRAY;
+        nCharacters += length + 1;
+        *offset += 4 * ((length + 3) / 4);
+    }
+
+    unsigned char *mem = malloc((nElements + 1) * sizeof(long) + nCharacters);
+    if (mem == NULL)
+        return READSAVE_MEM;
+    long *offsets = (long*)mem;
+    char *characters = (char*)(offsets + nElements + 1);
+
+    *offset = start;
+    long position = 0;
+    for (long i = 0; i < nElements; i++)
+    {
+        offsets[i] = position;
+        length = readLong(bytes, nBytes, offset) > 0 ? readLong(bytes, nBytes, offset) : 0;
+        memcpy(characters + position, bytes + *offset, length);
+        characters[position + length] = '\0';
+        position += length + 1;
+        *offset += 4 * ((length + 3) / 4);
+    }
+    offsets[nElements] = position;
+
+    free(var->data);
+    var->data = mem;
+
+    return READSAVE_OK;
+}
+
+char *stringArrayElement(Variable *var, long index)
+{
+    if (var == NULL || var->data == NULL || var->dataType != DataTypeString || !var->isArray || index < 0 || index >= var->arrayInfo.nElements)
+        return NULL;
+
+    long *offsets = (long*)var->data;
+
+    return (char*)(offsets + var->arrayInfo.nElements + 1) + offsets[index];
+}
+
+static inline uint32_t loadBigEndian32(unsigned char *bytes)
+{
+    uint32_t word = 0;
+    memcpy(&word, bytes, 4);
+    return __builtin_bswap32(word);
+}
+
+static inline uint64_t loadBigEndian64(unsigned char *bytes)
+{
+    uint64_t word = 0;
+    memcpy(&word, bytes, 8);
+    return __builtin_bswap64(word);
+}
+
+static inline float loadFloat(unsigned char *bytes)
+{
+    uint32_t word = loadBigEndian32(bytes);
+    float value = 0;
+    memcpy(&value, &word, 4);
+    return value;
+}
+
+static inline double loadDouble(unsigned char *bytes)
+{
+    uint64_t word = loadBigEndian64(bytes);
+    double value = 0;
+    memcpy(&value, &word, 8);
+    return value;
+}
+
+#define loadByte(bytes) (*(bytes))
+#define loadInt16(bytes) ((int16_t)loadBigEndian32(bytes))
+#define loadUInt16(bytes) ((uint16_t)loadBigEndian32(bytes))
+#define loadInt32(bytes) ((int32_t)loadBigEndian32(bytes))
+#define loadInt64(bytes) ((int64_t)loadBigEndian64(bytes))
+
+// One loop per source and target type, computed in the target type
+#define CONVERT_ELEMENTS(type, load) \
+    for (long i = 0; i < count; i++) \
+        ((type*)out)[i] = (type)load(in + i * step) * (type)var->scaleFactor + (type)var->addOffset
+
+// Converts count values, inStride elements apart in the file, to the
+// variable's data type in a single pass
+static void convertElements(Variable *var, unsigned char *in, long inStride, long count, unsigned char *out)
+{
+    long step = inStride * fileElementStride(var->fileDataType);
+    bool toFloat = var->dataType == DataTypeFloat;
+    switch (var->fileDataType)
+    {
+        case DataTypeByte:
+            if (toFloat)
+                CONVERT_ELEMENTS(float, loadByte);
+            else
+                CONVERT_ELEMENTS(double, loadByte);
+            break;
+        case DataTypeInt16:
+            if (toFloat)
+                CONVERT_ELEMENTS(float, loadInt16);
+            else
+                CONVERT_ELEMENTS(double, loadInt16);
+            break;
+        case DataTypeUInt16:
+            if (toFloat)
+                CONVERT_ELEMENTS(float, loadUInt16);
+            else
+                CONVERT_ELEMENTS(double, loadUInt16);
             break;
+        case DataTypeInt32:
+            if (toFloat)
+                CONVERT_ELEMENTS(float, loadInt32);
+            else
+                CONVERT_ELEMENTS(double, loadInt32);
+            break;
+        case DataTypeUInt32:
+            if (toFloat)
+                CONVERT_ELEMENTS(float, loadBigEndian32);
+            else
+                CONVERT_ELEMENTS(double, loadBigEndian32);
+            break;
+        case DataTypeInt64:
+            if (toFloat)
+                CONVERT_ELEMENTS(float, loadInt64);
+            else
+                CONVERT_ELEMENTS(double, loadInt64);
+            break;
+        case DataTypeUInt64:
+            if (toFloat)
+                CONVERT_ELEMENTS(float, loadBigEndian64);
+            else
+                CONVERT_ELEMENTS(double, loadBigEndian64);
+            break;
+        case DataTypeFloat:
+            if (toFloat)
+                CONVERT_ELEMENTS(float, loadFloat);
+            else
+                CONVERT_ELEMENTS(double, loadFloat);
+            break;
+        case DataTypeDouble:
+            if (toFloat)
+                CONVERT_ELEMENTS(float, loadDouble);
+            else
+                CONVERT_ELEMENTS(double, loadDouble);
+            break;
+        default:
+            break;
+    }
+
+    return;
+}
+
+#undef CONVERT_ELEMENTS
+#undef loadByte
+#undef loadInt16
+#undef loadUInt16
+#undef loadInt32
+#undef loadInt64
+
+// Decodes count elements of the file's fastest and slowest dimensions into a
+// tile of the C order output. Columns of the tile are contiguous in the file,
+// rows in the output; the type is dispatched once per tile.
+static void decodeTile(Variable *var, unsigned char *in, long inStride, unsigned char *out, long outStride, long nRows, long nColumns)
+{
+    if (var->fileDataType != DataTypeUndefined)
+    {
+        long fileStride = fileElementStride(var->fileDataType);
+        long memorySize = dataTypeSize(var->dataType);
+        for (long r = 0; r < nRows; r++)
+            convertElements(var, in + r * fileStride, inStride, nColumns, out + r * outStride * memorySize);
+        return;
+    }
 
+    uint32_t word = 0;
+    uint64_t longWord = 0;
+    switch (var->dataType)
+    {
         case DataTypeByte:
-            mem = malloc(sizeof(unsigned char));
-            redundant = readLong(bytes, nBytes, offset);
-            if (mem == NULL)
-                return READSAVE_MEM;            
-            var->data = mem;
-            *(unsigned char*)(var->data) = bytes[*offset];
-            *offset+=4; // Next 32-bit boundary
+            for (long r = 0; r < nRows; r++)
+                for (long c = 0; c < nColumns; c++)
+                    out[r * outStride + c] = in[r + c * inStride];
             break;
 
         case DataTypeInt16:
         case DataTypeUInt16:
-            mem = malloc(sizeof(int16_t));
-            if (mem == NULL)
-                return READSAVE_MEM;
-            var->data = mem;
-            *(int16_t*)(var->data) = readLong(bytes, nBytes, offset);
+            for (long r = 0; r < nRows; r++)
+                for (long c = 0; c < nColumns; c++)
+                {
+                    memcpy(&word, in + 4 * (r + c * inStride), 4);
+                    ((uint16_t*)out)[r * outStride + c] = (uint16_t)__builtin_bswap32(word);
+                }
             break;
 
         case DataTypeInt32:
         case DataTypeUInt32:
         case DataTypeFloat:
-            mem = malloc(sizeof(float));
-            if (mem == NULL)
-                return READSAVE_MEM;
-            var->data = mem;
-            *(float*)(var->data) = readFloat(bytes, nBytes, offset);
+            for (long r = 0; r < nRows; r++)
+                for (long c = 0; c < nColumns; c++)
+                {
+                    memcpy(&word, in + 4 * (r + c * inStride), 4);
+                    ((uint32_t*)out)[r * outStride + c] = __builtin_bswap32(word);
+                }
             break;
 
         case DataTypeInt64:
         case DataTypeUInt64:
         case DataTypeDouble:
-            mem = malloc(sizeof(double));
-            if (mem == NULL)
-                return READSAVE_MEM;
-            var->data = mem;
-            *(double*)(var->data) = readDouble(bytes, nBytes, offset);
+            for (long r = 0; r < nRows; r++)
+                for (long c = 0; c < nColumns; c++)
+                {
+                    memcpy(&longWord, in + 8 * (r + c * inStride), 8);
+                    ((uint64_t*)out)[r * outStride + c] = __builtin_bswap64(longWord);
+                }
             break;
 
         case DataTypeComplexFloat:
-            mem = malloc(2 * sizeof(float));
-            if (mem == NULL)
-                return READSAVE_MEM;
-            var->data = mem;
-            ((float*)var->data)[0] = readFloat(bytes, nBytes, offset);
-            ((float*)var->data)[1] = readFloat(bytes, nBytes, offset);
+            // Real and imaginary parts are swapped separately
+            for (long r = 0; r < nRows; r++)
+                for (long c = 0; c < nColumns; c++)
+                    for (int part = 0; part < 2; part++)
+                    {
+                        memcpy(&word, in + 8 * (r + c * inStride) + 4 * part, 4);
+                        ((uint32_t*)out)[2 * (r * outStride + c) + part] = __builtin_bswap32(word);
+                    }
             break;
 
         case DataTypeComplexDouble:
-            mem = malloc(2 * sizeof(double));
-            if (mem == NULL)
-                return READSAVE_MEM;
-            var->data = mem;
-            ((double*)var->data)[0] = readDouble(bytes, nBytes, offset);
-            ((double*)var->data)[1] = readDouble(bytes, nBytes, offset);
+            for (long r = 0; r < nRows; r++)
+                for (long c = 0; c < nColumns; c++)
+                    for (int part = 0; part < 2; part++)
+                    {
+                        memcpy(&longWord, in + 16 * (r + c * inStride) + 8 * part, 8);
+                        ((uint64_t*)out)[2 * (r * outStride + c) + part] = __builtin_bswap64(longWord);
+                    }
             break;
 
         default:
             break;
     }
 
-    return 0;
+    return;
+}
+
+// A unit of work is one tile row of the fastest file dimension at one index
+// of the middle dimensions, across the whole slowest dimension
+typedef struct TransposeTask
+{
+    unsigned char *in;
+    Variable *var;
+    long fileSize;
+    long first;
+    long count;
+
+} TransposeTask;
+
+static void *transposeThread(void *arg)
+{
+    TransposeTask *task = (TransposeTask*)arg;
+    Variable *var = task->var;
+    long nDims = var->arrayInfo.nDims;
+    long *dims = var->arrayInfo.dims;
+    long nFirst = dims[0];
+    long nLast = dims[nDims - 1];
+    long nBlocks = (nFirst + READSAVE_TRANSPOSE_TILE - 1) / READSAVE_TRANSPOSE_TILE;
+    long memorySize = dataTypeSize(var->dataType);
+    // File stride of the slowest dimension, output stride of the fastest
+    long inStride = var->arrayInfo.nElements / nLast;
+    long outStride = var->arrayInfo.nElements / nFirst;
+
+    long middle = 0;
+    long inBase = 0;
+    long outBase = 0;
+    long inFactor = 0;
+    long outFactor = 0;
+    long index = 0;
+    long row = 0;
+    long nRows = 0;
+    for (long u = task->first; u < task->first + task->count; u++)
+    {
+        middle = u / nBlocks;
+        row = (u % nBlocks) * READSAVE_TRANSPOSE_TILE;
+        nRows = nFirst - row < READSAVE_TRANSPOSE_TILE ? nFirst - row : READSAVE_TRANSPOSE_TILE;
+        inBase = row;
+        outBase = row * outStride;
+        inFactor = nFirst;
+        outFactor = outStride;
+        for (long d = 1; d < nDims - 1; d++)
+        {
+            index = middle % dims[d];
+            middle /= dims[d];
+            outFactor /= dims[d];
+            inBase += index * inFactor;
+            outBase += index * outFactor;
+            inFactor *= dims[d];
+        }
+        for (long column = 0; column < nLast; column += READSAVE_TRANSPOSE_TILE)
+            decodeTile(var, task->in + task->fileSize * (inBase + column * inStride), inStride, (unsigned char*)var->data + memorySize * (outBase + column), outStride, nRows, nLast - column < READSAVE_TRANSPOSE_TILE ? nLast - column : READSAVE_TRANSPOSE_TILE);
+    }
+
+    return NULL;
 }
 
-int initArray(unsigned char *bytes, long nBytes, long *offset, Variable *var)
+// Fuses the byte swap with a tiled transpose from IDL order to C order.
+// Large arrays are split across threads.
+static int readArrayRowMajor(unsigned char *bytes, long nBytes, long *offset, Variable *var)
 {
-    if (offset == NULL || bytes == NULL || *offset >= nBytes || var == NULL)
-        return READSAVE_ARGUMENTS;
-
-    long arrayStart = readLong(bytes, nBytes, offset);
-    if (arrayStart != 8)
-        return READSAVE_READ_ARRAY;
+    long nDims = var->arrayInfo.nDims;
+    long nElements = var->arrayInfo.nElements;
+    long fileSize = fileElementStride(fileDataType(var));
+    long product = 1;
+    for (long d = 0; d < nDims; d++)
+        product *= var->arrayInfo.dims[d];
+    long memorySize = dataTypeSize(var->dataType);
+    if (nDims < 2 || product != nElements || nElements == 0 || memorySize == 0)
+    {
+        // Nothing to transpose
+        var->rowMajor = false;
+        return readArray(bytes, nBytes, offset, var);
+    }
 
-    var->isArray = true;
+    unsigned char *in = bytes + *offset + (fileDataType(var) == DataTypeByte ? 4 : 0);
+    long nBlocks = (var->arrayInfo.dims[0] + READSAVE_TRANSPOSE_TILE - 1) / READSAVE_TRANSPOSE_TILE;
+    long nUnits = nBlocks * (nElements / var->arrayInfo.dims[0] / var->arrayInfo.dims[nDims - 1]);
 
-    int status = 0;
+    long nThreads = decodingThreads(nElements, READSAVE_TRANSPOSE_ELEMENTS_PER_THREAD);
+    if (nThreads > nUnits)
+        nThreads = nUnits;
 
-    var->arrayInfo.nBytesPerElement = readLong(bytes, nBytes, offset);
-    if (var->isStructure)
-        var->arrayInfo.nBytesPerElement = sizeof(Variable);
+    TransposeTask *tasks = calloc(nThreads, sizeof(TransposeTask));
+    pthread_t *threads = calloc(nThreads, sizeof(pthread_t));
+    bool *started = calloc(nThreads, sizeof(bool));
+    if (tasks == NULL || threads == NULL || started == NULL)
+    {
+        free(tasks);
+        free(threads);
+        free(started);
+        return READSAVE_MEM;
+    }
 
-    var->arrayInfo.nBytes = readLong(bytes, nBytes, offset);
-    var->arrayInfo.nElements = readLong(bytes, nBytes, offset);;
-    var->arrayInfo.nDims = readLong(bytes, nBytes, offset);
-    var->arrayInfo.unknown1 = readLong(bytes, nBytes, offset);
-    var->arrayInfo.unknown2 = readLong(bytes, nBytes, offset);
-    var->arrayInfo.nMax = readLong(bytes, nBytes, offset);
+    long perThread = (nUnits + nThreads - 1) / nThreads;
+    for (long t = 0; t < nThreads; t++)
+    {
+        tasks[t].in = in;
+        tasks[t].var = var;
+        tasks[t].fileSize = fileSize;
+        tasks[t].first = t * perThread;
+        tasks[t].count = nUnits - tasks[t].first < perThread ? nUnits - tasks[t].first : perThread;
+        // The calling thread takes the last share
+        if (t < nThreads - 1 && tasks[t].count > 0)
+            started[t] = pthread_create(&threads[t], NULL, transposeThread, &tasks[t]) == 0;
+    }
+    for (long t = 0; t < nThreads; t++)
+        if (!started[t] && tasks[t].count > 0)
+            transposeThread(&tasks[t]);
+    for (long t = 0; t < nThreads; t++)
+        if (started[t])
+            pthread_join(threads[t], NULL);
 
-    for (int i = 0; i < var->arrayInfo.nMax; i++)
-        var->arrayInfo.dims[i] = readLong(bytes, nBytes, offset);
+    free(tasks);
+    free(threads);
+    free(started);
 
-    void *mem = NULL;
-    mem = calloc(var->arrayInfo.nElements, var->arrayInfo.nBytesPerElement);
-    if (mem == NULL)
-        return READSAVE_MEM;
-    var->data = mem;
+    *offset += arrayFileSize(var);
 
     return READSAVE_OK;
 }
@@ -502,14 +1546,33 @@ int readArray(unsigned char *bytes, long nBytes, long *offset, Variable *var)
     if (offset == NULL || bytes == NULL || *offset >= nBytes || var == NULL)
         return READSAVE_ARGUMENTS;
 
+    if (var->dataType == DataTypeString)
+        return readStringArray(bytes, nBytes, offset, var);
+
+    // The extent is checked once; the loops below read without checks
+    if (var->data == NULL || *offset + arrayFileSize(var) > nBytes)
+        return READSAVE_READ_ARRAY;
+
+    if (var->rowMajor)
+        return readArrayRowMajor(bytes, nBytes, offset, var);
+
+    if (var->fileDataType != DataTypeUndefined)
+    {
+        // Byte data is preceded by its length
+        convertElements(var, bytes + *offset + (var->fileDataType == DataTypeByte ? 4 : 0), 1, var->arrayInfo.nElements, var->data);
+        *offset += arrayFileSize(var);
+        return READSAVE_OK;
+    }
+
     unsigned char b[16] = {0};
     long redundant = 0;
     switch(var->dataType)
     {
+
         case DataTypeByte:
             redundant = readLong(bytes, nBytes, offset);
-            memcpy((unsigned char*)var->data, bytes + *offset, var->arrayInfo.nElements * var->arrayInfo.nBytesPerElement);
-            *offset += var->arrayInfo.nElements * var->arrayInfo.nBytesPerElement;
+            memcpy((unsigned char*)var->data, bytes + *offset, var->arrayInfo.nElements);
+            *offset += var->arrayInfo.nElements;
             while (*offset % 4 != 0)
                 *offset += 1; // Next 32-bit boundary
 
@@ -580,22 +1643,22 @@ int readArray(unsigned char *bytes, long nBytes, long *offset, Variable *var)
         case DataTypeComplexDouble:
             for (int i = 0; i < var->arrayInfo.nElements; i++)
             {
-                b[0] = bytes[*offset + 8*i + 15];
-                b[1] = bytes[*offset + 8*i + 14];
-                b[2] = bytes[*offset + 8*i + 13];
-                b[3] = bytes[*offset + 8*i + 12];
-                b[4] = bytes[*offset + 8*i + 11];
-                b[5] = bytes[*offset + 8*i + 10];
-                b[6] = bytes[*offset + 8*i + 9];
-                b[7] = bytes[*offset + 8*i + 8];
-                b[8] = bytes[*offset + 8*i + 7];
-                b[9] = bytes[*offset + 8*i + 6];
-                b[10] = bytes[*offset + 8*i + 5];
-                b[11] = bytes[*offset + 8*i + 4];
-                b[12] = bytes[*offset + 8*i + 3];
-                b[13] = bytes[*offset + 8*i + 2];
-                b[14] = bytes[*offset + 8*i + 1];
-                b[15] = bytes[*offset + 8*i];
+                b[0] = bytes[*offset + 16*i + 15];
+                b[1] = bytes[*offset + 16*i + 14];
+                b[2] = bytes[*offset + 16*i + 13];
+                b[3] = bytes[*offset + 16*i + 12];
+                b[4] = bytes[*offset + 16*i + 11];
+                b[5] = bytes[*offset + 16*i + 10];
+                b[6] = bytes[*offset + 16*i + 9];
+                b[7] = bytes[*offset + 16*i + 8];
+                b[8] = bytes[*offset + 16*i + 7];
+                b[9] = bytes[*offset + 16*i + 6];
+                b[10] = bytes[*offset + 16*i + 5];
+                b[11] = bytes[*offset + 16*i + 4];
+                b[12] = bytes[*offset + 16*i + 3];
+                b[13] = bytes[*offset + 16*i + 2];
+                b[14] = bytes[*offset + 16*i + 1];
+                b[15] = bytes[*offset + 16*i];
                 ((double*)var->data)[2*i] = *(double*)(b+8);
                 ((double*)var->data)[2*i+1] = *(double*)(b);
             }
@@ -622,6 +1685,7 @@ int initStructure(unsigned char *bytes, long nBytes, long *offset, Variable *var
         return READSAVE_READ_STRUCTURE;
 
     variable->isStructure = true;
+    variable->pooledStrings = activeStringPool() != NULL;
 
     StructureInfo *info = &variable->structInfo;
 
@@ -630,8 +1694,10 @@ int initStructure(unsigned char *bytes, long nBytes, long *offset, Variable *var
         return status;
     if (info->structureName == NULL || strlen(info->structureName) == 0)
     {
+        if (!variable->pooledStrings)
+            freeString(info->structureName);
         char *name = "<anomymous structure>";
-        info->structureName = strdup(name);
+        info->structureName = newString(name, strlen(name));
     }
 
     info->predef = readLong(bytes, nBytes, offset);
@@ -659,6 +1725,7 @@ int initStructure(unsigned char *bytes, long nBytes, long *offset, Variable *var
     for (int i = 0; i < info->nTags; i++)
     {
         var = &((Variable*)variable->data)[i];
+        var->pooledStrings = variable->pooledStrings;
         status = readString(bytes, nBytes, offset, &var->name);
         if (status != 0)
             return status;
@@ -736,7 +1803,12 @@ int readStructure(unsigned char *bytes, long nBytes, long *offset, Variable *var
     for (int i = 0; i < var->structInfo.nTags; i++)
     {
         tag = &((Variable *)var->data)[i];
-        if (tag->isStructure)
+        if (tag->skipped)
+        {
+            if (skipTag(bytes, nBytes, offset, tag) > nBytes)
+                return READSAVE_READ_STRUCTURE;
+        }
+        else if (tag->isStructure)
         {
             status = readStructure(bytes, nBytes, offset, tag);
             if (status != 0)
@@ -760,7 +1832,94 @@ int readStructure(unsigned char *bytes, long nBytes, long *offset, Variable *var
 
 }
 
-int summarizeStructure(Variable *variable, int indent)
+long skipScalar(unsigned char *bytes, long nBytes, long *offset, long dataType)
+{
+    long strLength = 0;
+    switch (dataType)
+    {
+        case DataTypeByte:
+            *offset += 8;
+            break;
+        case DataTypeString:
+            strLength = readLong(bytes, nBytes, offset);
+            if (strLength > 0)
+            {
+                strLength = readLong(bytes, nBytes, offset);
+                *offset += 4 * ((strLength + 3) / 4);
+            }
+            break;
+        case DataTypeInt16:
+        case DataTypeUInt16:
+        case DataTypeInt32:
+        case DataTypeUInt32:
+        case DataTypeFloat:
+        case DataTypeHeapPointer:
+        case DataTypeObjectReference:
+            *offset += 4;
+            break;
+        case DataTypeInt64:
+        case DataTypeUInt64:
+        case DataTypeDouble:
+        case DataTypeComplexFloat:
+            *offset += 8;
+            break;
+        case DataTypeComplexDouble:
+            *offset += 16;
+            break;
+        default:
+            break;
+    }
+
+    return *offset;
+}
+
+long skipArray(unsigned char *bytes, long nBytes, long *offset, Variable *var)
+{
+    long nElements = var->arrayInfo.nElements;
+    long dataType = fileDataType(var);
+    switch (dataType)
+    {
+        case DataTypeByte:
+            *offset += 4 + 4 * ((nElements + 3) / 4);
+            break;
+        case DataTypeString:
+            for (long i = 0; i < nElements; i++)
+                skipScalar(bytes, nBytes, offset, DataTypeString);
+            break;
+        default:
+            // 16-bit values are padded to 32 bits
+            *offset += nElements * (dataTypeSize(dataType) < 4 ? 4 : dataTypeSize(dataType));
+            break;
+    }
+
+    return *offset;
+}
+
+static long skipTag(unsigned char *bytes, long nBytes, long *offset, Variable *tag)
+{
+    if (tag->isStructure)
+    {
+        long nElements = (tag->flags & VariableFlagsArray) != 0 ? tag->arrayInfo.nElements : 1;
+        for (long e = 0; e < nElements; e++)
+            skipStructure(bytes, nBytes, offset, tag);
+    }
+    else if (tag->isArray)
+        skipArray(bytes, nBytes, offset, tag);
+    else
+        skipScalar(bytes, nBytes, offset, tag->dataType);
+
+    return *offset;
+}
+
+long skipStructure(unsigned char *bytes, long nBytes, long *offset, Variable *var)
+{
+    for (int i = 0; i < var->structInfo.nTags; i++)
+        skipTag(bytes, nBytes, offset, &((Variable *)var->data)[i]);
+
+    return *offset;
+}
+
+int fsummarizeStructure(FILE *out, Variable *variable, int indent)
 {
     if (variable == NULL || !variable->isStructure)
         return READSAVE_ARGUMENTS;
@@ -772,69 +1931,74 @@ int summarizeStructure(Variable *variable, int indent)
     {
         tag = &(((Variable *)variable->data)[i]);
         for (int d = 0; d < indent; d++)
-            fprintf(stdout, " ");
-        fprintf(stdout, ".%s", tag->name);
+            fprintf(out, " ");
+        fprintf(out, ".%s", tag->name);
         if (tag->isStructure)
         {
-            fprintf(stdout, "\n");
-            summarizeStructure(tag, indent + 2);
+            fprintf(out, "\n");
+            fsummarizeStructure(out, tag, indent + 2);
         }
         else if (tag->isArray)
         {
             dataTypeName(tag->dataType, typeName);
-            fprintf(stdout, " %s array(", typeName);
+            fprintf(out, " %s array(", typeName);
             for (int d = 0; d < tag->arrayInfo.nDims; d++)
             {
-                fprintf(stdout, "%ld", tag->arrayInfo.dims[d]);
+                fprintf(out, "%ld", tag->arrayInfo.dims[d]);
                 if (d < tag->arrayInfo.nDims - 1)
-                    fprintf(stdout, ",");
+                    fprintf(out, ",");
             }
-            fprintf(stdout, ")\n");
+            fprintf(out, ")\n");
+        }
+        else if (tag->skipped)
+        {
+            dataTypeName(tag->dataType, typeName);
+            fprintf(out, " %s (not read)\n", typeName);
         }
         else
         {
             dataTypeName(tag->dataType, typeName);
-            fprintf(stdout, " %s", typeName);
+            fprintf(out, " %s", typeName);
             switch(tag->dataType)
             {
                 case DataTypeString:
-                    fprintf(stdout, " \"%s\"\n", (char*)(tag->data));
+                    fprintf(out, " \"%s\"\n", (char*)(tag->data));
                     break;
                 case DataTypeByte:
-                    fprintf(stdout, " %d\n", *(unsigned char*)(tag->data));
+                    fprintf(out, " %d\n", *(unsigned char*)(tag->data));
                     break;
                 case DataTypeInt16:
-                    fprintf(stdout, " %d\n", *(int16_t*)(tag->data));
+                    fprintf(out, " %d\n", *(int16_t*)(tag->data));
                     break;
                 case DataTypeUInt16:
-                    fprintf(stdout, " %u\n", *(uint16_t*)(tag->data));
+                    fprintf(out, " %u\n", *(uint16_t*)(tag->data));
                     break;
                 case DataTypeInt32:
-                    fprintf(stdout, " %d\n", *(int32_t*)(tag->data));
+                    fprintf(out, " %d\n", *(int32_t*)(tag->data));
                     break;
                 case DataTypeUInt32:
-                    fprintf(stdout, " %u\n", *(uint32_t*)(tag->data));
+                    fprintf(out, " %u\n", *(uint32_t*)(tag->data));
                     break;
                 case DataTypeInt64:
-                    fprintf(stdout, " %ld\n", *(int64_t*)(tag->data));
+                    fprintf(out, " %ld\n", *(int64_t*)(tag->data));
                     break;
                 case DataTypeUInt64:
-                    fprintf(stdout, " %lu\n", *(uint64_t*)(tag->data));
+                    fprintf(out, " %lu\n", *(uint64_t*)(tag->data));
                     break;
                 case DataTypeFloat:
-                    fprintf(stdout, " %f\n", *(float*)(tag->data));
+                    fprintf(out, " %f\n", *(float*)(tag->data));
                     break;
                 case DataTypeDouble:
-                    fprintf(stdout, " %lf\n", *(double*)(tag->data));
+                    fprintf(out, " %lf\n", *(double*)(tag->data));
                     break;
                 case DataTypeComplexFloat:
-                    fprintf(stdout, "\n");
+                    fprintf(out, "\n");
                     break;
                 case DataTypeComplexDouble:
-                    fprintf(stdout, "\n");
+                    fprintf(out, "\n");
                     break;
                 default:
-                    fprintf(stdout, "\n");
+                    fprintf(out, "\n");
             }
         }
     }
@@ -842,6 +2006,11 @@ int summarizeStructure(Variable *variable, int indent)
     return READSAVE_OK;
 }
 
+int summarizeStructure(Variable *variable, int indent)
+{
+    return fsummarizeStructure(stdout, variable, indent);
+}
+
 int copyStructure(Variable *dst, Variable *src)
 {
     if (dst == NULL || src == NULL)
@@ -849,14 +2018,20 @@ int copyStructure(Variable *dst, Variable *src)
 
     int status = READSAVE_OK;
 
+    dst->pooledStrings = activeStringPool() != NULL;
     if (src->name != NULL)
-        dst->name = strdup(src->name);
+        dst->name = newString(src->name, strlen(src->name));
 
     dst->dataType = src->dataType;
     dst->flags = src->flags;
     dst->isScalar = src->isScalar;
     dst->isArray = src->isArray;
     dst->isStructure = src->isStructure;
+    dst->skipped = src->skipped;
+    dst->rowMajor = src->rowMajor;
+    dst->fileDataType = src->fileDataType;
+    dst->scaleFactor = src->scaleFactor;
+    dst->addOffset = src->addOffset;
     memcpy(&dst->arrayInfo, &src->arrayInfo, sizeof(ArrayInfo));
     status = copyStructureInfo(&dst->structInfo, &src->structInfo);
     if (status != 0)
@@ -872,13 +2047,19 @@ int copyStructure(Variable *dst, Variable *src)
     {
         Variable *srctag = &(((Variable*)src->data)[i]);
         Variable *dsttag = &(((Variable*)dst->data)[i]);
+        dsttag->pooledStrings = dst->pooledStrings;
         if (srctag->name != NULL)
-            dsttag->name = strdup(srctag->name);
+            dsttag->name = newString(srctag->name, strlen(srctag->name));
         dsttag->dataType = srctag->dataType;
         dsttag->flags = srctag->flags;
         dsttag->isScalar = srctag->isScalar;
         dsttag->isArray = srctag->isArray;
         dsttag->isStructure = srctag->isStructure;
+        dsttag->skipped = srctag->skipped;
+        dsttag->rowMajor = srctag->rowMajor;
+        dsttag->fileDataType = srctag->fileDataType;
+        dsttag->scaleFactor = srctag->scaleFactor;
+        dsttag->addOffset = srctag->addOffset;
         if (srctag->isStructure)
         {
             status = copyStructure(dsttag, srctag);
@@ -888,6 +2069,8 @@ int copyStructure(Variable *dst, Variable *src)
         else if (srctag->isArray)
         {
             memcpy(&dsttag->arrayInfo, &srctag->arrayInfo, sizeof(ArrayInfo));
+            if (srctag->skipped)
+                continue;
             mem = calloc(srctag->arrayInfo.nElements, srctag->arrayInfo.nBytesPerElement);
             if (mem == NULL)
                 return READSAVE_MEM;
@@ -906,7 +2089,7 @@ int copyStructureInfo(StructureInfo *dst, StructureInfo *src)
 
     if (src->structureName != NULL)
     {
-        dst->structureName = strdup(src->structureName);
+        dst->structureName = newString(src->structureName, strlen(src->structureName));
         if (dst->structureName == NULL)
             return READSAVE_MEM;
     }
@@ -919,7 +2102,7 @@ int copyStructureInfo(StructureInfo *dst, StructureInfo *src)
 
     if (src->className != NULL)
     {
-        dst->className = strdup(src->className);
+        dst->className = newString(src->className, strlen(src->className));
         if (dst->className == NULL)
             return READSAVE_MEM;
     }
@@ -932,7 +2115,7 @@ int copyStructureInfo(StructureInfo *dst, StructureInfo *src)
 
         for (int i = 0; i < src->nSupClasses; i++)
         {
-            dst->supClassNames[i] = strdup(src->supClassNames[i]);
+            dst->supClassNames[i] = newString(src->supClassNames[i], strlen(src->supClassNames[i]));
             if (dst->supClassNames[i] == NULL)
                 return READSAVE_MEM;
         }
@@ -966,7 +2149,7 @@ int summarizeVariables(VariableList *variables)
 
 }
 
-int summarizeVariable(Variable *var)
+int fsummarizeVariable(FILE *out, Variable *var)
 {
     if (var == NULL)
         return READSAVE_ARGUMENTS;
@@ -980,7 +2163,7 @@ int summarizeVariable(Variable *var)
     {
         for (int i = 0; i < var->arrayInfo.nElements; i++)
         {
-            status = summarizeVariable(&((Variable*)var->data)[i]);
+            status = fsummarizeVariable(out, &((Variable*)var->data)[i]);
             if (status != 0)
                 return status;
         }
@@ -990,37 +2173,49 @@ int summarizeVariable(Variable *var)
     if (var->isScalar)
     {
         dataTypeName(var->dataType, typeName);
-        fprintf(stdout, "%s (%s scalar)\n", var->name, typeName);
+        fprintf(out, "%s (%s scalar)\n", var->name, typeName);
     }
     else if (var->isStructure)
     {
-        fprintf(stdout, "%s (structure)\n", var->name);
-        summarizeStructure(var, 2);
+        fprintf(out, "%s (structure)\n", var->name);
+        fsummarizeStructure(out, var, 2);
     }
     else if (var->isArray)
     {
         dataTypeName(var->dataType, typeName);
-        fprintf(stdout, "%s (%s array(", var->name, typeName);
+        fprintf(out, "%s (%s array(", var->name, typeName);
         for (int d = 0; d < var->arrayInfo.nDims; d++)
         {
-            fprintf(stdout, "%ld", var->arrayInfo.dims[d]);
+            fprintf(out, "%ld", var->arrayInfo.dims[d]);
             if (d < var->arrayInfo.nDims - 1)
-                fprintf(stdout, ",");
+                fprintf(out, ",");
         }
-        fprintf(stdout, "))\n");
+        fprintf(out, "))\n");
     }
     else
-        fprintf(stdout, " (no information)\n");
+        fprintf(out, " (no information)\n");
 
     return READSAVE_OK;
 }
 
+int summarizeVariable(Variable *var)
+{
+    return fsummarizeVariable(stdout, var);
+}
+
 Variable * variableData(Variable *variable, char *dottedTagName)
 {
     if (variable == NULL || dottedTagName == NULL)
         return NULL;
 
-    if (!variable->isStructure || variable->structInfo.nTags == 0 || variable->data == NULL)
+    if (!variable->isStructure)
+    {
+        if (variable->name != NULL && strcasecmp(variable->name, dottedTagName) == 0)
+            return variable;
+        return NULL;
+    }
+
+    if (variable->structInfo.nTags == 0 || variable->data == NULL)
         return NULL;
 
     Variable *var = variable;
@@ -1077,6 +2272,31 @@ Variable * variableData(Variable *variable, char *dottedTagName)
 
 }
 
+long dataTypeSize(long dataType)
+{
+    switch (dataType)
+    {
+        case DataTypeByte:
+            return sizeof(uint8_t);
+        case DataTypeInt16:
+        case DataTypeUInt16:
+            return sizeof(int16_t);
+        case DataTypeInt32:
+        case DataTypeUInt32:
+        case DataTypeFloat:
+            return sizeof(int32_t);
+        case DataTypeInt64:
+        case DataTypeUInt64:
+        case DataTypeDouble:
+        case DataTypeComplexFloat:
+            return sizeof(int64_t);
+        case DataTypeComplexDouble:
+            return 2 * sizeof(double);
+        default:
+            return 0;
+    }
+}
+
 void dataTypeName(long dataType, char *name)
 {
     if (name == NULL)
@@ -1135,3 +2355,286 @@ void dataTypeName(long dataType, char *name)
     
     return;
 }
+
+int tagPath(char *dottedTagName, char **buffer, char **fields, int maxFields)
+{
+    if (dottedTagName == NULL || buffer == NULL || fields == NULL)
+        return 0;
+
+    *buffer = strdup(dottedTagName);
+    if (*buffer == NULL)
+        return 0;
+
+    for (int i = 0; (*buffer)[i] != '\0'; i++)
+        (*buffer)[i] = toupper((*buffer)[i]);
+
+    char *cursor = *buffer;
+    char *field = NULL;
+    int nFields = 0;
+    while (nFields < maxFields && (field = strsep(&cursor, ".")) != NULL)
+        if (*field != '\0')
+            fields[nFields++] = field;
+
+    return nFields;
+}
+
+// Names from one pool are equal only if their pointers are
+static Variable *pooledVariableData(Variable *variable, char **fields, int nFields)
+{
+    if (variable->name != fields[0])
+        return NULL;
+
+    Variable *var = variable;
+    Variable *tag = NULL;
+    for (int depth = 1; depth < nFields; depth++)
+    {
+        if (!var->isStructure || var->data == NULL)
+            return NULL;
+        tag = NULL;
+        for (int t = 0; t < var->structInfo.nTags; t++)
+            if (((Variable*)var->data)[t].name == fields[depth])
+            {
+                tag = &((Variable*)var->data)[t];
+                break;
+            }
+        if (tag == NULL)
+            return NULL;
+        var = tag;
+    }
+
+    return var;
+}
+
+static Variable *findPooledVariable(VariableList *variables, char *dottedTagName)
+{
+    char *buffer = NULL;
+    char *fields[READSAVE_MAX_TAG_DEPTH] = {0};
+    int nFields = tagPath(dottedTagName, &buffer, fields, READSAVE_MAX_TAG_DEPTH);
+    Variable *selectedVar = NULL;
+    for (int f = 0; f < nFields; f++)
+    {
+        fields[f] = findPooledString(variables->stringPool, fields[f]);
+        // A name that is not in the pool is in no variable
+        if (fields[f] == NULL)
+            nFields = 0;
+    }
+
+    Variable *var = NULL;
+    for (size_t i = 0; nFields > 0 && i < variables->nVariables && selectedVar == NULL; i++)
+    {
+        var = &variables->variableList[i];
+        if (var->isArray && var->isStructure)
+        {
+            if (var->arrayInfo.nElements > 0)
+                selectedVar = pooledVariableData(&((Variable*)var->data)[0], fields, nFields);
+        }
+        else
+            selectedVar = pooledVariableData(var, fields, nFields);
+    }
+    free(buffer);
+
+    return selectedVar;
+}
+
+Variable * findVariable(VariableList *variables, char *dottedTagName)
+{
+    if (variables == NULL || dottedTagName == NULL)
+        return NULL;
+
+    if (variables->stringPool != NULL)
+        return findPooledVariable(variables, dottedTagName);
+
+    Variable *var = NULL;
+    Variable *selectedVar = NULL;
+    for (int i = 0; i < variables->nVariables; i++)
+    {
+        var = &variables->variableList[i];
+        // Tags of an array of structures are looked up in the first element
+        if (var->isArray && var->isStructure)
+        {
+            if (var->arrayInfo.nElements > 0)
+                selectedVar = variableData(&((Variable*)var->data)[0], dottedTagName);
+        }
+        else
+            selectedVar = variableData(var, dottedTagName);
+        if (selectedVar != NULL)
+            return selectedVar;
+    }
+
+    return NULL;
+}
+
+int fprintVariableData(FILE *out, Variable *var, long start, long count)
+{
+    if (var == NULL || var->data == NULL || start < 0)
+        return READSAVE_ARGUMENTS;
+
+    void *data = var->data;
+    long nElements = var->isArray ? var->arrayInfo.nElements : 1;
+    if (count < 0 || start + count > nElements)
+        count = nElements - start;
+
+    for (long i = start; i < start + count; i++)
+    {
+        switch(var->dataType)
+        {
+            case DataTypeByte:
+                fprintf(out, "%d\n", ((uint8_t*)data)[i]);
+                break;
+            case DataTypeInt16:
+                fprintf(out, "%d\n", ((int16_t*)data)[i]);
+                break;
+            case DataTypeUInt16:
+                fprintf(out, "%u\n", ((uint16_t*)data)[i]);
+                break;
+            case DataTypeInt32:
+                fprintf(out, "%d\n", ((int32_t*)data)[i]);
+                break;
+            case DataTypeUInt32:
+                fprintf(out, "%u\n", ((uint32_t*)data)[i]);
+                break;
+            case DataTypeInt64:
+                fprintf(out, "%ld\n", ((int64_t*)data)[i]);
+                break;
+            case DataTypeUInt64:
+                fprintf(out, "%lu\n", ((uint64_t*)data)[i]);
+                break;
+            case DataTypeFloat:
+                fprintf(out, "%f\n", ((float*)data)[i]);
+                break;
+            case DataTypeDouble:
+                fprintf(out, "%lf\n", ((double*)data)[i]);
+                break;
+            case DataTypeString:
+                if (var->isArray)
+                    fprintf(out, "%s\n", stringArrayElement(var, i));
+                else
+                    fprintf(out, "%s\n", (char*)data);
+                break;
+            default:
+                break;
+        }
+    }
+
+    return READSAVE_OK;
+}
+
+int printVariableData(Variable *var, long start, long count)
+{
+    return fprintVariableData(stdout, var, start, count);
+}
+
+size_t variableMemorySize(Variable *var)
+{
+    if (var == NULL)
+        return 0;
+
+    size_t size = sizeof(Variable);
+    if (var->name != NULL)
+        size += strlen(var->name) + 1;
+
+    if (var->isStructure)
+    {
+        long n = var->isArray ? var->arrayInfo.nElements : var->structInfo.nTags;
+        for (long i = 0; var->data != NULL && i < n; i++)
+            size += variableMemorySize(&((Variable*)var->data)[i]);
+        if (var->elementIndices != NULL)
+            size += var->arrayInfo.nElements * sizeof(long);
+    }
+    else if (var->isArray && var->dataType == DataTypeString && var->data != NULL)
+        size += (var->arrayInfo.nElements + 1) * sizeof(long) + ((long*)var->data)[var->arrayInfo.nElements];
+    else if (var->isArray && var->data != NULL)
+        size += var->arrayInfo.nElements * var->arrayInfo.nBytesPerElement;
+    else if (var->dataType == DataTypeString && var->data != NULL)
+        size += strlen((char*)var->data) + 1;
+
+    return size;
+}
+
+static void releaseStructureInfo(StructureInfo *info, bool pooledStrings)
+{
+    if (!pooledStrings)
+    {
+        freeString(info->structureName);
+        freeString(info->className);
+        if (info->supClassNames != NULL)
+            for (int i = 0; i < info->nSupClasses; i++)
+                freeString(info->supClassNames[i]);
+    }
+    free(info->supClassNames);
+    // Shallow copies of the class definitions; their contents are not owned here
+    free(info->supClasses);
+    bzero(info, sizeof(StructureInfo));
+
+    return;
+}
+
+void freeStructureInfo(StructureInfo *info)
+{
+    if (info == NULL)
+        return;
+
+    releaseStructureInfo(info, false);
+
+    return;
+}
+
+void freeVariable(Variable *var)
+{
+    if (var == NULL)
+        return;
+
+    if (!var->pooledStrings)
+        freeString(var->name);
+
+    if (var->isStructure && var->data != NULL)
+    {
+        // Array of structures, or the tags of a single structure
+        long n = var->isArray ? var->arrayInfo.nElements : var->structInfo.nTags;
+        for (long i = 0; i < n; i++)
+            freeVariable(&((Variable*)var->data)[i]);
+    }
+    // Only long scalar strings come from newString()
+    if (!var->hasInlineData && !var->isArray && !var->isStructure && var->dataType == DataTypeString)
+    {
+        if (!var->pooledStrings)
+            freeString(var->data);
+    }
+    else if (!var->hasInlineData)
+        free(var->data);
+    free(var->elementIndices);
+    releaseStructureInfo(&var->structInfo, var->pooledStrings);
+    bzero(var, sizeof(Variable));
+
+    return;
+}
+
+void freeVariableList(VariableList *variables)
+{
+    if (variables == NULL)
+        return;
+
+    // Pooled strings are released with the pool
+    for (size_t i = 0; i < variables->nVariables; i++)
+        freeVariable(&variables->variableList[i]);
+    freeStringPool(variables->stringPool);
+    variables->stringPool = NULL;
+    free(variables->variableList);
+    variables->variableList = NULL;
+    variables->nVariables = 0;
+
+    return;
+}
+
+void freeSaveInfo(SaveInfo *info)
+{
+    if (info == NULL)
+        return;
+
+    free(info->date);
+    free(info->operator);
+    info->date = NULL;
+    info->operator = NULL;
+
+    return;
+}
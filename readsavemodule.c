@@ -0,0 +1,640 @@
+/*
+
+    ReadSave: readsavemodule.c
+
+    Copyright (C) 2022  Johnathan K Burchill
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Python module readsave. Arrays are returned as NumPy arrays (or
+// memoryviews without NumPy) that share the decoded buffers of an open
+// SaveFile, or the big-endian bytes of its memory map, through the buffer
+// protocol. Each array keeps its SaveFile alive.
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include "readsave.h"
+#include "saveview.h"
+#include "savestrings.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+typedef struct SaveFileObject
+{
+    PyObject_HEAD
+    VariableList variables;
+    SaveInfo info;
+    SaveView view;
+    bool hasView;
+
+} SaveFileObject;
+
+// Exports one array through the buffer protocol. Data is either borrowed
+// from owner or, for gathered structure columns, owned.
+typedef struct SaveBufferObject
+{
+    PyObject_HEAD
+    PyObject *owner;
+    void *data;
+    bool ownsData;
+    bool readOnly;
+    char format[4];
+    Py_ssize_t itemSize;
+    int nDims;
+    Py_ssize_t shape[9];
+    Py_ssize_t strides[9];
+
+} SaveBufferObject;
+
+static PyTypeObject SaveFileType;
+static PyTypeObject SaveBufferType;
+
+// PEP 3118 format of one decoded value, or NULL
+static const char *bufferFormat(long dataType)
+{
+    switch (dataType)
+    {
+        case DataTypeByte:
+            return "B";
+        case DataTypeInt16:
+            return "h";
+        case DataTypeUInt16:
+            return "H";
+        case DataTypeInt32:
+            return "i";
+        case DataTypeUInt32:
+            return "I";
+        case DataTypeInt64:
+            return "q";
+        case DataTypeUInt64:
+            return "Q";
+        case DataTypeFloat:
+            return "f";
+        case DataTypeDouble:
+            return "d";
+        case DataTypeComplexFloat:
+            return "Zf";
+        case DataTypeComplexDouble:
+            return "Zd";
+        default:
+            return NULL;
+    }
+}
+
+// IDL dimensions are column-major; Python sees them reversed in C order.
+// outer holds the slower dimensions of a structure array, if any.
+static void setShape(SaveBufferObject *buffer, ArrayInfo *outer, ArrayInfo *info, Py_ssize_t innerStride)
+{
+    int nDims = 0;
+    for (long d = outer == NULL ? -1 : outer->nDims - 1; d >= 0 && nDims < 8; d--)
+        buffer->shape[nDims++] = outer->dims[d];
+    for (long d = info == NULL ? -1 : info->nDims - 1; d >= 0 && nDims < 9; d--)
+        buffer->shape[nDims++] = info->dims[d];
+    buffer->nDims = nDims;
+
+    Py_ssize_t stride = innerStride;
+    for (int d = nDims - 1; d >= 0; d--)
+    {
+        buffer->strides[d] = stride;
+        stride *= buffer->shape[d];
+    }
+
+    return;
+}
+
+static SaveBufferObject *newBuffer(PyObject *owner, void *data, bool ownsData, long dataType, bool bigEndian)
+{
+    const char *format = bufferFormat(dataType);
+    if (format == NULL)
+    {
+        PyErr_SetString(PyExc_TypeError, "unsupported IDL data type");
+        return NULL;
+    }
+
+    SaveBufferObject *buffer = PyObject_New(SaveBufferObject, &SaveBufferType);
+    if (buffer == NULL)
+        return NULL;
+    buffer->owner = owner;
+    Py_XINCREF(owner);
+    buffer->data = data;
+    buffer->ownsData = ownsData;
+    buffer->readOnly = bigEndian;
+    snprintf(buffer->format, sizeof(buffer->format), "%s%s", bigEndian ? ">" : "", format);
+    buffer->itemSize = dataTypeSize(dataType);
+    buffer->nDims = 0;
+
+    return buffer;
+}
+
+static void saveBufferDealloc(SaveBufferObject *self)
+{
+    if (self->ownsData)
+        free(self->data);
+    Py_XDECREF(self->owner);
+    PyObject_Free(self);
+}
+
+static int saveBufferGetBuffer(SaveBufferObject *self, Py_buffer *view, int flags)
+{
+    if ((flags & PyBUF_WRITABLE) == PyBUF_WRITABLE && self->readOnly)
+    {
+        PyErr_SetString(PyExc_BufferError, "save file views are read-only");
+        return -1;
+    }
+
+    Py_ssize_t nElements = 1;
+    for (int d = 0; d < self->nDims; d++)
+        nElements *= self->shape[d];
+    bool contiguous = true;
+    Py_ssize_t stride = self->itemSize;
+    for (int d = self->nDims - 1; d >= 0; d--)
+    {
+        contiguous = contiguous && (self->shape[d] <= 1 || self->strides[d] == stride);
+        stride *= self->shape[d];
+    }
+    if (!contiguous && (flags & PyBUF_STRIDES) != PyBUF_STRIDES)
+    {
+        PyErr_SetString(PyExc_BufferError, "array is strided");
+        return -1;
+    }
+
+    view->buf = self->data;
+    view->obj = (PyObject*)self;
+    Py_INCREF(self);
+    view->len = nElements * self->itemSize;
+    view->readonly = self->readOnly;
+    view->itemsize = self->itemSize;
+    view->format = (flags & PyBUF_FORMAT) == PyBUF_FORMAT ? self->format : NULL;
+    view->ndim = self->nDims;
+    view->shape = (flags & PyBUF_ND) == PyBUF_ND ? self->shape : NULL;
+    view->strides = (flags & PyBUF_STRIDES) == PyBUF_STRIDES ? self->strides : NULL;
+    view->suboffsets = NULL;
+    view->internal = NULL;
+
+    return 0;
+}
+
+static PyBufferProcs saveBufferProcs = {
+    .bf_getbuffer = (getbufferproc)saveBufferGetBuffer,
+};
+
+static PyTypeObject SaveBufferType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "readsave.SaveBuffer",
+    .tp_basicsize = sizeof(SaveBufferObject),
+    .tp_dealloc = (destructor)saveBufferDealloc,
+    .tp_as_buffer = &saveBufferProcs,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = "Array data shared through the buffer protocol",
+};
+
+// numpy.asarray() wraps the buffer without copying
+static PyObject *arrayObject(SaveBufferObject *buffer)
+{
+    if (buffer == NULL)
+        return NULL;
+
+    PyObject *array = NULL;
+    PyObject *numpy = PyImport_ImportModule("numpy");
+    if (numpy != NULL)
+    {
+        array = PyObject_CallMethod(numpy, "asarray", "O", (PyObject*)buffer);
+        Py_DECREF(numpy);
+    }
+    else
+    {
+        PyErr_Clear();
+        array = PyMemoryView_FromObject((PyObject*)buffer);
+    }
+    Py_DECREF(buffer);
+
+    return array;
+}
+
+static PyObject *stringObject(char *str)
+{
+    if (str == NULL)
+        Py_RETURN_NONE;
+
+    return PyUnicode_DecodeLatin1(str, strlen(str), "replace");
+}
+
+static PyObject *scalarObject(Variable *var)
+{
+    if (var->data == NULL)
+        Py_RETURN_NONE;
+
+    switch (var->dataType)
+    {
+        case DataTypeString:
+            return stringObject((char*)var->data);
+        case DataTypeByte:
+            return PyLong_FromLong(*(uint8_t*)var->data);
+        case DataTypeInt16:
+            return PyLong_FromLong(*(int16_t*)var->data);
+        case DataTypeUInt16:
+            return PyLong_FromLong(*(uint16_t*)var->data);
+        case DataTypeInt32:
+            return PyLong_FromLong(*(int32_t*)var->data);
+        case DataTypeUInt32:
+            return PyLong_FromUnsignedLong(*(uint32_t*)var->data);
+        case DataTypeInt64:
+            return PyLong_FromLongLong(*(int64_t*)var->data);
+        case DataTypeUInt64:
+            return PyLong_FromUnsignedLongLong(*(uint64_t*)var->data);
+        case DataTypeFloat:
+            return PyFloat_FromDouble(*(float*)var->data);
+        case DataTypeDouble:
+            return PyFloat_FromDouble(*(double*)var->data);
+        case DataTypeComplexFloat:
+            return PyComplex_FromDoubles(((float*)var->data)[0], ((float*)var->data)[1]);
+        case DataTypeComplexDouble:
+            return PyComplex_FromDoubles(((double*)var->data)[0], ((double*)var->data)[1]);
+        default:
+            Py_RETURN_NONE;
+    }
+}
+
+static PyObject *variableObject(SaveFileObject *file, Variable *var);
+
+static Variable *tagAt(Variable *element, int *path, int depth)
+{
+    Variable *tag = element;
+    for (int d = 0; d < depth; d++)
+        tag = &((Variable*)tag->data)[path[d]];
+
+    return tag;
+}
+
+// One tag gathered from every element of a structure array: a NumPy array
+// with the element as its slowest dimension, a list of strings, or a dict
+// of columns for a nested structure
+static PyObject *columnObject(SaveFileObject *file, Variable *elements, ArrayInfo *elementInfo, int *path, int depth)
+{
+    long nElements = elementInfo->nElements;
+    Variable *first = tagAt(&elements[0], path, depth);
+
+    if (first->isStructure)
+    {
+        if (depth >= READSAVE_MAX_TAG_DEPTH - 1)
+            Py_RETURN_NONE;
+        PyObject *columns = PyDict_New();
+        PyObject *column = NULL;
+        for (int t = 0; columns != NULL && t < first->structInfo.nTags; t++)
+        {
+            path[depth] = t;
+            column = columnObject(file, elements, elementInfo, path, depth + 1);
+            if (column == NULL || PyDict_SetItemString(columns, ((Variable*)first->data)[t].name, column) != 0)
+                Py_CLEAR(columns);
+            Py_XDECREF(column);
+        }
+        return columns;
+    }
+
+    if (first->data == NULL)
+        Py_RETURN_NONE;
+
+    long nTagElements = first->isArray ? first->arrayInfo.nElements : 1;
+    if (first->dataType == DataTypeString)
+    {
+        PyObject *strings = PyList_New(nElements * nTagElements);
+        Variable *tag = NULL;
+        for (long e = 0; strings != NULL && e < nElements; e++)
+        {
+            tag = tagAt(&elements[e], path, depth);
+            for (long i = 0; i < nTagElements; i++)
+                PyList_SET_ITEM(strings, e * nTagElements + i, stringObject(first->isArray ? stringArrayElement(tag, i) : (char*)tag->data));
+        }
+        return strings;
+    }
+
+    long elementSize = dataTypeSize(first->dataType);
+    if (bufferFormat(first->dataType) == NULL)
+        Py_RETURN_NONE;
+    unsigned char *data = malloc(nElements * nTagElements * elementSize);
+    if (data == NULL)
+        return PyErr_NoMemory();
+    Variable *tag = NULL;
+    for (long e = 0; e < nElements; e++)
+    {
+        tag = tagAt(&elements[e], path, depth);
+        memcpy(data + e * nTagElements * elementSize, tag->data, nTagElements * elementSize);
+    }
+
+    SaveBufferObject *buffer = newBuffer(NULL, data, true, first->dataType, false);
+    if (buffer == NULL)
+    {
+        free(data);
+        return NULL;
+    }
+    setShape(buffer, elementInfo, first->isArray ? &first->arrayInfo : NULL, elementSize);
+
+    return arrayObject(buffer);
+}
+
+static PyObject *variableObject(SaveFileObject *file, Variable *var)
+{
+    if (var == NULL)
+        Py_RETURN_NONE;
+
+    int path[READSAVE_MAX_TAG_DEPTH] = {0};
+    if (var->isStructure && var->isArray)
+    {
+        if (var->data == NULL || var->arrayInfo.nElements < 1)
+            return PyDict_New();
+        return columnObject(file, (Variable*)var->data, &var->arrayInfo, path, 0);
+    }
+
+    if (var->isStructure)
+    {
+        PyObject *tags = PyDict_New();
+        PyObject *tag = NULL;
+        for (int t = 0; tags != NULL && t < var->structInfo.nTags; t++)
+        {
+            tag = variableObject(file, &((Variable*)var->data)[t]);
+            if (tag == NULL || PyDict_SetItemString(tags, ((Variable*)var->data)[t].name, tag) != 0)
+                Py_CLEAR(tags);
+            Py_XDECREF(tag);
+        }
+        return tags;
+    }
+
+    if (!var->isArray)
+        return scalarObject(var);
+
+    if (var->data == NULL)
+        Py_RETURN_NONE;
+
+    if (var->dataType == DataTypeString)
+    {
+        PyObject *strings = PyList_New(var->arrayInfo.nElements);
+        for (long i = 0; strings != NULL && i < var->arrayInfo.nElements; i++)
+            PyList_SET_ITEM(strings, i, stringObject(stringArrayElement(var, i)));
+        return strings;
+    }
+
+    SaveBufferObject *buffer = newBuffer((PyObject*)file, var->data, false, var->dataType, false);
+    if (buffer == NULL)
+        return NULL;
+    setShape(buffer, NULL, &var->arrayInfo, dataTypeSize(var->dataType));
+
+    return arrayObject(buffer);
+}
+
+// Structure array tags are returned as columns; other names as for findVariable()
+static PyObject *saveFileGetItem(SaveFileObject *self, PyObject *key)
+{
+    const char *name = PyUnicode_AsUTF8(key);
+    if (name == NULL)
+        return NULL;
+
+    char *buffer = NULL;
+    char *fields[READSAVE_MAX_TAG_DEPTH] = {0};
+    int nFields = tagPath((char*)name, &buffer, fields, READSAVE_MAX_TAG_DEPTH);
+    Variable *var = NULL;
+    for (size_t i = 0; nFields > 0 && i < self->variables.nVariables && var == NULL; i++)
+        if (strcasecmp(self->variables.variableList[i].name, fields[0]) == 0)
+            var = &self->variables.variableList[i];
+
+    PyObject *result = NULL;
+    int path[READSAVE_MAX_TAG_DEPTH] = {0};
+    Variable *tag = NULL;
+    if (var != NULL && var->isStructure && var->isArray && nFields > 1 && var->arrayInfo.nElements > 0)
+    {
+        tag = &((Variable*)var->data)[0];
+        for (int f = 1; tag != NULL && f < nFields; f++)
+        {
+            Variable *structure = tag;
+            tag = NULL;
+            for (int t = 0; structure->isStructure && t < structure->structInfo.nTags; t++)
+                if (strcasecmp(((Variable*)structure->data)[t].name, fields[f]) == 0)
+                {
+                    path[f - 1] = t;
+                    tag = &((Variable*)structure->data)[t];
+                    break;
+                }
+        }
+        if (tag != NULL)
+            result = columnObject(self, (Variable*)var->data, &var->arrayInfo, path, nFields - 1);
+    }
+    else if (var != NULL)
+    {
+        tag = nFields > 1 ? findVariable(&self->variables, (char*)name) : var;
+        if (tag != NULL)
+            result = variableObject(self, tag);
+    }
+    free(buffer);
+
+    if (result == NULL && !PyErr_Occurred())
+        PyErr_Format(PyExc_KeyError, "%s", name);
+
+    return result;
+}
+
+static PyObject *saveFileKeys(SaveFileObject *self, PyObject *Py_UNUSED(unused))
+{
+    PyObject *names = PyList_New(self->variables.nVariables);
+    for (size_t i = 0; names != NULL && i < self->variables.nVariables; i++)
+        PyList_SET_ITEM(names, i, stringObject(self->variables.variableList[i].name));
+
+    return names;
+}
+
+// Zero-copy, read-only view of the big-endian values in the memory-mapped file
+static PyObject *saveFileView(SaveFileObject *self, PyObject *args, PyObject *kwargs)
+{
+    static char *keywords[] = {"name", "element", NULL};
+    char *name = NULL;
+    long element = 0;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "s|l", keywords, &name, &element))
+        return NULL;
+
+    if (!self->hasView)
+    {
+        PyErr_SetString(PyExc_ValueError, "file was not opened with a memory map");
+        return NULL;
+    }
+
+    ArrayView arrayView = {0};
+    int status = findArrayView(&self->view, name, element, &arrayView);
+    if (status != READSAVE_OK)
+    {
+        PyErr_Format(PyExc_KeyError, "%s (status %d)", name, status);
+        return NULL;
+    }
+
+    // 16-bit values sit in the low half of each 32-bit word
+    unsigned char *data = arrayView.bytes;
+    if (arrayView.dataType == DataTypeInt16 || arrayView.dataType == DataTypeUInt16)
+        data += 2;
+    SaveBufferObject *buffer = newBuffer((PyObject*)self, data, false, arrayView.dataType, true);
+    if (buffer == NULL)
+        return NULL;
+    ArrayInfo info = {0};
+    info.nDims = arrayView.nDims;
+    memcpy(info.dims, arrayView.dims, sizeof(info.dims));
+    setShape(buffer, NULL, arrayView.nDims > 0 ? &info : NULL, arrayView.stride);
+
+    return arrayObject(buffer);
+}
+
+static PyObject *saveFileDate(SaveFileObject *self, void *Py_UNUSED(closure))
+{
+    return stringObject(self->info.date);
+}
+
+static PyObject *saveFileUser(SaveFileObject *self, void *Py_UNUSED(closure))
+{
+    return stringObject(self->info.operator);
+}
+
+static void saveFileDealloc(SaveFileObject *self)
+{
+    freeVariableList(&self->variables);
+    freeSaveInfo(&self->info);
+    if (self->hasView)
+        closeSaveView(&self->view);
+    Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+static PyMethodDef saveFileMethods[] = {
+    {"keys", (PyCFunction)saveFileKeys, METH_NOARGS, "Names of the variables that were read"},
+    {"view", (PyCFunction)(void(*)(void))saveFileView, METH_VARARGS | METH_KEYWORDS, "view(name, element=0): read-only big-endian array in the memory-mapped file"},
+    {NULL, NULL, 0, NULL}
+};
+
+static PyGetSetDef saveFileGetSet[] = {
+    {"date", (getter)saveFileDate, NULL, "Date the file was saved", NULL},
+    {"user", (getter)saveFileUser, NULL, "User who saved the file", NULL},
+    {NULL}
+};
+
+static PyMappingMethods saveFileMapping = {
+    .mp_subscript = (binaryfunc)saveFileGetItem,
+};
+
+static PyTypeObject SaveFileType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "readsave.SaveFile",
+    .tp_basicsize = sizeof(SaveFileObject),
+    .tp_dealloc = (destructor)saveFileDealloc,
+    .tp_as_mapping = &saveFileMapping,
+    .tp_methods = saveFileMethods,
+    .tp_getset = saveFileGetSet,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = "A decoded IDL save file. Arrays share its memory.",
+};
+
+// open(filename, variables=None): reads the file, or only the listed
+// variables and tags, and memory maps it for view()
+static PyObject *readsaveOpen(PyObject *Py_UNUSED(module), PyObject *args, PyObject *kwargs)
+{
+    static char *keywords[] = {"filename", "variables", NULL};
+    char *filename = NULL;
+    PyObject *names = Py_None;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "s|O", keywords, &filename, &names))
+        return NULL;
+
+    ReadSaveOptions options = {0};
+    PyObject *sequence = NULL;
+    if (names != Py_None)
+    {
+        sequence = PySequence_Fast(names, "variables must be a sequence of names");
+        if (sequence == NULL)
+            return NULL;
+        options.nTagPaths = PySequence_Fast_GET_SIZE(sequence);
+        options.tagPaths = calloc(options.nTagPaths > 0 ? options.nTagPaths : 1, sizeof(char*));
+        if (options.tagPaths == NULL)
+        {
+            Py_DECREF(sequence);
+            return PyErr_NoMemory();
+        }
+        for (int i = 0; i < options.nTagPaths; i++)
+        {
+            options.tagPaths[i] = (char*)PyUnicode_AsUTF8(PySequence_Fast_GET_ITEM(sequence, i));
+            if (options.tagPaths[i] == NULL)
+            {
+                free(options.tagPaths);
+                Py_DECREF(sequence);
+                return NULL;
+            }
+        }
+    }
+
+    SaveFileObject *file = PyObject_New(SaveFileObject, &SaveFileType);
+    if (file == NULL)
+    {
+        free(options.tagPaths);
+        Py_XDECREF(sequence);
+        return NULL;
+    }
+    bzero(&file->variables, sizeof(VariableList));
+    bzero(&file->info, sizeof(SaveInfo));
+    bzero(&file->view, sizeof(SaveView));
+    file->hasView = false;
+
+    int status = READSAVE_OK;
+    Py_BEGIN_ALLOW_THREADS
+    status = readSaveWithOptions(filename, &options, &file->info, &file->variables);
+    if (status == READSAVE_OK)
+        file->hasView = openSaveView(filename, &file->view) == READSAVE_OK;
+    Py_END_ALLOW_THREADS
+    free(options.tagPaths);
+    Py_XDECREF(sequence);
+
+    if (status != READSAVE_OK)
+    {
+        Py_DECREF(file);
+        PyErr_Format(PyExc_OSError, "unable to read %s (status %d)", filename, status);
+        return NULL;
+    }
+
+    return (PyObject*)file;
+}
+
+static PyMethodDef readsaveMethods[] = {
+    {"open", (PyCFunction)(void(*)(void))readsaveOpen, METH_VARARGS | METH_KEYWORDS, "open(filename, variables=None) -> SaveFile"},
+    {NULL, NULL, 0, NULL}
+};
+
+static struct PyModuleDef readsaveModule = {
+    PyModuleDef_HEAD_INIT,
+    .m_name = "readsave",
+    .m_doc = "Reader for IDL save files",
+    .m_size = -1,
+    .m_methods = readsaveMethods,
+};
+
+PyMODINIT_FUNC PyInit_readsave(void)
+{
+    if (PyType_Ready(&SaveFileType) < 0 || PyType_Ready(&SaveBufferType) < 0)
+        return NULL;
+
+    PyObject *module = PyModule_Create(&readsaveModule);
+    if (module == NULL)
+        return NULL;
+
+    Py_INCREF(&SaveFileType);
+    if (PyModule_AddObject(module, "SaveFile", (PyObject*)&SaveFileType) < 0)
+    {
+        Py_DECREF(&SaveFileType);
+        Py_DECREF(module);
+        return NULL;
+    }
+
+    return module;
+}
@@ -0,0 +1,714 @@
+/*
+
+    ReadSave: savecache.c
+
+    Copyright (C) 2022  Johnathan K Burchill
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "savecache.h"
+#include "saveview.h"
+#include "readsave.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <stdbool.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#ifdef HAVE_LZ4
+#include <lz4.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+typedef struct CacheWriter
+{
+    FILE *file;
+    long offset;
+    CacheColumn *columns;
+    long nColumns;
+    long maxColumns;
+    int compression;
+    long chunkSize;
+    unsigned char *raw;
+    unsigned char *packed;
+    long bufferSize;
+    int status;
+
+} CacheWriter;
+
+typedef struct ChunkReader
+{
+    SaveCache *cache;
+    CacheColumn *column;
+    CacheChunk *chunks;
+    long elementSize;
+    long start;
+    long count;
+    unsigned char *buffer;
+    long nextChunk;
+    long lastChunk;
+    int status;
+    pthread_mutex_t mutex;
+
+} ChunkReader;
+
+static void writeBytes(CacheWriter *writer, const void *data, size_t n)
+{
+    if (writer->status != READSAVE_OK || n == 0)
+        return;
+
+    if (fwrite(data, 1, n, writer->file) != n)
+    {
+        writer->status = READSAVE_INPUT_FILE;
+        return;
+    }
+    writer->offset += n;
+
+    return;
+}
+
+static void alignOutput(CacheWriter *writer)
+{
+    static const unsigned char zeros[SAVE_CACHE_ALIGNMENT] = {0};
+    writeBytes(writer, zeros, (SAVE_CACHE_ALIGNMENT - writer->offset % SAVE_CACHE_ALIGNMENT) % SAVE_CACHE_ALIGNMENT);
+
+    return;
+}
+
+static Variable *tagAt(Variable *element, int *path, int depth)
+{
+    Variable *tag = element;
+    for (int d = 0; d < depth; d++)
+        tag = &((Variable*)tag->data)[path[d]];
+
+    return tag;
+}
+
+static CacheColumn *newColumn(CacheWriter *writer, char *name)
+{
+    if (writer->nColumns == writer->maxColumns)
+    {
+        long maxColumns = writer->maxColumns > 0 ? 2 * writer->maxColumns : 16;
+        void *mem = realloc(writer->columns, maxColumns * sizeof(CacheColumn));
+        if (mem == NULL)
+        {
+            writer->status = READSAVE_MEM;
+            return NULL;
+        }
+        writer->columns = mem;
+        writer->maxColumns = maxColumns;
+    }
+
+    alignOutput(writer);
+    CacheColumn *column = &writer->columns[writer->nColumns++];
+    bzero(column, sizeof(CacheColumn));
+    snprintf(column->name, SAVE_CACHE_NAME_LENGTH, "%s", name);
+    column->dataOffset = writer->offset;
+
+    return column;
+}
+
+// Copies column elements [start, start + count) into buffer
+static void gatherColumn(Variable *var, int *path, int depth, long nTagElements, long elementSize, long start, long count, unsigned char *buffer)
+{
+    Variable *elements = var->isStructure ? (Variable*)var->data : var;
+    Variable *tag = NULL;
+    long within = 0;
+    long n = 0;
+    while (count > 0)
+    {
+        tag = tagAt(&elements[start / nTagElements], path, depth);
+        within = start % nTagElements;
+        n = nTagElements - within;
+        if (n > count)
+            n = count;
+        memcpy(buffer, (unsigned char*)tag->data + within * elementSize, n * elementSize);
+        buffer += n * elementSize;
+        start += n;
+        count -= n;
+    }
+
+    return;
+}
+
+bool cacheCompressionAvailable(int compression)
+{
+    switch (compression)
+    {
+        case SaveCacheCompressionNone:
+            return true;
+#ifdef HAVE_LZ4
+        case SaveCacheCompressionLZ4:
+            return true;
+#endif
+#ifdef HAVE_ZSTD
+        case SaveCacheCompressionZstd:
+            return true;
+#endif
+        default:
+            return false;
+    }
+}
+
+// Returns the compressed size, or 0 if the chunk does not shrink
+static long compressChunk(int compression, unsigned char *src, long nBytes, unsigned char *dst, long capacity)
+{
+    // Unused when built without LZ4 and Zstd
+    (void)src;
+    (void)dst;
+    (void)capacity;
+
+    long n = 0;
+    switch (compression)
+    {
+#ifdef HAVE_LZ4
+        case SaveCacheCompressionLZ4:
+            n = LZ4_compress_default((char*)src, (char*)dst, (int)nBytes, (int)capacity);
+            break;
+#endif
+#ifdef HAVE_ZSTD
+        case SaveCacheCompressionZstd:
+            n = ZSTD_compress(dst, capacity, src, nBytes, SAVE_CACHE_ZSTD_LEVEL);
+            if (ZSTD_isError(n))
+                n = 0;
+            break;
+#endif
+        default:
+            break;
+    }
+
+    return n < nBytes ? n : 0;
+}
+
+static int decompressChunk(int compression, unsigned char *src, long nBytes, unsigned char *dst, long rawBytes)
+{
+    if (nBytes == rawBytes)
+    {
+        memcpy(dst, src, rawBytes);
+        return READSAVE_OK;
+    }
+
+    long n = -1;
+    switch (compression)
+    {
+#ifdef HAVE_LZ4
+        case SaveCacheCompressionLZ4:
+            n = LZ4_decompress_safe((char*)src, (char*)dst, (int)nBytes, (int)rawBytes);
+            break;
+#endif
+#ifdef HAVE_ZSTD
+        case SaveCacheCompressionZstd:
+            n = ZSTD_decompress(dst, rawBytes, src, nBytes);
+            if (ZSTD_isError(n))
+                n = -1;
+            break;
+#endif
+        default:
+            break;
+    }
+
+    return n == rawBytes ? READSAVE_OK : READSAVE_READ_ARRAY;
+}
+
+static void writeCompressedColumn(CacheWriter *writer, CacheColumn *column, Variable *var, int *path, int depth, long nTagElements, long elementSize)
+{
+    // Chunks are whole slabs along the slowest dimension
+    long slabElements = column->nElements / (column->dims[column->nDims - 1] > 0 ? column->dims[column->nDims - 1] : 1);
+    if (slabElements < 1)
+        slabElements = 1;
+    long slabsPerChunk = writer->chunkSize / (slabElements * elementSize);
+    if (slabsPerChunk < 1)
+        slabsPerChunk = 1;
+    column->compression = writer->compression;
+    column->chunkElements = slabsPerChunk * slabElements;
+    column->nChunks = (column->nElements + column->chunkElements - 1) / column->chunkElements;
+
+    long chunkBytes = column->chunkElements * elementSize;
+    if (chunkBytes > writer->bufferSize)
+    {
+        free(writer->raw);
+        free(writer->packed);
+        writer->raw = malloc(chunkBytes);
+        writer->packed = malloc(chunkBytes);
+        writer->bufferSize = chunkBytes;
+        if (writer->raw == NULL || writer->packed == NULL)
+        {
+            writer->bufferSize = 0;
+            writer->status = READSAVE_MEM;
+            return;
+        }
+    }
+    CacheChunk *chunks = calloc(column->nChunks, sizeof(CacheChunk));
+    if (chunks == NULL)
+    {
+        writer->status = READSAVE_MEM;
+        return;
+    }
+
+    long start = 0;
+    long count = 0;
+    long nPacked = 0;
+    for (long c = 0; c < column->nChunks && writer->status == READSAVE_OK; c++)
+    {
+        start = c * column->chunkElements;
+        count = column->nElements - start;
+        if (count > column->chunkElements)
+            count = column->chunkElements;
+        gatherColumn(var, path, depth, nTagElements, elementSize, start, count, writer->raw);
+        nPacked = compressChunk(writer->compression, writer->raw, count * elementSize, writer->packed, count * elementSize);
+        chunks[c].offset = writer->offset;
+        chunks[c].rawBytes = count * elementSize;
+        chunks[c].nBytes = nPacked > 0 ? nPacked : chunks[c].rawBytes;
+        writeBytes(writer, nPacked > 0 ? writer->packed : writer->raw, chunks[c].nBytes);
+    }
+
+    alignOutput(writer);
+    column->chunkTableOffset = writer->offset;
+    writeBytes(writer, chunks, column->nChunks * sizeof(CacheChunk));
+    free(chunks);
+
+    return;
+}
+
+// One column holding this tag from every structure element
+// (or the variable itself when var is not a structure)
+static void addColumn(CacheWriter *writer, char *name, Variable *var, int *path, int depth)
+{
+    Variable *elements = var->isStructure ? (Variable*)var->data : var;
+    long nStructElements = var->isStructure ? var->arrayInfo.nElements : 1;
+    Variable *first = tagAt(&elements[0], path, depth);
+
+    // Heap pointers are not decoded by readSave()
+    if (first->data == NULL)
+        return;
+    long elementSize = first->dataType == DataTypeString ? 1 : dataTypeSize(first->dataType);
+    if (elementSize == 0)
+        return;
+
+    CacheColumn *column = newColumn(writer, name);
+    if (column == NULL)
+        return;
+
+    long nTagElements = first->isArray ? first->arrayInfo.nElements : 1;
+    column->dataType = first->dataType;
+    column->nBytesPerElement = first->dataType == DataTypeString ? 0 : elementSize;
+    column->nElements = nTagElements * nStructElements;
+    if (first->isArray)
+        for (int d = 0; d < first->arrayInfo.nDims && column->nDims < SAVE_CACHE_MAX_DIMS; d++)
+            column->dims[column->nDims++] = first->arrayInfo.dims[d];
+    if (var->isStructure)
+        for (int d = 0; d < var->arrayInfo.nDims && column->nDims < SAVE_CACHE_MAX_DIMS; d++)
+            column->dims[column->nDims++] = var->arrayInfo.dims[d];
+    if (column->nDims == 0)
+    {
+        column->nDims = 1;
+        column->dims[0] = column->nElements;
+    }
+
+    Variable *tag = NULL;
+    char *str = NULL;
+    if (first->dataType == DataTypeString)
+    {
+        long textOffset = 0;
+        for (long e = 0; e < nStructElements; e++)
+        {
+            tag = tagAt(&elements[e], path, depth);
+            for (long j = 0; j < nTagElements; j++)
+            {
+                writeBytes(writer, &textOffset, sizeof(long));
+                str = tag->isArray ? stringArrayElement(tag, j) : (char*)tag->data;
+                textOffset += (str != NULL ? strlen(str) : 0) + 1;
+            }
+        }
+        writeBytes(writer, &textOffset, sizeof(long));
+        for (long e = 0; e < nStructElements; e++)
+        {
+            tag = tagAt(&elements[e], path, depth);
+            for (long j = 0; j < nTagElements; j++)
+            {
+                str = tag->isArray ? stringArrayElement(tag, j) : (char*)tag->data;
+                writeBytes(writer, str != NULL ? str : "", (str != NULL ? strlen(str) : 0) + 1);
+            }
+        }
+    }
+    else if (writer->compression != SaveCacheCompressionNone)
+        writeCompressedColumn(writer, column, var, path, depth, nTagElements, elementSize);
+    else
+        for (long e = 0; e < nStructElements; e++)
+        {
+            tag = tagAt(&elements[e], path, depth);
+            writeBytes(writer, tag->data, nTagElements * elementSize);
+        }
+
+    column->nBytes = writer->offset - column->dataOffset;
+
+    return;
+}
+
+static void addStructureColumns(CacheWriter *writer, char *prefix, Variable *var, int *path, int depth)
+{
+    if (depth >= READSAVE_MAX_TAG_DEPTH)
+        return;
+
+    Variable *def = tagAt(&((Variable*)var->data)[0], path, depth);
+    Variable *tag = NULL;
+    char name[SAVE_CACHE_NAME_LENGTH] = {0};
+    for (int i = 0; i < def->structInfo.nTags && writer->status == READSAVE_OK; i++)
+    {
+        tag = &((Variable*)def->data)[i];
+        snprintf(name, SAVE_CACHE_NAME_LENGTH, "%s.%s", prefix, tag->name);
+        path[depth] = i;
+        if (tag->isStructure)
+            addStructureColumns(writer, name, var, path, depth + 1);
+        else
+            addColumn(writer, name, var, path, depth + 1);
+    }
+
+    return;
+}
+
+static bool hasRowMajorTags(Variable *def)
+{
+    Variable *tag = NULL;
+    for (int i = 0; i < def->structInfo.nTags; i++)
+    {
+        tag = &((Variable*)def->data)[i];
+        if (tag->isStructure ? hasRowMajorTags(tag) : tag->rowMajor)
+            return true;
+    }
+
+    return false;
+}
+
+int writeSaveCache(char *filename, VariableList *variables, long *nColumns)
+{
+    return writeCompressedSaveCache(filename, variables, SaveCacheCompressionNone, 0, nColumns);
+}
+
+int writeCompressedSaveCache(char *filename, VariableList *variables, int compression, long chunkSize, long *nColumns)
+{
+    if (filename == NULL || variables == NULL || !cacheCompressionAvailable(compression))
+        return READSAVE_ARGUMENTS;
+
+    // Columns are stored in IDL order
+    Variable *var = NULL;
+    for (size_t i = 0; i < variables->nVariables; i++)
+    {
+        var = &variables->variableList[i];
+        if (var->isStructure ? var->data != NULL && var->arrayInfo.nElements > 0 && hasRowMajorTags(&((Variable*)var->data)[0]) : var->rowMajor)
+            return READSAVE_ARGUMENTS;
+    }
+
+    CacheWriter writer = {0};
+    writer.compression = compression;
+    writer.chunkSize = chunkSize > 0 ? chunkSize : SAVE_CACHE_CHUNK_SIZE;
+    writer.file = fopen(filename, "w");
+    if (writer.file == NULL)
+        return READSAVE_INPUT_FILE;
+
+    CacheHeader header = {0};
+    memcpy(header.magic, SAVE_CACHE_MAGIC, sizeof(header.magic));
+    header.byteOrder = SAVE_CACHE_BYTE_ORDER;
+    writeBytes(&writer, &header, sizeof(CacheHeader));
+
+    int path[READSAVE_MAX_TAG_DEPTH] = {0};
+    for (size_t i = 0; i < variables->nVariables && writer.status == READSAVE_OK; i++)
+    {
+        var = &variables->variableList[i];
+        if (var->isStructure)
+        {
+            if (var->data != NULL && var->arrayInfo.nElements > 0)
+                addStructureColumns(&writer, var->name, var, path, 0);
+        }
+        else
+            addColumn(&writer, var->name, var, path, 0);
+    }
+
+    alignOutput(&writer);
+    CacheTrailer trailer = {0};
+    trailer.nColumns = writer.nColumns;
+    trailer.indexOffset = writer.offset;
+    memcpy(trailer.magic, SAVE_CACHE_INDEX_MAGIC, sizeof(trailer.magic));
+    writeBytes(&writer, writer.columns, writer.nColumns * sizeof(CacheColumn));
+    writeBytes(&writer, &trailer, sizeof(CacheTrailer));
+
+    if (fclose(writer.file) != 0 && writer.status == READSAVE_OK)
+        writer.status = READSAVE_INPUT_FILE;
+    free(writer.columns);
+    free(writer.raw);
+    free(writer.packed);
+
+    if (nColumns != NULL)
+        *nColumns = writer.nColumns;
+
+    return writer.status;
+}
+
+int openSaveCache(char *filename, SaveCache *cache)
+{
+    if (filename == NULL || cache == NULL)
+        return READSAVE_ARGUMENTS;
+
+    bzero(cache, sizeof(SaveCache));
+
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+        return READSAVE_INPUT_FILE;
+
+    struct stat fileInfo = {0};
+    if (fstat(fd, &fileInfo) != 0 || fileInfo.st_size < (long)(sizeof(CacheHeader) + sizeof(CacheTrailer)))
+    {
+        close(fd);
+        return READSAVE_INPUT_FILE;
+    }
+
+    unsigned char *bytes = mmap(NULL, fileInfo.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (bytes == MAP_FAILED)
+    {
+        close(fd);
+        return READSAVE_INPUT_FILE;
+    }
+
+    CacheHeader *header = (CacheHeader*)bytes;
+    CacheTrailer *trailer = (CacheTrailer*)(bytes + fileInfo.st_size - sizeof(CacheTrailer));
+    long indexEnd = fileInfo.st_size - sizeof(CacheTrailer);
+    int status = READSAVE_OK;
+    if (memcmp(header->magic, SAVE_CACHE_MAGIC, sizeof(header->magic)) != 0 || memcmp(trailer->magic, SAVE_CACHE_INDEX_MAGIC, sizeof(trailer->magic)) != 0)
+        status = READSAVE_INPUT_FILE;
+    // Caches are native-endian and not portable between architectures
+    else if (header->byteOrder != SAVE_CACHE_BYTE_ORDER)
+        status = READSAVE_FILE_VERSION;
+    else if (trailer->nColumns < 0 || trailer->indexOffset < (long)sizeof(CacheHeader) || trailer->indexOffset % SAVE_CACHE_ALIGNMENT != 0 || trailer->nColumns > (indexEnd - trailer->indexOffset) / (long)sizeof(CacheColumn))
+        status = READSAVE_INPUT_FILE;
+
+    CacheColumn *columns = (CacheColumn*)(bytes + (status == READSAVE_OK ? trailer->indexOffset : 0));
+    CacheColumn *column = NULL;
+    CacheChunk *chunks = NULL;
+    long columnEnd = 0;
+    for (long c = 0; status == READSAVE_OK && c < trailer->nColumns; c++)
+    {
+        column = &columns[c];
+        columnEnd = column->dataOffset + column->nBytes;
+        if (column->dataOffset < (long)sizeof(CacheHeader) || column->nBytes < 0 || columnEnd > trailer->indexOffset || column->nDims < 1 || column->nDims > SAVE_CACHE_MAX_DIMS)
+            status = READSAVE_INPUT_FILE;
+        else if (column->nElements < 0)
+            status = READSAVE_INPUT_FILE;
+        // Strings are stored uncompressed: an offset table of nElements + 1
+        // entries, then the text, each string ending in a NUL
+        else if (column->dataType == DataTypeString)
+        {
+            if (column->compression != SaveCacheCompressionNone || column->nElements >= column->nBytes / (long)sizeof(long) || (column->nElements > 0 && bytes[columnEnd - 1] != '\0'))
+                status = READSAVE_INPUT_FILE;
+        }
+        else if (column->nBytesPerElement != dataTypeSize(column->dataType) || column->nBytesPerElement == 0)
+            status = READSAVE_INPUT_FILE;
+        else if (column->compression == SaveCacheCompressionNone)
+        {
+            if (column->nElements > column->nBytes / column->nBytesPerElement)
+                status = READSAVE_INPUT_FILE;
+        }
+        else
+        {
+            if (column->chunkElements < 1 || column->nChunks != (column->nElements + column->chunkElements - 1) / column->chunkElements || column->chunkTableOffset < column->dataOffset || column->nChunks > (columnEnd - column->chunkTableOffset) / (long)sizeof(CacheChunk))
+            {
+                status = READSAVE_INPUT_FILE;
+                break;
+            }
+            chunks = (CacheChunk*)(bytes + column->chunkTableOffset);
+            for (long k = 0; k < column->nChunks; k++)
+                if (chunks[k].offset < column->dataOffset || chunks[k].nBytes < 0 || chunks[k].offset + chunks[k].nBytes > column->chunkTableOffset || chunks[k].rawBytes != (k < column->nChunks - 1 ? column->chunkElements : column->nElements - k * column->chunkElements) * column->nBytesPerElement)
+                    status = READSAVE_INPUT_FILE;
+        }
+    }
+
+    if (status != READSAVE_OK)
+    {
+        munmap(bytes, fileInfo.st_size);
+        close(fd);
+        return status;
+    }
+
+    cache->fd = fd;
+    cache->bytes = bytes;
+    cache->nBytes = fileInfo.st_size;
+    cache->columns = columns;
+    cache->nColumns = trailer->nColumns;
+
+    return READSAVE_OK;
+}
+
+void closeSaveCache(SaveCache *cache)
+{
+    if (cache == NULL || cache->bytes == NULL)
+        return;
+
+    munmap(cache->bytes, cache->nBytes);
+    close(cache->fd);
+    bzero(cache, sizeof(SaveCache));
+
+    return;
+}
+
+CacheColumn *findCacheColumn(SaveCache *cache, char *name)
+{
+    if (cache == NULL || name == NULL)
+        return NULL;
+
+    for (long c = 0; c < cache->nColumns; c++)
+        if (strcasecmp(cache->columns[c].name, name) == 0)
+            return &cache->columns[c];
+
+    return NULL;
+}
+
+// Compressed columns have no flat data to point at: use readCacheColumn()
+void *cacheColumnData(SaveCache *cache, CacheColumn *column)
+{
+    if (cache == NULL || column == NULL || column->compression != SaveCacheCompressionNone)
+        return NULL;
+
+    return cache->bytes + column->dataOffset;
+}
+
+char *cacheString(SaveCache *cache, CacheColumn *column, long index)
+{
+    if (cache == NULL || column == NULL || column->dataType != DataTypeString || index < 0 || index >= column->nElements)
+        return NULL;
+
+    long *offsets = (long*)cacheColumnData(cache, column);
+    long textStart = (column->nElements + 1) * sizeof(long);
+    if (offsets[index] < 0 || textStart + offsets[index] >= column->nBytes)
+        return NULL;
+
+    return (char*)offsets + textStart + offsets[index];
+}
+
+static void *chunkThread(void *arg)
+{
+    ChunkReader *reader = (ChunkReader*)arg;
+    CacheColumn *column = reader->column;
+    unsigned char *scratch = NULL;
+
+    long c = 0;
+    long chunkStart = 0;
+    long chunkCount = 0;
+    long first = 0;
+    long last = 0;
+    int status = READSAVE_OK;
+    while (status == READSAVE_OK)
+    {
+        pthread_mutex_lock(&reader->mutex);
+        c = reader->nextChunk++;
+        status = reader->status;
+        pthread_mutex_unlock(&reader->mutex);
+        if (c >= reader->lastChunk || status != READSAVE_OK)
+            break;
+
+        CacheChunk *chunk = &reader->chunks[c];
+        chunkStart = c * column->chunkElements;
+        chunkCount = chunk->rawBytes / reader->elementSize;
+        first = reader->start > chunkStart ? reader->start : chunkStart;
+        last = reader->start + reader->count < chunkStart + chunkCount ? reader->start + reader->count : chunkStart + chunkCount;
+
+        // Whole chunks go straight into the caller's buffer
+        if (first == chunkStart && last == chunkStart + chunkCount)
+            status = decompressChunk(column->compression, reader->cache->bytes + chunk->offset, chunk->nBytes, reader->buffer + (chunkStart - reader->start) * reader->elementSize, chunk->rawBytes);
+        else
+        {
+            if (scratch == NULL)
+                scratch = malloc(column->chunkElements * reader->elementSize);
+            if (scratch == NULL)
+                status = READSAVE_MEM;
+            else
+                status = decompressChunk(column->compression, reader->cache->bytes + chunk->offset, chunk->nBytes, scratch, chunk->rawBytes);
+            if (status == READSAVE_OK)
+                memcpy(reader->buffer + (first - reader->start) * reader->elementSize, scratch + (first - chunkStart) * reader->elementSize, (last - first) * reader->elementSize);
+        }
+    }
+
+    if (status != READSAVE_OK)
+    {
+        pthread_mutex_lock(&reader->mutex);
+        reader->status = status;
+        pthread_mutex_unlock(&reader->mutex);
+    }
+    free(scratch);
+
+    return NULL;
+}
+
+// Copies numeric elements [start, start + count) into buffer. For
+// compressed columns only the chunks overlapping the range are
+// decompressed, spread over nThreads threads.
+int readCacheColumn(SaveCache *cache, CacheColumn *column, long start, long count, void *buffer, int nThreads)
+{
+    if (cache == NULL || column == NULL || buffer == NULL || column->dataType == DataTypeString || start < 0 || count < 0 || start + count > column->nElements)
+        return READSAVE_ARGUMENTS;
+
+    long elementSize = column->nBytesPerElement;
+    if (count == 0)
+        return READSAVE_OK;
+
+    if (column->compression == SaveCacheCompressionNone)
+    {
+        memcpy(buffer, cache->bytes + column->dataOffset + start * elementSize, count * elementSize);
+        return READSAVE_OK;
+    }
+    if (!cacheCompressionAvailable(column->compression))
+        return READSAVE_FILE_VERSION;
+
+    ChunkReader reader = {0};
+    reader.cache = cache;
+    reader.column = column;
+    reader.chunks = (CacheChunk*)(cache->bytes + column->chunkTableOffset);
+    reader.elementSize = elementSize;
+    reader.start = start;
+    reader.count = count;
+    reader.buffer = buffer;
+    reader.nextChunk = start / column->chunkElements;
+    reader.lastChunk = (start + count - 1) / column->chunkElements + 1;
+    pthread_mutex_init(&reader.mutex, NULL);
+
+    if (nThreads > reader.lastChunk - reader.nextChunk)
+        nThreads = (int)(reader.lastChunk - reader.nextChunk);
+    pthread_t *threads = calloc(nThreads > 1 ? nThreads : 1, sizeof(pthread_t));
+    if (threads == NULL)
+    {
+        pthread_mutex_destroy(&reader.mutex);
+        return READSAVE_MEM;
+    }
+
+    // The calling thread decompresses chunks too
+    int nStarted = 0;
+    for (int t = 0; t < nThreads - 1; t++)
+        if (pthread_create(&threads[nStarted], NULL, chunkThread, &reader) == 0)
+            nStarted++;
+    chunkThread(&reader);
+    for (int t = 0; t < nStarted; t++)
+        pthread_join(threads[t], NULL);
+
+    free(threads);
+    pthread_mutex_destroy(&reader.mutex);
+
+    return reader.status;
+}
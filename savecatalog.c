@@ -0,0 +1,516 @@
+/*
+
+    ReadSave: savecatalog.c
+
+    Copyright (C) 2022  Johnathan K Burchill
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#define _GNU_SOURCE
+
+#include "savecatalog.h"
+#include "savefile.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <time.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+// An entry while the catalog is built, before names become offsets
+typedef struct PendingEntry
+{
+    char *name;
+    CatalogEntry entry;
+
+} PendingEntry;
+
+typedef struct PendingFile
+{
+    char *path;
+    CatalogFile file;
+    PendingEntry *entries;
+    long nEntries;
+
+} PendingFile;
+
+typedef struct CatalogScan
+{
+    PendingFile *files;
+    long nFiles;
+    long next;
+    pthread_mutex_t mutex;
+
+} CatalogScan;
+
+// Save times are written by IDL as from systime(), e.g. "Tue Jan  7 12:34:56 2013".
+// Query times may also be given as ISO 8601 dates. Times are compared as UTC.
+long parseSaveTime(char *text)
+{
+    if (text == NULL)
+        return SAVE_CATALOG_UNKNOWN_TIME;
+
+    const char *formats[] = {"%a %b %d %H:%M:%S %Y", "%a %b %d %Y", "%Y-%m-%dT%H:%M:%S", "%Y-%m-%d %H:%M:%S", "%Y-%m-%d"};
+    struct tm fields = {0};
+    char *end = NULL;
+    for (int f = 0; f < (int)(sizeof(formats) / sizeof(formats[0])); f++)
+    {
+        bzero(&fields, sizeof(fields));
+        end = strptime(text, formats[f], &fields);
+        if (end != NULL && *end == '\0')
+            return (long)timegm(&fields);
+    }
+
+    return SAVE_CATALOG_UNKNOWN_TIME;
+}
+
+static long elementCount(Variable *var)
+{
+    return (var->isArray || (var->flags & VariableFlagsArray) != 0) ? var->arrayInfo.nElements : 1;
+}
+
+static int addEntry(PendingFile *file, char *name, Variable *var, long nElements)
+{
+    void *mem = realloc(file->entries, (file->nEntries + 1) * sizeof(PendingEntry));
+    if (mem == NULL)
+        return READSAVE_MEM;
+    file->entries = mem;
+
+    PendingEntry *pending = &file->entries[file->nEntries];
+    bzero(pending, sizeof(PendingEntry));
+    pending->name = strdup(name);
+    if (pending->name == NULL)
+        return READSAVE_MEM;
+    for (char *c = pending->name; *c != '\0'; c++)
+        *c = toupper(*c);
+    file->nEntries++;
+
+    CatalogEntry *entry = &pending->entry;
+    entry->dataType = var->isStructure ? DataTypeStructure : var->dataType;
+    entry->flags = var->flags;
+    entry->nElements = nElements;
+    if (var->isArray || (var->flags & VariableFlagsArray) != 0)
+    {
+        entry->nDims = var->arrayInfo.nDims < SAVE_CATALOG_MAX_DIMS ? var->arrayInfo.nDims : SAVE_CATALOG_MAX_DIMS;
+        for (int d = 0; d < entry->nDims; d++)
+            entry->dims[d] = var->arrayInfo.dims[d];
+    }
+
+    return READSAVE_OK;
+}
+
+static int addTagEntries(PendingFile *file, char *path, Variable *structure)
+{
+    int status = READSAVE_OK;
+    size_t pathLength = strlen(path);
+    Variable *tag = NULL;
+    char *tagPath = NULL;
+    for (long i = 0; status == READSAVE_OK && i < structure->structInfo.nTags; i++)
+    {
+        tag = &((Variable*)structure->data)[i];
+        if (tag->name == NULL)
+            continue;
+        tagPath = malloc(pathLength + strlen(tag->name) + 2);
+        if (tagPath == NULL)
+            return READSAVE_MEM;
+        sprintf(tagPath, "%s.%s", path, tag->name);
+        status = addEntry(file, tagPath, tag, elementCount(tag));
+        if (status == READSAVE_OK && tag->isStructure)
+            status = addTagEntries(file, tagPath, tag);
+        free(tagPath);
+    }
+
+    return status;
+}
+
+// Reads the timestamp and variable definitions, never the variable data
+static void scanFile(PendingFile *pending)
+{
+    struct stat fileInfo = {0};
+    if (stat(pending->path, &fileInfo) == 0)
+    {
+        pending->file.fileSize = fileInfo.st_size;
+        pending->file.modificationTime = fileInfo.st_mtime;
+    }
+    pending->file.timestamp = SAVE_CATALOG_UNKNOWN_TIME;
+
+    ReadSaveFile file = {0};
+    int status = openReadSaveFile(pending->path, &file);
+    if (status == READSAVE_OK)
+    {
+        pending->file.timestamp = parseSaveTime(file.info.date);
+        SaveFileRecord *record = NULL;
+        for (long r = 0; status == READSAVE_OK && r < file.nRecords; r++)
+        {
+            record = &file.records[r];
+            if (record->name == NULL)
+                continue;
+            status = addEntry(pending, record->name, &record->definition, elementCount(&record->definition));
+            if (status == READSAVE_OK && record->definition.isStructure)
+                status = addTagEntries(pending, pending->entries[pending->nEntries - 1].name, &record->definition);
+        }
+        closeReadSaveFile(&file);
+    }
+    pending->file.status = status;
+
+    return;
+}
+
+static void *catalogScanThread(void *arg)
+{
+    CatalogScan *scan = (CatalogScan*)arg;
+    long f = 0;
+    while (true)
+    {
+        pthread_mutex_lock(&scan->mutex);
+        f = scan->next++;
+        pthread_mutex_unlock(&scan->mutex);
+        if (f >= scan->nFiles)
+            break;
+        scanFile(&scan->files[f]);
+    }
+
+    return NULL;
+}
+
+static int comparePendingFiles(const void *a, const void *b)
+{
+    return strcmp(((PendingFile*)a)->path, ((PendingFile*)b)->path);
+}
+
+static int comparePendingEntries(const void *a, const void *b)
+{
+    PendingEntry *first = (PendingEntry*)a;
+    PendingEntry *second = (PendingEntry*)b;
+    int order = strcmp(first->name, second->name);
+    if (order != 0)
+        return order;
+
+    return first->entry.file - second->entry.file;
+}
+
+static void freePendingFiles(PendingFile *files, long nFiles, bool freeArray)
+{
+    for (long f = 0; f < nFiles; f++)
+    {
+        for (long e = 0; e < files[f].nEntries; e++)
+            free(files[f].entries[e].name);
+        free(files[f].entries);
+    }
+    if (freeArray)
+        free(files);
+
+    return;
+}
+
+static int writeCatalog(char *filename, PendingFile *files, long nFiles, PendingEntry *entries, long nEntries)
+{
+    // Paths, then each distinct name once; names repeat across files
+    long nStringBytes = 0;
+    for (long f = 0; f < nFiles; f++)
+        nStringBytes += strlen(files[f].path) + 1;
+    for (long e = 0; e < nEntries; e++)
+        if (e == 0 || strcmp(entries[e].name, entries[e - 1].name) != 0)
+            nStringBytes += strlen(entries[e].name) + 1;
+
+    CatalogHeader header = {0};
+    memcpy(header.magic, SAVE_CATALOG_MAGIC, sizeof(header.magic));
+    header.byteOrder = SAVE_CATALOG_BYTE_ORDER;
+    header.nFiles = nFiles;
+    header.nEntries = nEntries;
+    header.filesOffset = sizeof(CatalogHeader);
+    header.entriesOffset = header.filesOffset + nFiles * sizeof(CatalogFile);
+    header.stringsOffset = header.entriesOffset + nEntries * sizeof(CatalogEntry);
+    header.nStringBytes = nStringBytes;
+
+    char *strings = malloc(nStringBytes > 0 ? nStringBytes : 1);
+    if (strings == NULL)
+        return READSAVE_MEM;
+    long position = 0;
+    for (long f = 0; f < nFiles; f++)
+    {
+        files[f].file.pathOffset = position;
+        strcpy(strings + position, files[f].path);
+        position += strlen(files[f].path) + 1;
+    }
+    for (long e = 0; e < nEntries; e++)
+    {
+        if (e > 0 && strcmp(entries[e].name, entries[e - 1].name) == 0)
+        {
+            entries[e].entry.nameOffset = entries[e - 1].entry.nameOffset;
+            continue;
+        }
+        entries[e].entry.nameOffset = position;
+        strcpy(strings + position, entries[e].name);
+        position += strlen(entries[e].name) + 1;
+    }
+
+    FILE *out = fopen(filename, "wb");
+    if (out == NULL)
+    {
+        free(strings);
+        return READSAVE_INPUT_FILE;
+    }
+    bool written = fwrite(&header, sizeof(header), 1, out) == 1;
+    for (long f = 0; written && f < nFiles; f++)
+        written = fwrite(&files[f].file, sizeof(CatalogFile), 1, out) == 1;
+    for (long e = 0; written && e < nEntries; e++)
+        written = fwrite(&entries[e].entry, sizeof(CatalogEntry), 1, out) == 1;
+    if (written && nStringBytes > 0)
+        written = fwrite(strings, nStringBytes, 1, out) == 1;
+    free(strings);
+    if (fclose(out) != 0 || !written)
+        return READSAVE_INPUT_FILE;
+
+    return READSAVE_OK;
+}
+
+// Scans the files with nThreads threads and writes a catalog of their variables.
+// Files that cannot be read are listed with their status and no entries.
+int buildSaveCatalog(char *filename, char **files, long nFiles, int nThreads, long *nEntries)
+{
+    if (filename == NULL || files == NULL || nFiles < 0 || nFiles > 0x7fffffffL)
+        return READSAVE_ARGUMENTS;
+
+    CatalogScan scan = {0};
+    scan.files = calloc(nFiles > 0 ? nFiles : 1, sizeof(PendingFile));
+    if (scan.files == NULL)
+        return READSAVE_MEM;
+    scan.nFiles = nFiles;
+    for (long f = 0; f < nFiles; f++)
+        scan.files[f].path = files[f];
+    pthread_mutex_init(&scan.mutex, NULL);
+
+    if (nThreads < 1)
+        nThreads = 1;
+    if (nThreads > nFiles)
+        nThreads = nFiles > 0 ? nFiles : 1;
+    pthread_t threads[nThreads];
+    bool started[nThreads];
+    // The calling thread scans too
+    for (int t = 0; t < nThreads - 1; t++)
+        started[t] = pthread_create(&threads[t], NULL, catalogScanThread, &scan) == 0;
+    catalogScanThread(&scan);
+    for (int t = 0; t < nThreads - 1; t++)
+        if (started[t])
+            pthread_join(threads[t], NULL);
+    pthread_mutex_destroy(&scan.mutex);
+
+    // A path given more than once is cataloged once
+    qsort(scan.files, nFiles, sizeof(PendingFile), comparePendingFiles);
+    long nUnique = 0;
+    for (long f = 0; f < nFiles; f++)
+    {
+        if (nUnique > 0 && strcmp(scan.files[f].path, scan.files[nUnique - 1].path) == 0)
+            freePendingFiles(&scan.files[f], 1, false);
+        else
+            scan.files[nUnique++] = scan.files[f];
+    }
+    nFiles = nUnique;
+
+    long total = 0;
+    for (long f = 0; f < nFiles; f++)
+    {
+        scan.files[f].file.nEntries = scan.files[f].nEntries;
+        total += scan.files[f].nEntries;
+    }
+
+    PendingEntry *entries = malloc((total > 0 ? total : 1) * sizeof(PendingEntry));
+    if (entries == NULL)
+    {
+        freePendingFiles(scan.files, nFiles, true);
+        return READSAVE_MEM;
+    }
+    long e = 0;
+    for (long f = 0; f < nFiles; f++)
+        for (long i = 0; i < scan.files[f].nEntries; i++)
+        {
+            entries[e] = scan.files[f].entries[i];
+            entries[e++].entry.file = f;
+        }
+    qsort(entries, total, sizeof(PendingEntry), comparePendingEntries);
+
+    int status = writeCatalog(filename, scan.files, nFiles, entries, total);
+    if (nEntries != NULL)
+        *nEntries = total;
+
+    free(entries);
+    freePendingFiles(scan.files, nFiles, true);
+
+    return status;
+}
+
+int openSaveCatalog(char *filename, SaveCatalog *catalog)
+{
+    if (filename == NULL || catalog == NULL)
+        return READSAVE_ARGUMENTS;
+
+    bzero(catalog, sizeof(SaveCatalog));
+
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+        return READSAVE_INPUT_FILE;
+
+    struct stat fileInfo = {0};
+    if (fstat(fd, &fileInfo) != 0 || fileInfo.st_size < (long)sizeof(CatalogHeader))
+    {
+        close(fd);
+        return READSAVE_INPUT_FILE;
+    }
+
+    unsigned char *bytes = mmap(NULL, fileInfo.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (bytes == MAP_FAILED)
+    {
+        close(fd);
+        return READSAVE_INPUT_FILE;
+    }
+
+    CatalogHeader *header = (CatalogHeader*)bytes;
+    long nBytes = fileInfo.st_size;
+    int status = READSAVE_OK;
+    if (memcmp(header->magic, SAVE_CATALOG_MAGIC, sizeof(header->magic)) != 0)
+        status = READSAVE_INPUT_FILE;
+    // Catalogs are native-endian and not portable between architectures
+    else if (header->byteOrder != SAVE_CATALOG_BYTE_ORDER)
+        status = READSAVE_FILE_VERSION;
+    else if (header->nFiles < 0 || header->nEntries < 0 || header->nStringBytes < 0
+        || header->filesOffset != (long)sizeof(CatalogHeader)
+        || header->entriesOffset != header->filesOffset + header->nFiles * (long)sizeof(CatalogFile)
+        || header->stringsOffset != header->entriesOffset + header->nEntries * (long)sizeof(CatalogEntry)
+        || header->stringsOffset + header->nStringBytes != nBytes
+        || (header->nStringBytes > 0 && bytes[nBytes - 1] != '\0'))
+        status = READSAVE_INPUT_FILE;
+
+    CatalogFile *files = (CatalogFile*)(bytes + sizeof(CatalogHeader));
+    CatalogEntry *entries = (CatalogEntry*)(bytes + (status == READSAVE_OK ? header->entriesOffset : 0));
+    for (long f = 0; status == READSAVE_OK && f < header->nFiles; f++)
+        if (files[f].pathOffset < 0 || files[f].pathOffset >= header->nStringBytes)
+            status = READSAVE_INPUT_FILE;
+    for (long e = 0; status == READSAVE_OK && e < header->nEntries; e++)
+        if (entries[e].nameOffset < 0 || entries[e].nameOffset >= header->nStringBytes || entries[e].file < 0 || entries[e].file >= header->nFiles || entries[e].nDims < 0 || entries[e].nDims > SAVE_CATALOG_MAX_DIMS)
+            status = READSAVE_INPUT_FILE;
+
+    if (status != READSAVE_OK)
+    {
+        munmap(bytes, nBytes);
+        close(fd);
+        return status;
+    }
+
+    catalog->fd = fd;
+    catalog->bytes = bytes;
+    catalog->nBytes = nBytes;
+    catalog->header = header;
+    catalog->files = files;
+    catalog->entries = entries;
+    catalog->strings = (char*)(bytes + header->stringsOffset);
+
+    return READSAVE_OK;
+}
+
+void closeSaveCatalog(SaveCatalog *catalog)
+{
+    if (catalog == NULL || catalog->bytes == NULL)
+        return;
+
+    munmap(catalog->bytes, catalog->nBytes);
+    close(catalog->fd);
+    bzero(catalog, sizeof(SaveCatalog));
+
+    return;
+}
+
+char *catalogString(SaveCatalog *catalog, long offset)
+{
+    if (catalog == NULL || catalog->strings == NULL || offset < 0 || offset >= catalog->header->nStringBytes)
+        return NULL;
+
+    return catalog->strings + offset;
+}
+
+// Binary search of the sorted entries. Returns the number of entries named
+// name (case insensitive) and sets first to the index of the first one.
+long findCatalogEntries(SaveCatalog *catalog, char *name, long *first)
+{
+    if (catalog == NULL || name == NULL || first == NULL)
+        return 0;
+
+    char upper[strlen(name) + 1];
+    for (size_t i = 0; i <= strlen(name); i++)
+        upper[i] = toupper(name[i]);
+
+    // Lower bound, then upper bound
+    long low = 0;
+    long high = catalog->header->nEntries;
+    long middle = 0;
+    while (low < high)
+    {
+        middle = low + (high - low) / 2;
+        if (strcmp(catalog->strings + catalog->entries[middle].nameOffset, upper) < 0)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    *first = low;
+
+    high = catalog->header->nEntries;
+    while (low < high)
+    {
+        middle = low + (high - low) / 2;
+        if (strcmp(catalog->strings + catalog->entries[middle].nameOffset, upper) <= 0)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    return low - *first;
+}
+
+bool catalogFileMatches(SaveCatalog *catalog, long file, CatalogQuery *query)
+{
+    if (catalog == NULL || file < 0 || file >= catalog->header->nFiles || query == NULL)
+        return false;
+
+    long timestamp = catalog->files[file].timestamp;
+    if (query->after != SAVE_CATALOG_UNKNOWN_TIME && (timestamp == SAVE_CATALOG_UNKNOWN_TIME || timestamp < query->after))
+        return false;
+    if (query->before != SAVE_CATALOG_UNKNOWN_TIME && (timestamp == SAVE_CATALOG_UNKNOWN_TIME || timestamp > query->before))
+        return false;
+
+    return true;
+}
+
+bool catalogEntryMatches(SaveCatalog *catalog, CatalogEntry *entry, CatalogQuery *query)
+{
+    if (catalog == NULL || entry == NULL || query == NULL)
+        return false;
+
+    if (query->nDims >= 0)
+    {
+        if (entry->nDims != query->nDims)
+            return false;
+        for (int d = 0; d < entry->nDims; d++)
+            if (entry->dims[d] != query->dims[d])
+                return false;
+    }
+
+    return catalogFileMatches(catalog, entry->file, query);
+}
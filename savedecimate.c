@@ -0,0 +1,253 @@
+/*
+
+    ReadSave: savedecimate.c
+
+    Copyright (C) 2022  Johnathan K Burchill
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "savedecimate.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <math.h>
+
+// Adds count values of a row, first column at index 0, into the block sums.
+// The type is dispatched once per row.
+#define ACCUMULATE_ROW(get) \
+    for (long i = 0; i < count; i++) \
+    { \
+        value = get(row, i); \
+        if (!isnan(value)) \
+        { \
+            sums[i / factor] += value; \
+            counts[i / factor]++; \
+        } \
+    }
+
+static void accumulateRow(ArrayView *row, long count, long factor, double *sums, long *counts)
+{
+    double value = 0.0;
+    switch (row->dataType)
+    {
+        case DataTypeByte:
+            ACCUMULATE_ROW(viewByte);
+            break;
+        case DataTypeInt16:
+            ACCUMULATE_ROW(viewInt16);
+            break;
+        case DataTypeUInt16:
+            ACCUMULATE_ROW(viewUInt16);
+            break;
+        case DataTypeInt32:
+            ACCUMULATE_ROW(viewInt32);
+            break;
+        case DataTypeUInt32:
+            ACCUMULATE_ROW(viewUInt32);
+            break;
+        case DataTypeInt64:
+            ACCUMULATE_ROW(viewInt64);
+            break;
+        case DataTypeUInt64:
+            ACCUMULATE_ROW(viewUInt64);
+            break;
+        case DataTypeFloat:
+            ACCUMULATE_ROW(viewFloat);
+            break;
+        case DataTypeDouble:
+            ACCUMULATE_ROW(viewDouble);
+            break;
+        default:
+            break;
+    }
+
+    return;
+}
+
+#undef ACCUMULATE_ROW
+
+// Advances index over dimensions 1 to nDims - 1 between first[d] and
+// last[d], fastest first. Returns false after the last index.
+static bool nextIndex(long nDims, long *index, long *first, long *last)
+{
+    for (long d = 1; d < nDims; d++)
+    {
+        if (++index[d] < last[d])
+            return true;
+        index[d] = first[d];
+    }
+
+    return false;
+}
+
+static int decimateByStride(ArrayView *view, long nDims, long *factors, long *sourceStrides, Variable *decimated)
+{
+    long *outDims = decimated->arrayInfo.dims;
+    long elementSize = dataTypeSize(view->dataType);
+    long nRows = decimated->arrayInfo.nElements / outDims[0];
+    long index[8] = {0};
+    long first[8] = {0};
+    long sourceRow = 0;
+    ArrayView row = *view;
+    row.stride = view->stride * factors[0];
+    row.nElements = outDims[0];
+    int status = READSAVE_OK;
+    for (long r = 0; r < nRows && status == READSAVE_OK; r++)
+    {
+        sourceRow = 0;
+        for (long d = 1; d < nDims; d++)
+            sourceRow += index[d] * factors[d] * sourceStrides[d];
+        row.bytes = view->bytes + sourceRow * view->stride;
+        status = materializeRange(&row, 0, outDims[0], (unsigned char*)decimated->data + r * outDims[0] * elementSize);
+        nextIndex(nDims, index, first, outDims);
+    }
+
+    return status;
+}
+
+static int decimateByBlockMean(ArrayView *view, long nDims, long *dims, long *factors, long *sourceStrides, Variable *decimated)
+{
+    long *outDims = decimated->arrayInfo.dims;
+    long nRows = decimated->arrayInfo.nElements / outDims[0];
+    long *counts = calloc(outDims[0], sizeof(long));
+    if (counts == NULL)
+        return READSAVE_MEM;
+
+    double *sums = NULL;
+    long outIndex[8] = {0};
+    long zero[8] = {0};
+    long first[8] = {0};
+    long last[8] = {0};
+    long index[8] = {0};
+    long sourceRow = 0;
+    ArrayView row = *view;
+    row.nElements = dims[0];
+    for (long r = 0; r < nRows; r++)
+    {
+        sums = (double*)decimated->data + r * outDims[0];
+        bzero(counts, outDims[0] * sizeof(long));
+        // Source rows of this block, read in file order
+        for (long d = 1; d < nDims; d++)
+        {
+            first[d] = outIndex[d] * factors[d];
+            last[d] = first[d] + factors[d] < dims[d] ? first[d] + factors[d] : dims[d];
+            index[d] = first[d];
+        }
+        do
+        {
+            sourceRow = 0;
+            for (long d = 1; d < nDims; d++)
+                sourceRow += index[d] * sourceStrides[d];
+            row.bytes = view->bytes + sourceRow * view->stride;
+            accumulateRow(&row, dims[0], factors[0], sums, counts);
+        } while (nextIndex(nDims, index, first, last));
+        for (long i = 0; i < outDims[0]; i++)
+            sums[i] = counts[i] > 0 ? sums[i] / (double)counts[i] : NAN;
+        nextIndex(nDims, outIndex, zero, outDims);
+    }
+    free(counts);
+
+    return READSAVE_OK;
+}
+
+int decimateArrayView(ArrayView *view, long *factors, int nFactors, int mode, Variable *decimated)
+{
+    if (view == NULL || view->bytes == NULL || decimated == NULL || (nFactors > 0 && factors == NULL) || nFactors < 0)
+        return READSAVE_ARGUMENTS;
+    if (mode != DecimationStride && mode != DecimationBlockMean)
+        return READSAVE_ARGUMENTS;
+
+    switch (view->dataType)
+    {
+        case DataTypeByte:
+        case DataTypeInt16:
+        case DataTypeUInt16:
+        case DataTypeInt32:
+        case DataTypeUInt32:
+        case DataTypeInt64:
+        case DataTypeUInt64:
+        case DataTypeFloat:
+        case DataTypeDouble:
+            break;
+        default:
+            return READSAVE_ARGUMENTS;
+    }
+
+    // Scalars and inconsistent shapes are treated as one dimensional
+    long nDims = view->nDims;
+    long dims[8] = {0};
+    long product = 1;
+    for (long d = 0; d < nDims && d < 8; d++)
+    {
+        dims[d] = view->dims[d];
+        product *= dims[d];
+    }
+    if (nDims < 1 || nDims > 8 || product != view->nElements)
+    {
+        nDims = 1;
+        dims[0] = view->nElements;
+    }
+    if (view->nElements == 0)
+        return READSAVE_ARGUMENTS;
+
+    long dimFactors[8] = {0};
+    long sourceStrides[8] = {0};
+    long stride = 1;
+    bzero(decimated, sizeof(Variable));
+    decimated->isArray = true;
+    decimated->arrayInfo.nDims = nDims;
+    decimated->arrayInfo.nMax = 8;
+    decimated->arrayInfo.nElements = 1;
+    for (long d = 0; d < 8; d++)
+    {
+        dimFactors[d] = d < nFactors && d < nDims ? factors[d] : 1;
+        if (dimFactors[d] < 1)
+            return READSAVE_ARGUMENTS;
+        decimated->arrayInfo.dims[d] = d < nDims ? (dims[d] + dimFactors[d] - 1) / dimFactors[d] : 1;
+        decimated->arrayInfo.nElements *= decimated->arrayInfo.dims[d];
+        sourceStrides[d] = stride;
+        stride *= d < nDims ? dims[d] : 1;
+    }
+    decimated->dataType = mode == DecimationStride ? view->dataType : DataTypeDouble;
+    decimated->arrayInfo.nBytesPerElement = dataTypeSize(decimated->dataType);
+    decimated->arrayInfo.nBytes = decimated->arrayInfo.nElements * decimated->arrayInfo.nBytesPerElement;
+    decimated->data = calloc(decimated->arrayInfo.nElements, decimated->arrayInfo.nBytesPerElement);
+    if (decimated->data == NULL)
+        return READSAVE_MEM;
+
+    int status = READSAVE_OK;
+    if (mode == DecimationStride)
+        status = decimateByStride(view, nDims, dimFactors, sourceStrides, decimated);
+    else
+        status = decimateByBlockMean(view, nDims, dims, dimFactors, sourceStrides, decimated);
+    if (status != READSAVE_OK)
+        freeVariable(decimated);
+
+    return status;
+}
+
+int decimateVariable(SaveView *view, char *dottedName, long element, long *factors, int nFactors, int mode, Variable *decimated)
+{
+    if (view == NULL || dottedName == NULL || decimated == NULL)
+        return READSAVE_ARGUMENTS;
+
+    ArrayView arrayView = {0};
+    int status = findArrayView(view, dottedName, element, &arrayView);
+    if (status != READSAVE_OK)
+        return status;
+
+    return decimateArrayView(&arrayView, factors, nFactors, mode, decimated);
+}
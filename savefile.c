@@ -0,0 +1,321 @@
+/*
+
+    ReadSave: savefile.c
+
+    Copyright (C) 2022  Johnathan K Burchill
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "savefile.h"
+#include "saveview.h"
+#include "readsave.h"
+#include "savestrings.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+// Reads n bytes at offset into the front of the context buffer
+static int readBytes(ReadSaveContext *context, int fd, long offset, long n)
+{
+    if (n > context->size)
+    {
+        void *mem = realloc(context->buffer, n);
+        if (mem == NULL)
+            return READSAVE_MEM;
+        context->buffer = mem;
+        context->size = n;
+    }
+
+    long done = 0;
+    ssize_t nRead = 0;
+    while (done < n)
+    {
+        nRead = pread(fd, context->buffer + done, n - done, offset + done);
+        if (nRead <= 0)
+            return READSAVE_INPUT_FILE;
+        done += nRead;
+    }
+
+    return READSAVE_OK;
+}
+
+static int readTimestamp(ReadSaveFile *file, ReadSaveContext *context, long start, long end)
+{
+    int status = readBytes(context, file->fd, start, end - start);
+    if (status != READSAVE_OK)
+        return status;
+
+    char *strings[3] = {0};
+    long offset = 4 * 256;
+    for (int i = 0; i < 3 && status == READSAVE_OK; i++)
+        status = readString(context->buffer, end - start, &offset, &strings[i]);
+    file->info.date = strdup(strings[0] != NULL ? strings[0] : "unknown");
+    file->info.operator = strdup(strings[1] != NULL ? strings[1] : "unknown");
+    // The strings are pooled, see openReadSaveFile()
+
+    return status;
+}
+
+// Most definitions fit in the first read; long ones are read again in full
+static int readDefinition(ReadSaveFile *file, ReadSaveContext *context, SaveFileRecord *record)
+{
+    long recordSize = record->end - record->start;
+    long nRead = recordSize < SAVE_FILE_DEFINITION_READ_SIZE ? recordSize : SAVE_FILE_DEFINITION_READ_SIZE;
+    long offset = 0;
+    int status = READSAVE_OK;
+    while (true)
+    {
+        status = readBytes(context, file->fd, record->start, nRead);
+        if (status != READSAVE_OK)
+            return status;
+        offset = 0;
+        status = readString(context->buffer, nRead, &offset, &record->name);
+        if (status == READSAVE_OK)
+            status = readVariableDefinition(context->buffer, nRead, &offset, &record->definition);
+        if (status == READSAVE_OK || nRead == recordSize)
+            break;
+        // The name is pooled
+        record->name = NULL;
+        freeVariable(&record->definition);
+        nRead = recordSize;
+    }
+    record->definition.name = record->name == NULL ? NULL : newString(record->name, strlen(record->name));
+    record->definition.pooledStrings = true;
+    record->dataOffset = record->start + offset;
+
+    return status;
+}
+
+int openReadSaveFile(char *filename, ReadSaveFile *file)
+{
+    if (filename == NULL || file == NULL)
+        return READSAVE_ARGUMENTS;
+
+    bzero(file, sizeof(ReadSaveFile));
+    file->fd = open(filename, O_RDONLY);
+    if (file->fd < 0)
+        return READSAVE_INPUT_FILE;
+
+    struct stat fileInfo = {0};
+    if (fstat(file->fd, &fileInfo) != 0 || fileInfo.st_size < 4)
+    {
+        close(file->fd);
+        file->fd = -1;
+        return READSAVE_INPUT_FILE;
+    }
+    file->nBytes = fileInfo.st_size;
+
+    ReadSaveContext context = {0};
+    int status = readBytes(&context, file->fd, 0, 4);
+    if (status == READSAVE_OK && (context.buffer[0] != 'S' || context.buffer[1] != 'R'))
+        status = READSAVE_INPUT_FILE;
+    else if (status == READSAVE_OK && (context.buffer[2] != 0 || (context.buffer[3] != 4 && context.buffer[3] != 5)))
+        status = READSAVE_FILE_VERSION;
+    if (status != READSAVE_OK)
+    {
+        freeReadSaveContext(&context);
+        closeReadSaveFile(file);
+        return status;
+    }
+
+    file->stringPool = newStringPool();
+    if (file->stringPool == NULL)
+    {
+        freeReadSaveContext(&context);
+        closeReadSaveFile(file);
+        return READSAVE_MEM;
+    }
+    StringPool *previousPool = setActiveStringPool(file->stringPool);
+
+    long offset = 4;
+    long headerOffset = 0;
+    long recordType = RecordTypeNotHandled;
+    long nextOffset = 0;
+    void *mem = NULL;
+    while (status == READSAVE_OK && recordType != RecordTypeEndMarker && offset < file->nBytes - 4)
+    {
+        status = readBytes(&context, file->fd, offset, 16);
+        if (status != READSAVE_OK)
+            break;
+        headerOffset = 0;
+        readRecordHeader(context.buffer, 16, &headerOffset, &recordType, &nextOffset);
+        offset += headerOffset;
+        if (!recordExtentValid(recordType, offset, nextOffset, file->nBytes))
+        {
+            status = READSAVE_CORRUPT_RECORD;
+            break;
+        }
+
+        if (recordType == RecordTypeTimestamp)
+            status = readTimestamp(file, &context, offset, nextOffset);
+        else if (recordType == RecordTypeVariable)
+        {
+            mem = realloc(file->records, (file->nRecords + 1) * sizeof(SaveFileRecord));
+            if (mem == NULL)
+            {
+                status = READSAVE_MEM;
+                break;
+            }
+            file->records = mem;
+            bzero(&file->records[file->nRecords], sizeof(SaveFileRecord));
+            file->records[file->nRecords].start = offset;
+            file->records[file->nRecords].end = nextOffset;
+            file->nRecords++;
+            status = readDefinition(file, &context, &file->records[file->nRecords - 1]);
+        }
+
+        offset = nextOffset;
+    }
+
+    setActiveStringPool(previousPool);
+    freeReadSaveContext(&context);
+    if (status != READSAVE_OK)
+        closeReadSaveFile(file);
+
+    return status;
+}
+
+void closeReadSaveFile(ReadSaveFile *file)
+{
+    if (file == NULL)
+        return;
+
+    // Record names and definitions are in the file's pool
+    for (long r = 0; r < file->nRecords; r++)
+        freeVariable(&file->records[r].definition);
+    freeStringPool(file->stringPool);
+    free(file->records);
+    freeSaveInfo(&file->info);
+    if (file->fd >= 0)
+        close(file->fd);
+    bzero(file, sizeof(ReadSaveFile));
+    file->fd = -1;
+
+    return;
+}
+
+SaveFileRecord *findSaveFileRecord(ReadSaveFile *file, char *variableName)
+{
+    if (file == NULL || variableName == NULL)
+        return NULL;
+
+    for (long r = 0; r < file->nRecords; r++)
+        if (file->records[r].name != NULL && strcasecmp(file->records[r].name, variableName) == 0)
+            return &file->records[r];
+
+    return NULL;
+}
+
+// Decodes one variable record and appends it to variables
+int readSaveFileVariable(ReadSaveFile *file, ReadSaveContext *context, char *variableName, VariableList *variables)
+{
+    if (file == NULL || context == NULL || variableName == NULL || variables == NULL)
+        return READSAVE_ARGUMENTS;
+
+    SaveFileRecord *record = findSaveFileRecord(file, variableName);
+    if (record == NULL)
+        return READSAVE_VARIABLE_NOT_FOUND;
+
+    long recordSize = record->end - record->start;
+    int status = readBytes(context, file->fd, record->start, recordSize);
+    if (status != READSAVE_OK)
+        return status;
+
+    if (variables->stringPool == NULL)
+        variables->stringPool = newStringPool();
+    StringPool *previousPool = setActiveStringPool(variables->stringPool);
+    long offset = 0;
+    status = readVariable(context->buffer, recordSize, &offset, variables);
+    setActiveStringPool(previousPool);
+
+    return status;
+}
+
+// Decodes count values from start of a numeric variable or structure tag,
+// as materializeRange() does. element selects the structure array element.
+// Plain arrays are read with a single pread() of just the requested values.
+int readSaveFileSlice(ReadSaveFile *file, ReadSaveContext *context, char *dottedName, long element, long start, long count, void *values)
+{
+    if (file == NULL || context == NULL || dottedName == NULL || values == NULL || element < 0 || start < 0 || count < 0)
+        return READSAVE_ARGUMENTS;
+
+    char *buffer = NULL;
+    char *tagFields[READSAVE_MAX_TAG_DEPTH] = {0};
+    int nTagFields = tagPath(dottedName, &buffer, tagFields, READSAVE_MAX_TAG_DEPTH);
+    SaveFileRecord *record = nTagFields > 0 ? findSaveFileRecord(file, tagFields[0]) : NULL;
+    if (record == NULL)
+    {
+        free(buffer);
+        return READSAVE_VARIABLE_NOT_FOUND;
+    }
+
+    Variable *definition = &record->definition;
+    ArrayView view = {0};
+    int status = READSAVE_OK;
+    long offset = 0;
+    long nDataBytes = record->end - record->dataOffset;
+    if (!definition->isStructure)
+    {
+        long nElements = definition->isArray ? definition->arrayInfo.nElements : 1;
+        long stride = fileElementSize(definition->dataType);
+        // Byte data is preceded by its length
+        long first = record->dataOffset + (definition->dataType == DataTypeByte ? 4 : 0) + start * stride;
+        if (nTagFields != 1 || element != 0 || definition->dataType == DataTypeString || stride == 0)
+            status = READSAVE_ARGUMENTS;
+        else if (start + count > nElements || first + count * stride > record->end)
+            status = READSAVE_READ_ARRAY;
+        else
+            status = readBytes(context, file->fd, first, count * stride);
+        view.bytes = context->buffer;
+        view.dataType = definition->dataType;
+        view.nElements = count;
+        view.stride = stride;
+        start = 0;
+    }
+    else
+    {
+        if (element >= definition->arrayInfo.nElements)
+            status = READSAVE_ARGUMENTS;
+        else
+            status = readBytes(context, file->fd, record->dataOffset, nDataBytes);
+        for (long e = 0; status == READSAVE_OK && e < element; e++)
+            if (skipStructure(context->buffer, nDataBytes, &offset, definition) > nDataBytes)
+                status = READSAVE_READ_STRUCTURE;
+        if (status == READSAVE_OK)
+            status = findTagView(context->buffer, nDataBytes, &offset, definition, tagFields + 1, nTagFields - 1, &view);
+    }
+    free(buffer);
+    if (status != READSAVE_OK)
+        return status;
+
+    return materializeRange(&view, start, count, values);
+}
+
+void freeReadSaveContext(ReadSaveContext *context)
+{
+    if (context == NULL)
+        return;
+
+    free(context->buffer);
+    context->buffer = NULL;
+    context->size = 0;
+
+    return;
+}
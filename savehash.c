@@ -0,0 +1,313 @@
+/*
+
+    ReadSave: savehash.c
+
+    Copyright (C) 2022  Johnathan K Burchill
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "savehash.h"
+#include "savestrings.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <pthread.h>
+
+#define HASH_PRIME_1 0x9E3779B185EBCA87ULL
+#define HASH_PRIME_2 0xC2B2AE3D27D4EB4FULL
+#define HASH_PRIME_3 0x165667B19E3779F9ULL
+#define HASH_PRIME_4 0x85EBCA77C2B2AE63ULL
+#define HASH_PRIME_5 0x27D4EB2F165667C5ULL
+
+typedef struct HashWork
+{
+    char **files;
+    long nFiles;
+    long next;
+    pthread_mutex_t mutex;
+    int *statuses;
+    RecordHash **hashes;
+    long *nHashes;
+
+} HashWork;
+
+static inline uint64_t rotateLeft(uint64_t value, int bits)
+{
+    return (value << bits) | (value >> (64 - bits));
+}
+
+// The hash is defined on little-endian words
+static inline uint64_t loadWord64(const unsigned char *bytes)
+{
+    uint64_t value;
+    memcpy(&value, bytes, sizeof(value));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    value = __builtin_bswap64(value);
+#endif
+    return value;
+}
+
+static inline uint64_t loadWord32(const unsigned char *bytes)
+{
+    uint32_t value;
+    memcpy(&value, bytes, sizeof(value));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    value = __builtin_bswap32(value);
+#endif
+    return value;
+}
+
+static inline uint64_t hashRound(uint64_t accumulator, uint64_t input)
+{
+    accumulator += input * HASH_PRIME_2;
+    accumulator = rotateLeft(accumulator, 31);
+    return accumulator * HASH_PRIME_1;
+}
+
+static inline uint64_t mergeRound(uint64_t hash, uint64_t accumulator)
+{
+    hash ^= hashRound(0, accumulator);
+    return hash * HASH_PRIME_1 + HASH_PRIME_4;
+}
+
+uint64_t hashBytes(const void *bytes, long nBytes, uint64_t seed)
+{
+    const unsigned char *p = (const unsigned char*)bytes;
+    const unsigned char *end = p + (nBytes > 0 ? nBytes : 0);
+    uint64_t hash = 0;
+
+    // Four independent lanes over 32-byte stripes
+    if (nBytes >= 32)
+    {
+        uint64_t v1 = seed + HASH_PRIME_1 + HASH_PRIME_2;
+        uint64_t v2 = seed + HASH_PRIME_2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - HASH_PRIME_1;
+        const unsigned char *limit = end - 32;
+        do
+        {
+            v1 = hashRound(v1, loadWord64(p));
+            v2 = hashRound(v2, loadWord64(p + 8));
+            v3 = hashRound(v3, loadWord64(p + 16));
+            v4 = hashRound(v4, loadWord64(p + 24));
+            p += 32;
+        } while (p <= limit);
+        hash = rotateLeft(v1, 1) + rotateLeft(v2, 7) + rotateLeft(v3, 12) + rotateLeft(v4, 18);
+        hash = mergeRound(hash, v1);
+        hash = mergeRound(hash, v2);
+        hash = mergeRound(hash, v3);
+        hash = mergeRound(hash, v4);
+    }
+    else
+        hash = seed + HASH_PRIME_5;
+
+    hash += (uint64_t)(nBytes > 0 ? nBytes : 0);
+
+    for (; p + 8 <= end; p += 8)
+    {
+        hash ^= hashRound(0, loadWord64(p));
+        hash = rotateLeft(hash, 27) * HASH_PRIME_1 + HASH_PRIME_4;
+    }
+    if (p + 4 <= end)
+    {
+        hash ^= loadWord32(p) * HASH_PRIME_1;
+        hash = rotateLeft(hash, 23) * HASH_PRIME_2 + HASH_PRIME_3;
+        p += 4;
+    }
+    for (; p < end; p++)
+    {
+        hash ^= *p * HASH_PRIME_5;
+        hash = rotateLeft(hash, 11) * HASH_PRIME_1;
+    }
+
+    hash ^= hash >> 33;
+    hash *= HASH_PRIME_2;
+    hash ^= hash >> 29;
+    hash *= HASH_PRIME_3;
+    hash ^= hash >> 32;
+
+    return hash;
+}
+
+uint64_t variableRecordHash(unsigned char *bytes, long recordEnd, long offset)
+{
+    if (bytes == NULL || offset < 0 || offset > recordEnd)
+        return 0;
+
+    return hashBytes(bytes + offset, recordEnd - offset, 0);
+}
+
+int hashSaveRecords(SaveView *view, long file, RecordHash **hashes, long *nHashes)
+{
+    if (view == NULL || view->bytes == NULL || hashes == NULL || nHashes == NULL)
+        return READSAVE_ARGUMENTS;
+
+    unsigned char *bytes = view->bytes;
+    long nBytes = view->nBytes;
+    long offset = 4;
+    long recordType = RecordTypeNotHandled;
+    long nextOffset = 0;
+    long recordStart = 0;
+    char *name = NULL;
+    void *mem = NULL;
+    RecordHash *hash = NULL;
+    int status = READSAVE_OK;
+    while (recordType != RecordTypeEndMarker && offset > 0 && offset < nBytes - 4)
+    {
+        recordStart = offset;
+        readRecordHeader(bytes, nBytes, &offset, &recordType, &nextOffset);
+        if (!recordExtentValid(recordType, offset, nextOffset, nBytes))
+            return READSAVE_CORRUPT_RECORD;
+        if (recordType != RecordTypeVariable)
+        {
+            offset = nextOffset;
+            continue;
+        }
+
+        status = readString(bytes, nextOffset, &offset, &name);
+        if (status != READSAVE_OK)
+            return status;
+        mem = realloc(*hashes, (*nHashes + 1) * sizeof(RecordHash));
+        if (mem == NULL)
+        {
+            freeString(name);
+            return READSAVE_MEM;
+        }
+        *hashes = mem;
+        hash = &(*hashes)[(*nHashes)++];
+        hash->name = name;
+        hash->file = file;
+        hash->offset = recordStart;
+        hash->nBytes = nextOffset - offset;
+        hash->hash = variableRecordHash(bytes, nextOffset, offset);
+        offset = nextOffset;
+    }
+
+    return READSAVE_OK;
+}
+
+static void *hashThread(void *arg)
+{
+    HashWork *work = (HashWork*)arg;
+    long f = 0;
+    SaveView view = {0};
+    while (true)
+    {
+        pthread_mutex_lock(&work->mutex);
+        f = work->next++;
+        pthread_mutex_unlock(&work->mutex);
+        if (f >= work->nFiles)
+            break;
+        work->statuses[f] = openSaveView(work->files[f], &view);
+        if (work->statuses[f] != READSAVE_OK)
+            continue;
+        work->statuses[f] = hashSaveRecords(&view, f, &work->hashes[f], &work->nHashes[f]);
+        closeSaveView(&view);
+    }
+
+    return NULL;
+}
+
+static int compareRecordHashes(const void *a, const void *b)
+{
+    const RecordHash *first = (const RecordHash*)a;
+    const RecordHash *second = (const RecordHash*)b;
+    if (first->hash != second->hash)
+        return first->hash < second->hash ? -1 : 1;
+    if (first->nBytes != second->nBytes)
+        return first->nBytes < second->nBytes ? -1 : 1;
+    if (first->file != second->file)
+        return first->file < second->file ? -1 : 1;
+
+    return first->offset < second->offset ? -1 : first->offset > second->offset;
+}
+
+int hashSaveFiles(char **files, long nFiles, int nThreads, int *statuses, RecordHash **hashes, long *nHashes)
+{
+    if (files == NULL || nFiles < 0 || statuses == NULL || hashes == NULL || nHashes == NULL)
+        return READSAVE_ARGUMENTS;
+
+    *hashes = NULL;
+    *nHashes = 0;
+
+    HashWork work = {0};
+    work.files = files;
+    work.nFiles = nFiles;
+    work.statuses = statuses;
+    work.hashes = calloc(nFiles > 0 ? nFiles : 1, sizeof(RecordHash*));
+    work.nHashes = calloc(nFiles > 0 ? nFiles : 1, sizeof(long));
+    if (work.hashes == NULL || work.nHashes == NULL)
+    {
+        free(work.hashes);
+        free(work.nHashes);
+        return READSAVE_MEM;
+    }
+    pthread_mutex_init(&work.mutex, NULL);
+
+    if (nThreads > nFiles)
+        nThreads = nFiles;
+    if (nThreads < 1)
+        nThreads = 1;
+    pthread_t threads[nThreads];
+    bool started[nThreads];
+    // The calling thread hashes too
+    for (int t = 0; t < nThreads - 1; t++)
+        started[t] = pthread_create(&threads[t], NULL, hashThread, &work) == 0;
+    hashThread(&work);
+    for (int t = 0; t < nThreads - 1; t++)
+        if (started[t])
+            pthread_join(threads[t], NULL);
+    pthread_mutex_destroy(&work.mutex);
+
+    // Records of a corrupt file read before the corruption are kept
+    long total = 0;
+    for (long f = 0; f < nFiles; f++)
+        total += work.nHashes[f];
+    int status = READSAVE_OK;
+    *hashes = malloc((total > 0 ? total : 1) * sizeof(RecordHash));
+    if (*hashes == NULL)
+        status = READSAVE_MEM;
+    for (long f = 0; f < nFiles; f++)
+    {
+        if (status == READSAVE_OK)
+        {
+            memcpy(*hashes + *nHashes, work.hashes[f], work.nHashes[f] * sizeof(RecordHash));
+            *nHashes += work.nHashes[f];
+            free(work.hashes[f]);
+        }
+        else
+            freeRecordHashes(work.hashes[f], work.nHashes[f]);
+    }
+    free(work.hashes);
+    free(work.nHashes);
+    if (status == READSAVE_OK)
+        qsort(*hashes, *nHashes, sizeof(RecordHash), compareRecordHashes);
+
+    return status;
+}
+
+void freeRecordHashes(RecordHash *hashes, long nHashes)
+{
+    if (hashes == NULL)
+        return;
+
+    for (long i = 0; i < nHashes; i++)
+        freeString(hashes[i].name);
+    free(hashes);
+
+    return;
+}
@@ -0,0 +1,234 @@
+/*
+
+    ReadSave: saveio.c
+
+    Copyright (C) 2022  Johnathan K Burchill
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#define _GNU_SOURCE
+
+#include "saveio.h"
+#include "readsave.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+typedef struct BatchScan
+{
+    char **filenames;
+    long nFiles;
+    SaveInfo *infos;
+    VariableList *variables;
+    int *statuses;
+    long nextFile;
+    pthread_mutex_t mutex;
+
+} BatchScan;
+
+static void *readerThread(void *arg)
+{
+    ReadPipeline *pipeline = (ReadPipeline*)arg;
+
+    long offset = 0;
+    long chunk = 0;
+    ssize_t nRead = 0;
+    int status = READSAVE_OK;
+    while (offset < pipeline->nBytes)
+    {
+        pthread_mutex_lock(&pipeline->mutex);
+        bool cancel = pipeline->cancel;
+        pthread_mutex_unlock(&pipeline->mutex);
+        if (cancel)
+            break;
+
+        // Keep the kernel a few chunks ahead of the pread below
+        readahead(pipeline->fd, offset + pipeline->chunkSize, READ_PIPELINE_READAHEAD_CHUNKS * pipeline->chunkSize);
+
+        chunk = pipeline->nBytes - offset;
+        if (chunk > pipeline->chunkSize)
+            chunk = pipeline->chunkSize;
+        nRead = pread(pipeline->fd, pipeline->bytes + offset, chunk, offset);
+        if (nRead < 0 && errno == EINTR)
+            continue;
+        if (nRead <= 0)
+        {
+            status = READSAVE_INPUT_FILE;
+            break;
+        }
+        offset += nRead;
+
+        pthread_mutex_lock(&pipeline->mutex);
+        pipeline->nAvailable = offset;
+        pthread_cond_broadcast(&pipeline->arrived);
+        pthread_mutex_unlock(&pipeline->mutex);
+    }
+
+    pthread_mutex_lock(&pipeline->mutex);
+    pipeline->status = status;
+    pipeline->running = false;
+    pthread_cond_broadcast(&pipeline->arrived);
+    pthread_mutex_unlock(&pipeline->mutex);
+
+    return NULL;
+}
+
+int startReadPipeline(char *filename, long chunkSize, ReadPipeline *pipeline)
+{
+    if (filename == NULL || pipeline == NULL)
+        return READSAVE_ARGUMENTS;
+
+    bzero(pipeline, sizeof(ReadPipeline));
+
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+        return READSAVE_INPUT_FILE;
+
+    struct stat fileInfo = {0};
+    if (fstat(fd, &fileInfo) != 0)
+    {
+        close(fd);
+        return READSAVE_INPUT_FILE;
+    }
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    pipeline->bytes = malloc(fileInfo.st_size > 0 ? fileInfo.st_size : 1);
+    if (pipeline->bytes == NULL)
+    {
+        close(fd);
+        return READSAVE_MEM;
+    }
+    pipeline->fd = fd;
+    pipeline->nBytes = fileInfo.st_size;
+    pipeline->chunkSize = chunkSize > 0 ? chunkSize : READ_PIPELINE_CHUNK_SIZE;
+    pipeline->running = true;
+    pthread_mutex_init(&pipeline->mutex, NULL);
+    pthread_cond_init(&pipeline->arrived, NULL);
+
+    if (pthread_create(&pipeline->thread, NULL, readerThread, pipeline) != 0)
+    {
+        // No thread available: read everything up front instead
+        readerThread(pipeline);
+        pipeline->thread = pthread_self();
+    }
+
+    return READSAVE_OK;
+}
+
+int waitForBytes(ReadPipeline *pipeline, long nBytes)
+{
+    if (pipeline == NULL)
+        return READSAVE_ARGUMENTS;
+
+    if (nBytes > pipeline->nBytes)
+        nBytes = pipeline->nBytes;
+
+    int status = READSAVE_OK;
+    pthread_mutex_lock(&pipeline->mutex);
+    while (pipeline->nAvailable < nBytes && pipeline->running)
+        pthread_cond_wait(&pipeline->arrived, &pipeline->mutex);
+    if (pipeline->nAvailable < nBytes)
+        status = pipeline->status != READSAVE_OK ? pipeline->status : READSAVE_INPUT_FILE;
+    pthread_mutex_unlock(&pipeline->mutex);
+
+    return status;
+}
+
+void stopReadPipeline(ReadPipeline *pipeline)
+{
+    if (pipeline == NULL || pipeline->bytes == NULL)
+        return;
+
+    pthread_mutex_lock(&pipeline->mutex);
+    pipeline->cancel = true;
+    pthread_mutex_unlock(&pipeline->mutex);
+    if (!pthread_equal(pipeline->thread, pthread_self()))
+        pthread_join(pipeline->thread, NULL);
+
+    pthread_cond_destroy(&pipeline->arrived);
+    pthread_mutex_destroy(&pipeline->mutex);
+    close(pipeline->fd);
+    free(pipeline->bytes);
+    bzero(pipeline, sizeof(ReadPipeline));
+
+    return;
+}
+
+static void *batchThread(void *arg)
+{
+    BatchScan *scan = (BatchScan*)arg;
+
+    long file = 0;
+    while (true)
+    {
+        pthread_mutex_lock(&scan->mutex);
+        file = scan->nextFile++;
+        pthread_mutex_unlock(&scan->mutex);
+        if (file >= scan->nFiles)
+            break;
+        scan->statuses[file] = readSave(scan->filenames[file], &scan->infos[file], &scan->variables[file]);
+    }
+
+    return NULL;
+}
+
+int readSaveFiles(char **filenames, long nFiles, SaveInfo *infos, VariableList *variables, int *statuses, int nInFlight)
+{
+    if (filenames == NULL || infos == NULL || variables == NULL || statuses == NULL || nFiles < 0)
+        return READSAVE_ARGUMENTS;
+
+    if (nInFlight < 1)
+        nInFlight = READ_PIPELINE_FILES_IN_FLIGHT;
+    if (nInFlight > nFiles)
+        nInFlight = (int)nFiles;
+
+    BatchScan scan = {0};
+    scan.filenames = filenames;
+    scan.nFiles = nFiles;
+    scan.infos = infos;
+    scan.variables = variables;
+    scan.statuses = statuses;
+    pthread_mutex_init(&scan.mutex, NULL);
+
+    pthread_t *threads = calloc(nInFlight > 0 ? nInFlight : 1, sizeof(pthread_t));
+    if (threads == NULL)
+    {
+        pthread_mutex_destroy(&scan.mutex);
+        return READSAVE_MEM;
+    }
+
+    // The calling thread scans files too
+    int nStarted = 0;
+    for (int t = 0; t < nInFlight - 1; t++)
+        if (pthread_create(&threads[nStarted], NULL, batchThread, &scan) == 0)
+            nStarted++;
+
+    batchThread(&scan);
+
+    for (int t = 0; t < nStarted; t++)
+        pthread_join(threads[t], NULL);
+
+    free(threads);
+    pthread_mutex_destroy(&scan.mutex);
+
+    return READSAVE_OK;
+}
@@ -0,0 +1,156 @@
+/*
+
+    ReadSave: saveshm.c
+
+    Copyright (C) 2022  Johnathan K Burchill
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "saveshm.h"
+#include "readsave.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+int exportSharedVariable(Variable *var, char *segmentName, SharedVariable *shared)
+{
+    if (var == NULL || segmentName == NULL || shared == NULL || var->data == NULL)
+        return READSAVE_ARGUMENTS;
+
+    // Only flat numeric data can be attached without parsing
+    long elementSize = dataTypeSize(var->dataType);
+    if (var->isStructure || elementSize == 0)
+        return READSAVE_ARGUMENTS;
+
+    SharedArrayDescriptor descriptor = {0};
+    memcpy(descriptor.magic, SHARED_VARIABLE_MAGIC, sizeof(descriptor.magic));
+    descriptor.dataType = var->dataType;
+    descriptor.nBytesPerElement = elementSize;
+    if (var->isArray)
+    {
+        descriptor.nElements = var->arrayInfo.nElements;
+        descriptor.nDims = var->arrayInfo.nDims;
+        for (int d = 0; d < var->arrayInfo.nDims && d < 8; d++)
+            descriptor.dims[d] = var->arrayInfo.dims[d];
+    }
+    else
+    {
+        descriptor.nElements = 1;
+        descriptor.nDims = 0;
+    }
+    long stride = elementSize;
+    for (int i = 0; i < descriptor.nDims; i++)
+    {
+        // Row-major data has its last dimension varying fastest
+        int d = var->rowMajor ? descriptor.nDims - 1 - i : i;
+        descriptor.strides[d] = stride;
+        stride *= descriptor.dims[d];
+    }
+    descriptor.nBytes = descriptor.nElements * elementSize;
+    descriptor.dataOffset = SHARED_VARIABLE_ALIGNMENT * ((sizeof(SharedArrayDescriptor) + SHARED_VARIABLE_ALIGNMENT - 1) / SHARED_VARIABLE_ALIGNMENT);
+    if (var->name != NULL)
+        strncpy(descriptor.variableName, var->name, SHARED_VARIABLE_NAME_LENGTH - 1);
+
+    size_t size = descriptor.dataOffset + descriptor.nBytes;
+
+    int fd = shm_open(segmentName, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return READSAVE_INPUT_FILE;
+    if (ftruncate(fd, size) != 0)
+    {
+        close(fd);
+        shm_unlink(segmentName);
+        return READSAVE_MEM;
+    }
+    void *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        shm_unlink(segmentName);
+        return READSAVE_MEM;
+    }
+
+    memcpy(map, &descriptor, sizeof(SharedArrayDescriptor));
+    memcpy((unsigned char*)map + descriptor.dataOffset, var->data, descriptor.nBytes);
+
+    shared->descriptor = (SharedArrayDescriptor*)map;
+    shared->data = (unsigned char*)map + descriptor.dataOffset;
+    shared->mappedSize = size;
+
+    return READSAVE_OK;
+}
+
+int attachSharedVariable(char *segmentName, SharedVariable *shared)
+{
+    if (segmentName == NULL || shared == NULL)
+        return READSAVE_ARGUMENTS;
+
+    int fd = shm_open(segmentName, O_RDONLY, 0);
+    if (fd < 0)
+        return READSAVE_INPUT_FILE;
+
+    struct stat segmentInfo = {0};
+    if (fstat(fd, &segmentInfo) != 0 || (size_t)segmentInfo.st_size < sizeof(SharedArrayDescriptor))
+    {
+        close(fd);
+        return READSAVE_INPUT_FILE;
+    }
+
+    void *map = mmap(NULL, segmentInfo.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return READSAVE_MEM;
+
+    SharedArrayDescriptor *descriptor = (SharedArrayDescriptor*)map;
+    if (memcmp(descriptor->magic, SHARED_VARIABLE_MAGIC, sizeof(descriptor->magic)) != 0 || descriptor->dataOffset + descriptor->nBytes > segmentInfo.st_size)
+    {
+        munmap(map, segmentInfo.st_size);
+        return READSAVE_FILE_VERSION;
+    }
+
+    shared->descriptor = descriptor;
+    shared->data = (unsigned char*)map + descriptor->dataOffset;
+    shared->mappedSize = segmentInfo.st_size;
+
+    return READSAVE_OK;
+}
+
+int detachSharedVariable(SharedVariable *shared)
+{
+    if (shared == NULL || shared->descriptor == NULL)
+        return READSAVE_ARGUMENTS;
+
+    munmap(shared->descriptor, shared->mappedSize);
+    bzero(shared, sizeof(SharedVariable));
+
+    return READSAVE_OK;
+}
+
+int unlinkSharedVariable(char *segmentName)
+{
+    if (segmentName == NULL)
+        return READSAVE_ARGUMENTS;
+
+    if (shm_unlink(segmentName) != 0)
+        return READSAVE_INPUT_FILE;
+
+    return READSAVE_OK;
+}
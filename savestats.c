@@ -0,0 +1,366 @@
+/*
+
+    ReadSave: savestats.c
+
+    Copyright (C) 2022  Johnathan K Burchill
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "savestats.h"
+#include "saveview.h"
+#include "readsave.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <math.h>
+#include <pthread.h>
+
+typedef struct StatsTask
+{
+    ArrayView view;
+    long start;
+    long count;
+    ArrayStats stats;
+    int status;
+
+} StatsTask;
+
+int initArrayStats(ArrayStats *stats, long nBins, double binMin, double binMax)
+{
+    if (stats == NULL || nBins < 0 || (nBins > 0 && !(binMax > binMin)))
+        return READSAVE_ARGUMENTS;
+
+    bzero(stats, sizeof(ArrayStats));
+    stats->min = INFINITY;
+    stats->max = -INFINITY;
+    stats->nBins = nBins;
+    stats->binMin = binMin;
+    stats->binMax = binMax;
+    if (nBins > 0)
+    {
+        stats->histogram = calloc(nBins, sizeof(long));
+        if (stats->histogram == NULL)
+            return READSAVE_MEM;
+    }
+
+    return READSAVE_OK;
+}
+
+void freeArrayStats(ArrayStats *stats)
+{
+    if (stats == NULL)
+        return;
+
+    free(stats->histogram);
+    stats->histogram = NULL;
+    stats->nBins = 0;
+
+    return;
+}
+
+void finishArrayStats(ArrayStats *stats)
+{
+    if (stats == NULL)
+        return;
+
+    long nFinite = stats->nValues - stats->nNaN;
+    stats->mean = nFinite > 0 ? stats->sum / (double)nFinite : NAN;
+
+    return;
+}
+
+// Byte swap and widen one block. Each loop is a straight-line gather of
+// fixed-stride words, which the compiler vectorizes.
+static void convertBlock(ArrayView *view, long start, long count, double *values)
+{
+    ArrayView block = *view;
+    block.bytes = view->bytes + start * view->stride;
+
+    switch (view->dataType)
+    {
+        case DataTypeByte:
+            for (long i = 0; i < count; i++)
+                values[i] = viewByte(&block, i);
+            break;
+        case DataTypeInt16:
+            for (long i = 0; i < count; i++)
+                values[i] = viewInt16(&block, i);
+            break;
+        case DataTypeUInt16:
+            for (long i = 0; i < count; i++)
+                values[i] = viewUInt16(&block, i);
+            break;
+        case DataTypeInt32:
+            for (long i = 0; i < count; i++)
+                values[i] = viewInt32(&block, i);
+            break;
+        case DataTypeUInt32:
+            for (long i = 0; i < count; i++)
+                values[i] = viewUInt32(&block, i);
+            break;
+        case DataTypeInt64:
+            for (long i = 0; i < count; i++)
+                values[i] = (double)viewInt64(&block, i);
+            break;
+        case DataTypeUInt64:
+            for (long i = 0; i < count; i++)
+                values[i] = (double)viewUInt64(&block, i);
+            break;
+        case DataTypeFloat:
+            for (long i = 0; i < count; i++)
+                values[i] = viewFloat(&block, i);
+            break;
+        case DataTypeDouble:
+            for (long i = 0; i < count; i++)
+                values[i] = viewDouble(&block, i);
+            break;
+        default:
+            break;
+    }
+
+    return;
+}
+
+// Branch-free reduction: NaN fails every comparison, so it never
+// becomes the min or max and contributes zero to the sum.
+static void reduceBlock(double *values, long count, ArrayStats *stats)
+{
+    double minimum = stats->min;
+    double maximum = stats->max;
+    double sum = 0.0;
+    long nNaN = 0;
+    double v = 0.0;
+
+    for (long i = 0; i < count; i++)
+    {
+        v = values[i];
+        nNaN += v != v;
+        minimum = v < minimum ? v : minimum;
+        maximum = v > maximum ? v : maximum;
+        sum += v == v ? v : 0.0;
+    }
+
+    stats->min = minimum;
+    stats->max = maximum;
+    stats->sum += sum;
+    stats->nNaN += nNaN;
+    stats->nValues += count;
+
+    if (stats->nBins > 0)
+    {
+        double scale = (double)stats->nBins / (stats->binMax - stats->binMin);
+        long bin = 0;
+        for (long i = 0; i < count; i++)
+        {
+            v = values[i];
+            if (v >= stats->binMin && v < stats->binMax)
+            {
+                bin = (long)((v - stats->binMin) * scale);
+                if (bin >= stats->nBins)
+                    bin = stats->nBins - 1;
+                stats->histogram[bin]++;
+            }
+        }
+    }
+
+    return;
+}
+
+static void reduceRange(ArrayView *view, long start, long count, ArrayStats *stats)
+{
+    double values[STATS_BLOCK_SIZE];
+    long n = 0;
+    for (long i = start; i < start + count; i += STATS_BLOCK_SIZE)
+    {
+        n = start + count - i;
+        if (n > STATS_BLOCK_SIZE)
+            n = STATS_BLOCK_SIZE;
+        convertBlock(view, i, n, values);
+        reduceBlock(values, n, stats);
+    }
+
+    return;
+}
+
+static void *statsThread(void *arg)
+{
+    StatsTask *task = (StatsTask*)arg;
+    reduceRange(&task->view, task->start, task->count, &task->stats);
+
+    return NULL;
+}
+
+static void mergeArrayStats(ArrayStats *dst, ArrayStats *src)
+{
+    dst->nValues += src->nValues;
+    dst->nNaN += src->nNaN;
+    dst->sum += src->sum;
+    if (src->min < dst->min)
+        dst->min = src->min;
+    if (src->max > dst->max)
+        dst->max = src->max;
+    for (long b = 0; b < dst->nBins && b < src->nBins; b++)
+        dst->histogram[b] += src->histogram[b];
+
+    return;
+}
+
+int accumulateArrayStats(ArrayView *view, ArrayStats *stats, int nThreads)
+{
+    if (view == NULL || stats == NULL)
+        return READSAVE_ARGUMENTS;
+
+    switch (view->dataType)
+    {
+        case DataTypeByte:
+        case DataTypeInt16:
+        case DataTypeUInt16:
+        case DataTypeInt32:
+        case DataTypeUInt32:
+        case DataTypeInt64:
+        case DataTypeUInt64:
+        case DataTypeFloat:
+        case DataTypeDouble:
+            break;
+        default:
+            return READSAVE_READ_ARRAY;
+    }
+
+    long maxThreads = view->nElements / STATS_MIN_ELEMENTS_PER_THREAD;
+    if (nThreads > maxThreads)
+        nThreads = (int)maxThreads;
+    if (nThreads <= 1)
+    {
+        reduceRange(view, 0, view->nElements, stats);
+        return READSAVE_OK;
+    }
+
+    StatsTask *tasks = calloc(nThreads, sizeof(StatsTask));
+    pthread_t *threads = calloc(nThreads, sizeof(pthread_t));
+    if (tasks == NULL || threads == NULL)
+    {
+        free(tasks);
+        free(threads);
+        return READSAVE_MEM;
+    }
+
+    int status = READSAVE_OK;
+    long perThread = (view->nElements + nThreads - 1) / nThreads;
+    for (int t = 0; t < nThreads; t++)
+    {
+        tasks[t].view = *view;
+        tasks[t].start = t * perThread;
+        tasks[t].count = view->nElements - tasks[t].start;
+        if (tasks[t].count > perThread)
+            tasks[t].count = perThread;
+        status = initArrayStats(&tasks[t].stats, stats->nBins, stats->binMin, stats->binMax);
+        if (status != READSAVE_OK)
+            break;
+        if (pthread_create(&threads[t], NULL, statsThread, &tasks[t]) != 0)
+        {
+            // Finish this share on the calling thread
+            statsThread(&tasks[t]);
+            mergeArrayStats(stats, &tasks[t].stats);
+            freeArrayStats(&tasks[t].stats);
+            continue;
+        }
+        tasks[t].status = 1;
+    }
+
+    for (int t = 0; t < nThreads; t++)
+    {
+        if (tasks[t].status != 1)
+            continue;
+        pthread_join(threads[t], NULL);
+        mergeArrayStats(stats, &tasks[t].stats);
+        freeArrayStats(&tasks[t].stats);
+    }
+
+    free(tasks);
+    free(threads);
+
+    return status;
+}
+
+int readArrayStats(unsigned char *bytes, long nBytes, long *offset, Variable *var, ArrayStats *stats, int nThreads)
+{
+    if (bytes == NULL || offset == NULL || *offset >= nBytes || var == NULL || stats == NULL)
+        return READSAVE_ARGUMENTS;
+
+    ArrayView view = {0};
+    long start = *offset;
+    int status = findTagView(bytes, nBytes, &start, var, NULL, 0, &view);
+    if (status != READSAVE_OK)
+        return status;
+
+    status = accumulateArrayStats(&view, stats, nThreads);
+    if (status != READSAVE_OK)
+        return status;
+
+    // Leave the offset where readArray() would
+    if (var->isArray)
+        skipArray(bytes, nBytes, offset, var);
+    else
+        skipScalar(bytes, nBytes, offset, var->dataType);
+
+    return READSAVE_OK;
+}
+
+int variableStats(SaveView *view, char *dottedName, ArrayStats *stats, int nThreads)
+{
+    if (view == NULL || dottedName == NULL || stats == NULL)
+        return READSAVE_ARGUMENTS;
+
+    char *buffer = NULL;
+    char *tagFields[READSAVE_MAX_TAG_DEPTH] = {0};
+    int nTagFields = tagPath(dottedName, &buffer, tagFields, READSAVE_MAX_TAG_DEPTH);
+    if (nTagFields == 0)
+    {
+        free(buffer);
+        return READSAVE_ARGUMENTS;
+    }
+
+    Variable definition = {0};
+    long offset = 0;
+    int status = findVariableRecord(view, tagFields[0], &offset, &definition);
+    if (status != READSAVE_OK)
+    {
+        free(buffer);
+        return status;
+    }
+
+    ArrayView arrayView = {0};
+    long tagOffset = 0;
+    // Structure arrays: reduce the tag over every element
+    long nElements = definition.isStructure ? definition.arrayInfo.nElements : 1;
+    for (long e = 0; e < nElements && status == READSAVE_OK; e++)
+    {
+        tagOffset = offset;
+        status = findTagView(view->bytes, view->nBytes, &tagOffset, &definition, tagFields + 1, nTagFields - 1, &arrayView);
+        if (status == READSAVE_OK)
+            status = accumulateArrayStats(&arrayView, stats, nThreads);
+        if (definition.isStructure)
+            skipStructure(view->bytes, view->nBytes, &offset, &definition);
+    }
+
+    finishArrayStats(stats);
+
+    freeVariable(&definition);
+    free(buffer);
+
+    return status;
+}
@@ -0,0 +1,195 @@
+/*
+
+    ReadSave: savestrings.c
+
+    Copyright (C) 2022  Johnathan K Burchill
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "savestrings.h"
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+static __thread StringPool *activePool = NULL;
+
+static uint64_t hashString(const char *str, long length)
+{
+    // FNV-1a
+    uint64_t hash = 0xcbf29ce484222325UL;
+    for (long i = 0; i < length; i++)
+    {
+        hash ^= (unsigned char)str[i];
+        hash *= 0x100000001b3UL;
+    }
+
+    return hash;
+}
+
+StringPool *newStringPool(void)
+{
+    StringPool *pool = calloc(1, sizeof(StringPool));
+    if (pool == NULL)
+        return NULL;
+
+    pool->slots = calloc(STRING_POOL_INITIAL_SLOTS, sizeof(char*));
+    if (pool->slots == NULL)
+    {
+        free(pool);
+        return NULL;
+    }
+    pool->nSlots = STRING_POOL_INITIAL_SLOTS;
+    pthread_mutex_init(&pool->mutex, NULL);
+
+    return pool;
+}
+
+void freeStringPool(StringPool *pool)
+{
+    if (pool == NULL)
+        return;
+
+    StringPoolBlock *block = pool->blocks;
+    StringPoolBlock *next = NULL;
+    while (block != NULL)
+    {
+        next = block->next;
+        free(block);
+        block = next;
+    }
+    free(pool->slots);
+    pthread_mutex_destroy(&pool->mutex);
+    free(pool);
+
+    return;
+}
+
+// Open addressing; nSlots is a power of two
+static char **findSlot(char **slots, long nSlots, const char *str, long length)
+{
+    long slot = hashString(str, length) & (nSlots - 1);
+    while (slots[slot] != NULL && (strncmp(slots[slot], str, length) != 0 || slots[slot][length] != '\0'))
+        slot = (slot + 1) & (nSlots - 1);
+
+    return &slots[slot];
+}
+
+static int growSlots(StringPool *pool)
+{
+    long nSlots = 2 * pool->nSlots;
+    char **slots = calloc(nSlots, sizeof(char*));
+    if (slots == NULL)
+        return -1;
+
+    for (long i = 0; i < pool->nSlots; i++)
+        if (pool->slots[i] != NULL)
+            *findSlot(slots, nSlots, pool->slots[i], strlen(pool->slots[i])) = pool->slots[i];
+
+    free(pool->slots);
+    pool->slots = slots;
+    pool->nSlots = nSlots;
+
+    return 0;
+}
+
+char *poolString(StringPool *pool, const char *str, long length)
+{
+    if (pool == NULL || str == NULL || length < 0)
+        return NULL;
+
+    // Stop at an embedded NUL like strndup()
+    length = strnlen(str, length);
+
+    pthread_mutex_lock(&pool->mutex);
+    char **slot = findSlot(pool->slots, pool->nSlots, str, length);
+    char *pooled = *slot;
+    if (pooled != NULL)
+    {
+        pthread_mutex_unlock(&pool->mutex);
+        return pooled;
+    }
+
+    StringPoolBlock *block = pool->blocks;
+    if (block == NULL || block->size - block->used < length + 1)
+    {
+        long size = length + 1 > STRING_POOL_BLOCK_SIZE ? length + 1 : STRING_POOL_BLOCK_SIZE;
+        block = malloc(sizeof(StringPoolBlock) + size);
+        if (block == NULL)
+        {
+            pthread_mutex_unlock(&pool->mutex);
+            return NULL;
+        }
+        block->size = size;
+        block->used = 0;
+        block->next = pool->blocks;
+        pool->blocks = block;
+    }
+
+    pooled = block->bytes + block->used;
+    memcpy(pooled, str, length);
+    pooled[length] = '\0';
+    block->used += length + 1;
+
+    *slot = pooled;
+    pool->nStrings++;
+    if (2 * pool->nStrings > pool->nSlots)
+        growSlots(pool);
+    pthread_mutex_unlock(&pool->mutex);
+
+    return pooled;
+}
+
+char *findPooledString(StringPool *pool, const char *str)
+{
+    if (pool == NULL || str == NULL)
+        return NULL;
+
+    return *findSlot(pool->slots, pool->nSlots, str, strlen(str));
+}
+
+StringPool *setActiveStringPool(StringPool *pool)
+{
+    StringPool *previous = activePool;
+    activePool = pool;
+
+    return previous;
+}
+
+StringPool *activeStringPool(void)
+{
+    return activePool;
+}
+
+char *newString(const char *str, long length)
+{
+    if (str == NULL)
+        return NULL;
+
+    if (activePool != NULL)
+        return poolString(activePool, str, length);
+
+    return strndup(str, length);
+}
+
+void freeString(char *str)
+{
+    if (str == NULL)
+        return;
+
+    free(str);
+
+    return;
+}
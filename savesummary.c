@@ -0,0 +1,192 @@
+/*
+
+    ReadSave: savesummary.c
+
+    Copyright (C) 2022  Johnathan K Burchill
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "savesummary.h"
+#include "savestats.h"
+#include "savestrings.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#define SUMMARY_PATH_LENGTH 4096
+
+static void printDims(ArrayInfo *info)
+{
+    fprintf(stdout, "array(");
+    for (int d = 0; d < info->nDims; d++)
+        fprintf(stdout, "%ld%s", info->dims[d], d < info->nDims - 1 ? "," : "");
+    fprintf(stdout, ")");
+
+    return;
+}
+
+static bool hasStats(Variable *var)
+{
+    switch (var->dataType)
+    {
+        case DataTypeString:
+        case DataTypeStructure:
+        case DataTypeComplexFloat:
+        case DataTypeComplexDouble:
+        case DataTypeHeapPointer:
+        case DataTypeObjectReference:
+        case DataTypeUndefined:
+            return false;
+        default:
+            return !var->isStructure;
+    }
+}
+
+static void printStats(SaveView *view, char *path, int nThreads)
+{
+    ArrayStats stats = {0};
+    int status = initArrayStats(&stats, 0, 0.0, 0.0);
+    if (status == READSAVE_OK)
+        status = variableStats(view, path, &stats, nThreads);
+    if (status == READSAVE_OK)
+        fprintf(stdout, " min %lg max %lg mean %lg NaN %ld", stats.min, stats.max, stats.mean, stats.nNaN);
+    else
+        fprintf(stdout, " (no statistics, status %d)", status);
+    freeArrayStats(&stats);
+
+    return;
+}
+
+// path holds the dotted name of the structure; tags are appended to it
+static void summarizeTags(SaveView *view, Variable *structure, char *path, int indent, bool tagStats, int nThreads)
+{
+    char typeName[255] = {0};
+    size_t pathLength = strlen(path);
+    Variable *tag = NULL;
+    for (int i = 0; i < structure->structInfo.nTags; i++)
+    {
+        tag = &((Variable*)structure->data)[i];
+        snprintf(path + pathLength, SUMMARY_PATH_LENGTH - pathLength, ".%s", tag->name);
+        fprintf(stdout, "%*s.%s", indent, "", tag->name);
+        if (tag->isStructure)
+        {
+            fprintf(stdout, " structure");
+            if ((tag->flags & VariableFlagsArray) != 0)
+            {
+                fprintf(stdout, " ");
+                printDims(&tag->arrayInfo);
+            }
+            fprintf(stdout, "\n");
+            summarizeTags(view, tag, path, indent + 2, tagStats, nThreads);
+            continue;
+        }
+        dataTypeName(tag->dataType, typeName);
+        fprintf(stdout, " %s", typeName);
+        if (tag->isArray)
+        {
+            fprintf(stdout, " ");
+            printDims(&tag->arrayInfo);
+        }
+        if (tagStats && hasStats(tag))
+            printStats(view, path, nThreads);
+        fprintf(stdout, "\n");
+    }
+    path[pathLength] = '\0';
+
+    return;
+}
+
+static void summarizeDefinition(SaveView *view, Variable *definition, bool tagStats, int nThreads)
+{
+    char typeName[255] = {0};
+    char path[SUMMARY_PATH_LENGTH] = {0};
+    snprintf(path, sizeof(path), "%s", definition->name);
+    if (definition->isStructure)
+    {
+        fprintf(stdout, "%s (structure ", definition->name);
+        printDims(&definition->arrayInfo);
+        fprintf(stdout, ", %ld tags)\n", definition->structInfo.nTags);
+        summarizeTags(view, definition, path, 2, tagStats, nThreads);
+        return;
+    }
+
+    dataTypeName(definition->dataType, typeName);
+    if (definition->isArray)
+    {
+        fprintf(stdout, "%s (%s ", definition->name, typeName);
+        printDims(&definition->arrayInfo);
+        fprintf(stdout, ")");
+        if (tagStats && hasStats(definition))
+            printStats(view, path, nThreads);
+        fprintf(stdout, "\n");
+    }
+    else
+        fprintf(stdout, "%s (%s scalar)\n", definition->name, typeName);
+
+    return;
+}
+
+int summarizeLayout(SaveView *view, char *variableName, bool tagStats, int nThreads)
+{
+    if (view == NULL || view->bytes == NULL)
+        return READSAVE_ARGUMENTS;
+
+    unsigned char *bytes = view->bytes;
+    long nBytes = view->nBytes;
+    long offset = 4;
+    long recordType = RecordTypeNotHandled;
+    long nextOffset = 0;
+    int status = READSAVE_OK;
+    bool found = false;
+    Variable definition = {0};
+    char *name = NULL;
+
+    while (status == READSAVE_OK && recordType != RecordTypeEndMarker && offset > 0 && offset < nBytes - 4)
+    {
+        readRecordHeader(bytes, nBytes, &offset, &recordType, &nextOffset);
+        if (!recordExtentValid(recordType, offset, nextOffset, nBytes))
+        {
+            status = READSAVE_CORRUPT_RECORD;
+            break;
+        }
+        if (recordType != RecordTypeVariable)
+        {
+            offset = nextOffset;
+            continue;
+        }
+
+        name = NULL;
+        status = readString(bytes, nextOffset, &offset, &name);
+        if (status == READSAVE_OK && (variableName == NULL || strcasecmp(name, variableName) == 0))
+        {
+            status = readVariableDefinition(bytes, nextOffset, &offset, &definition);
+            definition.name = name;
+            name = NULL;
+            if (status == READSAVE_OK)
+                summarizeDefinition(view, &definition, tagStats, nThreads);
+            freeVariable(&definition);
+            found = true;
+        }
+        freeString(name);
+        offset = nextOffset;
+    }
+
+    if (status == READSAVE_OK && variableName != NULL && !found)
+        status = READSAVE_VARIABLE_NOT_FOUND;
+
+    return status;
+}
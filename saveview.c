@@ -0,0 +1,381 @@
+/*
+
+    ReadSave: saveview.c
+
+    Copyright (C) 2022  Johnathan K Burchill
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "saveview.h"
+#include "readsave.h"
+#include "savestrings.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+int openSaveView(char *filename, SaveView *view)
+{
+    if (filename == NULL || view == NULL)
+        return READSAVE_ARGUMENTS;
+
+    bzero(view, sizeof(SaveView));
+
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+        return READSAVE_INPUT_FILE;
+
+    struct stat fileInfo = {0};
+    if (fstat(fd, &fileInfo) != 0 || fileInfo.st_size < 4)
+    {
+        close(fd);
+        return READSAVE_INPUT_FILE;
+    }
+
+    void *map = mmap(NULL, fileInfo.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED)
+    {
+        close(fd);
+        return READSAVE_MEM;
+    }
+
+    unsigned char *bytes = map;
+    if (bytes[0] != 'S' || bytes[1] != 'R')
+    {
+        munmap(map, fileInfo.st_size);
+        close(fd);
+        return READSAVE_INPUT_FILE;
+    }
+    if (bytes[2] != 0 || (bytes[3] != 4 && bytes[3] != 5))
+    {
+        munmap(map, fileInfo.st_size);
+        close(fd);
+        return READSAVE_FILE_VERSION;
+    }
+
+    view->fd = fd;
+    view->bytes = bytes;
+    view->nBytes = fileInfo.st_size;
+
+    return READSAVE_OK;
+}
+
+void closeSaveView(SaveView *view)
+{
+    if (view == NULL || view->bytes == NULL)
+        return;
+
+    munmap(view->bytes, view->nBytes);
+    close(view->fd);
+    bzero(view, sizeof(SaveView));
+
+    return;
+}
+
+// A structure definition describes one element; its arrayInfo.nElements
+// holds the number of elements in the variable.
+int findVariableRecord(SaveView *view, char *variableName, long *dataOffset, Variable *definition)
+{
+    if (view == NULL || view->bytes == NULL || variableName == NULL || dataOffset == NULL || definition == NULL)
+        return READSAVE_ARGUMENTS;
+
+    unsigned char *bytes = view->bytes;
+    long nBytes = view->nBytes;
+    long offset = 4;
+    long recordType = RecordTypeNotHandled;
+    long nextOffset = 0;
+    int status = READSAVE_OK;
+    char *name = NULL;
+
+    while (recordType != RecordTypeEndMarker && offset > 0 && offset < nBytes - 4)
+    {
+        readRecordHeader(bytes, nBytes, &offset, &recordType, &nextOffset);
+        if (!recordExtentValid(recordType, offset, nextOffset, nBytes))
+            return READSAVE_CORRUPT_RECORD;
+        if (recordType != RecordTypeVariable)
+        {
+            offset = nextOffset;
+            continue;
+        }
+
+        status = readString(bytes, nBytes, &offset, &name);
+        if (status != READSAVE_OK)
+            return status;
+        if (strcasecmp(name, variableName) != 0)
+        {
+            freeString(name);
+            offset = nextOffset;
+            continue;
+        }
+
+        status = readVariableDefinition(bytes, nextOffset, &offset, definition);
+        definition->name = name;
+        if (status != READSAVE_OK)
+        {
+            freeVariable(definition);
+            return status;
+        }
+
+        *dataOffset = offset;
+        return READSAVE_OK;
+    }
+
+    return READSAVE_VARIABLE_NOT_FOUND;
+}
+
+// Reads the type, array and structure descriptions that follow a variable's
+// name, leaving offset at the start of its data
+int readVariableDefinition(unsigned char *bytes, long nBytes, long *offset, Variable *definition)
+{
+    if (bytes == NULL || offset == NULL || definition == NULL)
+        return READSAVE_ARGUMENTS;
+
+    int status = READSAVE_OK;
+
+    bzero(definition, sizeof(Variable));
+    definition->dataType = readLong(bytes, nBytes, offset);
+    definition->flags = readLong(bytes, nBytes, offset);
+    definition->isArray = (definition->flags & VariableFlagsArray) != 0;
+    definition->isStructure = (definition->flags & VariableFlagsStructure) != 0;
+    definition->isScalar = !definition->isArray && !definition->isStructure;
+
+    if (definition->isArray || definition->isStructure)
+    {
+        status = initArray(bytes, nBytes, offset, definition);
+        if (status == READSAVE_OK && definition->isStructure)
+        {
+            status = initStructure(bytes, nBytes, offset, definition);
+            definition->isArray = false;
+        }
+        if (status != READSAVE_OK)
+            return status;
+    }
+
+    if (readLong(bytes, nBytes, offset) != 7)
+        return READSAVE_READ_VARIABLE;
+
+    return READSAVE_OK;
+}
+
+// Bytes occupied by one array element in the file
+long fileElementSize(long dataType)
+{
+    switch (dataType)
+    {
+        case DataTypeByte:
+            return 1;
+        case DataTypeInt16:
+        case DataTypeUInt16:
+            return 4;
+        default:
+            return dataTypeSize(dataType);
+    }
+}
+
+int findTagView(unsigned char *bytes, long nBytes, long *offset, Variable *definition, char **tagFields, int nTagFields, ArrayView *arrayView)
+{
+    if (bytes == NULL || offset == NULL || definition == NULL || arrayView == NULL)
+        return READSAVE_ARGUMENTS;
+
+    if (nTagFields == 0)
+    {
+        if (definition->isStructure || definition->dataType == DataTypeString || fileElementSize(definition->dataType) == 0)
+            return READSAVE_READ_ARRAY;
+
+        bzero(arrayView, sizeof(ArrayView));
+        // Byte data is preceded by its length
+        if (definition->dataType == DataTypeByte)
+            *offset += 4;
+        arrayView->bytes = bytes + *offset;
+        arrayView->dataType = definition->dataType;
+        arrayView->stride = fileElementSize(definition->dataType);
+        if (definition->isArray)
+        {
+            arrayView->nElements = definition->arrayInfo.nElements;
+            arrayView->nDims = definition->arrayInfo.nDims;
+            memcpy(arrayView->dims, definition->arrayInfo.dims, sizeof(arrayView->dims));
+        }
+        else
+            arrayView->nElements = 1;
+
+        if (*offset + arrayView->nElements * arrayView->stride > nBytes)
+            return READSAVE_READ_ARRAY;
+
+        return READSAVE_OK;
+    }
+
+    if (!definition->isStructure)
+        return READSAVE_VARIABLE_NOT_FOUND;
+
+    Variable *tag = NULL;
+    long nElements = 0;
+    for (int i = 0; i < definition->structInfo.nTags; i++)
+    {
+        tag = &((Variable*)definition->data)[i];
+        if (tag->name != NULL && strcmp(tag->name, tagFields[0]) == 0)
+            return findTagView(bytes, nBytes, offset, tag, tagFields + 1, nTagFields - 1, arrayView);
+
+        if (tag->isStructure)
+        {
+            nElements = (tag->flags & VariableFlagsArray) != 0 ? tag->arrayInfo.nElements : 1;
+            for (long e = 0; e < nElements; e++)
+                skipStructure(bytes, nBytes, offset, tag);
+        }
+        else if (tag->isArray)
+            skipArray(bytes, nBytes, offset, tag);
+        else
+            skipScalar(bytes, nBytes, offset, tag->dataType);
+    }
+
+    return READSAVE_VARIABLE_NOT_FOUND;
+}
+
+int findArrayView(SaveView *view, char *dottedName, long element, ArrayView *arrayView)
+{
+    if (view == NULL || dottedName == NULL || arrayView == NULL || element < 0)
+        return READSAVE_ARGUMENTS;
+
+    char *buffer = NULL;
+    char *tagFields[READSAVE_MAX_TAG_DEPTH] = {0};
+    int nTagFields = tagPath(dottedName, &buffer, tagFields, READSAVE_MAX_TAG_DEPTH);
+    if (nTagFields == 0)
+    {
+        free(buffer);
+        return READSAVE_ARGUMENTS;
+    }
+
+    Variable definition = {0};
+    long offset = 0;
+    int status = findVariableRecord(view, tagFields[0], &offset, &definition);
+    if (status != READSAVE_OK)
+    {
+        free(buffer);
+        return status;
+    }
+
+    if (definition.isStructure)
+    {
+        if (element >= definition.arrayInfo.nElements)
+            status = READSAVE_ARGUMENTS;
+        for (long e = 0; status == READSAVE_OK && e < element; e++)
+            skipStructure(view->bytes, view->nBytes, &offset, &definition);
+    }
+    else if (element != 0)
+        status = READSAVE_ARGUMENTS;
+
+    if (status == READSAVE_OK)
+        status = findTagView(view->bytes, view->nBytes, &offset, &definition, tagFields + 1, nTagFields - 1, arrayView);
+
+    freeVariable(&definition);
+    free(buffer);
+
+    return status;
+}
+
+int viewElement(ArrayView *view, long index, void *value)
+{
+    if (view == NULL || value == NULL || index < 0 || index >= view->nElements)
+        return READSAVE_ARGUMENTS;
+
+    return materializeRange(view, index, 1, value);
+}
+
+double viewValue(ArrayView *view, long index)
+{
+    if (view == NULL || index < 0 || index >= view->nElements)
+        return 0;
+
+    switch (view->dataType)
+    {
+        case DataTypeByte:
+            return viewByte(view, index);
+        case DataTypeInt16:
+            return viewInt16(view, index);
+        case DataTypeUInt16:
+            return viewUInt16(view, index);
+        case DataTypeInt32:
+            return viewInt32(view, index);
+        case DataTypeUInt32:
+            return viewUInt32(view, index);
+        case DataTypeInt64:
+            return viewInt64(view, index);
+        case DataTypeUInt64:
+            return viewUInt64(view, index);
+        case DataTypeFloat:
+        case DataTypeComplexFloat:
+            // Real part of complex values
+            return viewFloat(view, index);
+        case DataTypeDouble:
+        case DataTypeComplexDouble:
+            return viewDouble(view, index);
+        default:
+            return 0;
+    }
+}
+
+int materializeRange(ArrayView *view, long start, long count, void *values)
+{
+    if (view == NULL || values == NULL || start < 0 || count < 0 || start + count > view->nElements)
+        return READSAVE_ARGUMENTS;
+
+    ArrayView shifted = *view;
+    shifted.bytes = view->bytes + start * view->stride;
+
+    switch (view->dataType)
+    {
+        case DataTypeByte:
+            for (long i = 0; i < count; i++)
+                ((uint8_t*)values)[i] = viewByte(&shifted, i);
+            break;
+        case DataTypeInt16:
+        case DataTypeUInt16:
+            for (long i = 0; i < count; i++)
+                ((uint16_t*)values)[i] = viewUInt16(&shifted, i);
+            break;
+        case DataTypeInt32:
+        case DataTypeUInt32:
+        case DataTypeFloat:
+            for (long i = 0; i < count; i++)
+                ((uint32_t*)values)[i] = viewUInt32(&shifted, i);
+            break;
+        case DataTypeInt64:
+        case DataTypeUInt64:
+        case DataTypeDouble:
+            for (long i = 0; i < count; i++)
+                ((uint64_t*)values)[i] = viewUInt64(&shifted, i);
+            break;
+        case DataTypeComplexFloat:
+            // Each component is a big-endian 32-bit value
+            shifted.stride = 4;
+            for (long i = 0; i < 2 * count; i++)
+                ((uint32_t*)values)[i] = viewUInt32(&shifted, i);
+            break;
+        case DataTypeComplexDouble:
+            shifted.stride = 8;
+            for (long i = 0; i < 2 * count; i++)
+                ((uint64_t*)values)[i] = viewUInt64(&shifted, i);
+            break;
+        default:
+            return READSAVE_READ_ARRAY;
+    }
+
+    return READSAVE_OK;
+}
@@ -0,0 +1,452 @@
+/*
+
+    ReadSave: savevirtual.c
+
+    Copyright (C) 2022  Johnathan K Burchill
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#define _GNU_SOURCE
+
+#include "savevirtual.h"
+#include "savefile.h"
+#include "saveview.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <pthread.h>
+
+// Files handed out one at a time to a pool of threads
+typedef struct WorkQueue
+{
+    long next;
+    long nTasks;
+    pthread_mutex_t mutex;
+
+} WorkQueue;
+
+// Shape of the selected variable in one file
+typedef struct VirtualLayout
+{
+    int status;
+    long dataType;
+    long nBaseDims;
+    long baseDims[VIRTUAL_DATASET_MAX_DIMS];
+    long count;
+    // Tag names, types and dimensions of a structure, NULL for plain arrays
+    char *structureLayout;
+    size_t layoutSize;
+
+} VirtualLayout;
+
+typedef struct OpenWork
+{
+    WorkQueue queue;
+    char **files;
+    char **tagFields;
+    int nTagFields;
+    VirtualLayout *layouts;
+
+} OpenWork;
+
+typedef struct SliceWork
+{
+    WorkQueue queue;
+    VirtualDataset *dataset;
+    char **tagFields;
+    int nTagFields;
+    long start;
+    long count;
+    unsigned char *values;
+    long firstFile;
+    int *statuses;
+
+} SliceWork;
+
+static long nextTask(WorkQueue *queue)
+{
+    pthread_mutex_lock(&queue->mutex);
+    long task = queue->next < queue->nTasks ? queue->next++ : -1;
+    pthread_mutex_unlock(&queue->mutex);
+
+    return task;
+}
+
+// The calling thread works too
+static void runWorkers(void *(*worker)(void*), WorkQueue *queue, int nThreads)
+{
+    pthread_mutex_init(&queue->mutex, NULL);
+    if (nThreads > queue->nTasks)
+        nThreads = queue->nTasks;
+    if (nThreads < 1)
+        nThreads = 1;
+    pthread_t threads[nThreads];
+    bool started[nThreads];
+    for (int t = 0; t < nThreads - 1; t++)
+        started[t] = pthread_create(&threads[t], NULL, worker, queue) == 0;
+    worker(queue);
+    for (int t = 0; t < nThreads - 1; t++)
+        if (started[t])
+            pthread_join(threads[t], NULL);
+    pthread_mutex_destroy(&queue->mutex);
+
+    return;
+}
+
+static void writeStructureLayout(FILE *out, Variable *structure)
+{
+    Variable *tag = NULL;
+    for (long i = 0; i < structure->structInfo.nTags; i++)
+    {
+        tag = &((Variable*)structure->data)[i];
+        fprintf(out, "%s:%ld", tag->name != NULL ? tag->name : "", tag->isStructure ? (long)DataTypeStructure : tag->dataType);
+        if (tag->isArray || (tag->flags & VariableFlagsArray) != 0)
+            for (long d = 0; d < tag->arrayInfo.nDims; d++)
+                fprintf(out, "%c%ld", d == 0 ? '[' : ',', tag->arrayInfo.dims[d]);
+        if (tag->isStructure)
+        {
+            fprintf(out, "{");
+            writeStructureLayout(out, tag);
+            fprintf(out, "}");
+        }
+        fprintf(out, ";");
+    }
+
+    return;
+}
+
+static int variableLayout(Variable *definition, char **tagFields, int nTagFields, VirtualLayout *layout)
+{
+    Variable *var = definition;
+    if (!definition->isStructure)
+    {
+        if (nTagFields != 1)
+            return READSAVE_VARIABLE_NOT_FOUND;
+        layout->count = 1;
+        if (definition->isArray)
+        {
+            layout->nBaseDims = definition->arrayInfo.nDims - 1;
+            for (long d = 0; d < layout->nBaseDims; d++)
+                layout->baseDims[d] = definition->arrayInfo.dims[d];
+            layout->count = definition->arrayInfo.dims[layout->nBaseDims];
+        }
+    }
+    else
+    {
+        // Tags inside structure arrays would need an index per level
+        Variable *tag = NULL;
+        for (int depth = 1; depth < nTagFields; depth++)
+        {
+            if (!var->isStructure || (depth > 1 && (var->flags & VariableFlagsArray) != 0))
+                return READSAVE_ARGUMENTS;
+            tag = NULL;
+            for (long i = 0; i < var->structInfo.nTags; i++)
+                if (((Variable*)var->data)[i].name != NULL && strcmp(((Variable*)var->data)[i].name, tagFields[depth]) == 0)
+                    tag = &((Variable*)var->data)[i];
+            if (tag == NULL)
+                return READSAVE_VARIABLE_NOT_FOUND;
+            var = tag;
+        }
+        if (var->isStructure)
+            return READSAVE_ARGUMENTS;
+        layout->count = definition->arrayInfo.nElements;
+        if (var->isArray)
+        {
+            layout->nBaseDims = var->arrayInfo.nDims;
+            if (layout->nBaseDims >= VIRTUAL_DATASET_MAX_DIMS)
+                return READSAVE_ARGUMENTS;
+            for (long d = 0; d < layout->nBaseDims; d++)
+                layout->baseDims[d] = var->arrayInfo.dims[d];
+        }
+        FILE *out = open_memstream(&layout->structureLayout, &layout->layoutSize);
+        if (out == NULL)
+            return READSAVE_MEM;
+        writeStructureLayout(out, definition);
+        if (fclose(out) != 0)
+            return READSAVE_MEM;
+    }
+
+    layout->dataType = var->dataType;
+    if (var->dataType == DataTypeString || dataTypeSize(var->dataType) == 0 || layout->count < 1)
+        return READSAVE_ARGUMENTS;
+
+    return READSAVE_OK;
+}
+
+static void *openThread(void *arg)
+{
+    OpenWork *work = (OpenWork*)arg;
+    long f = 0;
+    ReadSaveFile file = {0};
+    SaveFileRecord *record = NULL;
+    while ((f = nextTask(&work->queue)) >= 0)
+    {
+        work->layouts[f].status = openReadSaveFile(work->files[f], &file);
+        if (work->layouts[f].status != READSAVE_OK)
+            continue;
+        record = findSaveFileRecord(&file, work->tagFields[0]);
+        if (record == NULL)
+            work->layouts[f].status = READSAVE_VARIABLE_NOT_FOUND;
+        else
+            work->layouts[f].status = variableLayout(&record->definition, work->tagFields, work->nTagFields, &work->layouts[f]);
+        closeReadSaveFile(&file);
+    }
+
+    return NULL;
+}
+
+static bool compatibleLayouts(VirtualLayout *first, VirtualLayout *layout)
+{
+    if (layout->dataType != first->dataType || layout->nBaseDims != first->nBaseDims)
+        return false;
+    for (long d = 0; d < first->nBaseDims; d++)
+        if (layout->baseDims[d] != first->baseDims[d])
+            return false;
+    if ((first->structureLayout == NULL) != (layout->structureLayout == NULL))
+        return false;
+
+    return first->structureLayout == NULL || strcmp(first->structureLayout, layout->structureLayout) == 0;
+}
+
+int openVirtualDataset(char **files, long nFiles, char *dottedName, int nThreads, VirtualDataset *dataset)
+{
+    if (files == NULL || nFiles < 1 || dottedName == NULL || dataset == NULL)
+        return READSAVE_ARGUMENTS;
+
+    bzero(dataset, sizeof(VirtualDataset));
+    dataset->failedFile = -1;
+
+    char *buffer = NULL;
+    char *tagFields[READSAVE_MAX_TAG_DEPTH] = {0};
+    int nTagFields = tagPath(dottedName, &buffer, tagFields, READSAVE_MAX_TAG_DEPTH);
+    if (nTagFields == 0)
+    {
+        free(buffer);
+        return READSAVE_ARGUMENTS;
+    }
+
+    OpenWork work = {0};
+    work.queue.nTasks = nFiles;
+    work.files = files;
+    work.tagFields = tagFields;
+    work.nTagFields = nTagFields;
+    work.layouts = calloc(nFiles, sizeof(VirtualLayout));
+    dataset->variableName = strdup(dottedName);
+    dataset->files = calloc(nFiles, sizeof(VirtualFile));
+    if (work.layouts == NULL || dataset->variableName == NULL || dataset->files == NULL)
+    {
+        free(work.layouts);
+        free(buffer);
+        closeVirtualDataset(dataset);
+        return READSAVE_MEM;
+    }
+    runWorkers(openThread, &work.queue, nThreads);
+
+    // Files are concatenated in the order given
+    int status = READSAVE_OK;
+    VirtualLayout *first = &work.layouts[0];
+    long nElementsPerStep = 1;
+    for (long d = 0; d < first->nBaseDims; d++)
+        nElementsPerStep *= first->baseDims[d];
+    long nSteps = 0;
+    for (long f = 0; status == READSAVE_OK && f < nFiles; f++)
+    {
+        status = work.layouts[f].status;
+        if (status == READSAVE_OK && !compatibleLayouts(first, &work.layouts[f]))
+            status = READSAVE_ARGUMENTS;
+        if (status != READSAVE_OK)
+        {
+            dataset->failedFile = f;
+            break;
+        }
+        dataset->files[f].path = strdup(files[f]);
+        if (dataset->files[f].path == NULL)
+            status = READSAVE_MEM;
+        dataset->files[f].first = nSteps * nElementsPerStep;
+        dataset->files[f].nElements = work.layouts[f].count * nElementsPerStep;
+        dataset->nFiles++;
+        nSteps += work.layouts[f].count;
+    }
+
+    if (status == READSAVE_OK)
+    {
+        dataset->dataType = first->dataType;
+        dataset->isStructureTag = first->structureLayout != NULL;
+        dataset->nDims = first->nBaseDims + 1;
+        for (long d = 0; d < first->nBaseDims; d++)
+            dataset->dims[d] = first->baseDims[d];
+        dataset->dims[first->nBaseDims] = nSteps;
+        dataset->nElementsPerStep = nElementsPerStep;
+        dataset->nElements = nSteps * nElementsPerStep;
+    }
+
+    for (long f = 0; f < nFiles; f++)
+        free(work.layouts[f].structureLayout);
+    free(work.layouts);
+    free(buffer);
+    if (status != READSAVE_OK)
+    {
+        long failedFile = dataset->failedFile;
+        closeVirtualDataset(dataset);
+        dataset->failedFile = failedFile;
+    }
+
+    return status;
+}
+
+void closeVirtualDataset(VirtualDataset *dataset)
+{
+    if (dataset == NULL)
+        return;
+
+    for (long f = 0; f < dataset->nFiles; f++)
+        free(dataset->files[f].path);
+    free(dataset->files);
+    free(dataset->variableName);
+    bzero(dataset, sizeof(VirtualDataset));
+    dataset->failedFile = -1;
+
+    return;
+}
+
+// Decodes values [start, start + count) of one file, counted from the file's first value
+static int readFileRange(SliceWork *work, VirtualFile *file, long start, long count, unsigned char *values)
+{
+    SaveView view = {0};
+    int status = openSaveView(file->path, &view);
+    if (status != READSAVE_OK)
+        return status;
+
+    VirtualDataset *dataset = work->dataset;
+    ArrayView arrayView = {0};
+    if (!dataset->isStructureTag)
+    {
+        status = findArrayView(&view, dataset->variableName, 0, &arrayView);
+        // The file may have changed since the dataset was opened
+        if (status == READSAVE_OK && (arrayView.dataType != dataset->dataType || arrayView.nElements != file->nElements))
+            status = READSAVE_ARGUMENTS;
+        if (status == READSAVE_OK)
+            status = materializeRange(&arrayView, start, count, values);
+        closeSaveView(&view);
+        return status;
+    }
+
+    Variable definition = {0};
+    long offset = 0;
+    status = findVariableRecord(&view, work->tagFields[0], &offset, &definition);
+    long nPerStep = dataset->nElementsPerStep;
+    long end = start + count;
+    long firstElement = start / nPerStep;
+    long lastElement = (end - 1) / nPerStep;
+    if (status == READSAVE_OK && (!definition.isStructure || definition.arrayInfo.nElements * nPerStep != file->nElements))
+        status = READSAVE_ARGUMENTS;
+    for (long e = 0; status == READSAVE_OK && e < firstElement; e++)
+        if (skipStructure(view.bytes, view.nBytes, &offset, &definition) > view.nBytes)
+            status = READSAVE_READ_STRUCTURE;
+
+    long tagOffset = 0;
+    long from = 0;
+    long to = 0;
+    long elementSize = dataTypeSize(dataset->dataType);
+    for (long e = firstElement; status == READSAVE_OK && e <= lastElement; e++)
+    {
+        tagOffset = offset;
+        status = findTagView(view.bytes, view.nBytes, &tagOffset, &definition, work->tagFields + 1, work->nTagFields - 1, &arrayView);
+        if (status == READSAVE_OK && (arrayView.dataType != dataset->dataType || arrayView.nElements != nPerStep))
+            status = READSAVE_ARGUMENTS;
+        from = (start > e * nPerStep ? start : e * nPerStep) - e * nPerStep;
+        to = (end < (e + 1) * nPerStep ? end : (e + 1) * nPerStep) - e * nPerStep;
+        if (status == READSAVE_OK)
+            status = materializeRange(&arrayView, from, to - from, values + (e * nPerStep + from - start) * elementSize);
+        if (status == READSAVE_OK && skipStructure(view.bytes, view.nBytes, &offset, &definition) > view.nBytes)
+            status = READSAVE_READ_STRUCTURE;
+    }
+
+    freeVariable(&definition);
+    closeSaveView(&view);
+
+    return status;
+}
+
+static void *sliceThread(void *arg)
+{
+    SliceWork *work = (SliceWork*)arg;
+    long task = 0;
+    VirtualFile *file = NULL;
+    long first = 0;
+    long last = 0;
+    long elementSize = dataTypeSize(work->dataset->dataType);
+    while ((task = nextTask(&work->queue)) >= 0)
+    {
+        file = &work->dataset->files[work->firstFile + task];
+        first = work->start > file->first ? work->start : file->first;
+        last = work->start + work->count < file->first + file->nElements ? work->start + work->count : file->first + file->nElements;
+        work->statuses[task] = readFileRange(work, file, first - file->first, last - first, work->values + (first - work->start) * elementSize);
+    }
+
+    return NULL;
+}
+
+int readVirtualSlice(VirtualDataset *dataset, long start, long count, void *values, int nThreads)
+{
+    if (dataset == NULL || dataset->files == NULL || values == NULL || start < 0 || count < 0 || start + count > dataset->nElements)
+        return READSAVE_ARGUMENTS;
+    if (count == 0)
+        return READSAVE_OK;
+
+    // Files overlapping the range, found by bisection
+    long low = 0;
+    long high = dataset->nFiles - 1;
+    long middle = 0;
+    while (low < high)
+    {
+        middle = low + (high - low + 1) / 2;
+        if (dataset->files[middle].first <= start)
+            low = middle;
+        else
+            high = middle - 1;
+    }
+    long lastFile = low;
+    while (lastFile + 1 < dataset->nFiles && dataset->files[lastFile + 1].first < start + count)
+        lastFile++;
+
+    SliceWork work = {0};
+    work.queue.nTasks = lastFile - low + 1;
+    work.dataset = dataset;
+    work.start = start;
+    work.count = count;
+    work.values = values;
+    work.firstFile = low;
+    work.statuses = calloc(work.queue.nTasks, sizeof(int));
+    if (work.statuses == NULL)
+        return READSAVE_MEM;
+    char *buffer = NULL;
+    char *tagFields[READSAVE_MAX_TAG_DEPTH] = {0};
+    work.tagFields = tagFields;
+    work.nTagFields = tagPath(dataset->variableName, &buffer, work.tagFields, READSAVE_MAX_TAG_DEPTH);
+
+    int status = work.nTagFields > 0 ? READSAVE_OK : READSAVE_ARGUMENTS;
+    if (status == READSAVE_OK)
+        runWorkers(sliceThread, &work.queue, nThreads);
+    for (long t = 0; status == READSAVE_OK && t < work.queue.nTasks; t++)
+        status = work.statuses[t];
+
+    free(work.statuses);
+    free(buffer);
+
+    return status;
+}
@@ -0,0 +1,853 @@
+/*
+
+    ReadSave: savewriter.c
+
+    Copyright (C) 2022  Johnathan K Burchill
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#define _GNU_SOURCE
+
+#include "savewriter.h"
+#include "readsave.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/sendfile.h>
+#include <sys/utsname.h>
+
+#define ARRAY_DESCRIPTOR_SIZE (16 * 4)
+#define RECORD_HEADER_SIZE (4 * 4)
+#define IDL_STRING_SIZE 16
+#define IDL_RELEASE "8.0"
+
+static void emit(SaveWriter *writer, const void *data, size_t n)
+{
+    if (writer->status != READSAVE_OK || n == 0)
+        return;
+
+    if (fwrite(data, 1, n, writer->file) != n)
+    {
+        writer->status = READSAVE_INPUT_FILE;
+        return;
+    }
+    writer->offset += n;
+
+    return;
+}
+
+static void emitULong(SaveWriter *writer, uint32_t value)
+{
+    uint32_t bigEndian = __builtin_bswap32(value);
+    emit(writer, &bigEndian, sizeof(bigEndian));
+
+    return;
+}
+
+static void emitLong(SaveWriter *writer, int32_t value)
+{
+    emitULong(writer, (uint32_t)value);
+
+    return;
+}
+
+static void emitPadding(SaveWriter *writer, long nBytes)
+{
+    static const unsigned char zeros[4] = {0};
+    emit(writer, zeros, (4 - nBytes % 4) % 4);
+
+    return;
+}
+
+static long paddedSize(long nBytes)
+{
+    return 4 * ((nBytes + 3) / 4);
+}
+
+static long stringSize(char *str)
+{
+    return 4 + paddedSize(str == NULL ? 0 : strlen(str));
+}
+
+static void emitString(SaveWriter *writer, char *str)
+{
+    long length = str == NULL ? 0 : strlen(str);
+    emitLong(writer, (int32_t)length);
+    emit(writer, str, length);
+    emitPadding(writer, length);
+
+    return;
+}
+
+static void emitRecordHeader(SaveWriter *writer, long recordType, long nextOffset)
+{
+    emitLong(writer, (int32_t)recordType);
+    emitULong(writer, (uint32_t)(nextOffset & 0xffffffffL));
+    emitULong(writer, (uint32_t)(nextOffset >> 32));
+    emitLong(writer, 0);
+
+    return;
+}
+
+// Tags left out of a projection are left out of the written structure
+static long writtenTagCount(Variable *def)
+{
+    long nTags = 0;
+    for (int i = 0; i < def->structInfo.nTags; i++)
+        if (!((Variable*)def->data)[i].skipped)
+            nTags++;
+
+    return nTags;
+}
+
+static bool writableTag(Variable *tag)
+{
+    if (tag->isStructure)
+    {
+        if (tag->data == NULL || writtenTagCount(tag) == 0)
+            return false;
+        for (int i = 0; i < tag->structInfo.nTags; i++)
+            if (!((Variable*)tag->data)[i].skipped && !writableTag(&((Variable*)tag->data)[i]))
+                return false;
+        return true;
+    }
+
+    if (tag->dataType != DataTypeString && dataTypeSize(tag->dataType) == 0)
+        return false;
+    // Save files hold arrays in IDL order
+    if (tag->rowMajor)
+        return false;
+
+    return tag->data != NULL;
+}
+
+// Structure variables hold an array of elements, each holding its tags
+static bool writableVariable(Variable *var)
+{
+    if (var->isStructure)
+        return var->data != NULL && var->arrayInfo.nElements > 0 && writableTag(&((Variable*)var->data)[0]);
+
+    return writableTag(var);
+}
+
+static long flagsOf(Variable *var)
+{
+    if (var->isStructure)
+        return VariableFlagsStructure | VariableFlagsUnknown | VariableFlagsArray;
+    if (var->isArray)
+        return VariableFlagsArray | VariableFlagsUnknown;
+
+    return 0;
+}
+
+static long memorySize(Variable *var);
+
+static long structureMemorySize(Variable *def)
+{
+    long size = 0;
+    long tagSize = 0;
+    long alignment = 0;
+    Variable *tag = NULL;
+    for (int i = 0; i < def->structInfo.nTags; i++)
+    {
+        tag = &((Variable*)def->data)[i];
+        if (tag->skipped)
+            continue;
+        tagSize = memorySize(tag);
+        alignment = tag->isStructure ? 8 : (tag->dataType == DataTypeString ? 8 : dataTypeSize(tag->dataType));
+        if (alignment > 8)
+            alignment = 8;
+        if (alignment > 0)
+            size = alignment * ((size + alignment - 1) / alignment);
+        size += tagSize;
+    }
+
+    return 8 * ((size + 7) / 8);
+}
+
+static long memorySize(Variable *var)
+{
+    long elementSize = 0;
+    if (var->isStructure)
+        elementSize = structureMemorySize(var);
+    else if (var->dataType == DataTypeString)
+        elementSize = IDL_STRING_SIZE;
+    else
+        elementSize = dataTypeSize(var->dataType);
+
+    return var->isArray && !var->isStructure ? var->arrayInfo.nElements * elementSize : elementSize;
+}
+
+// readSave() names anonymous structures
+static char *structureName(Variable *def)
+{
+    char *name = def->structInfo.structureName;
+    if (name != NULL && strcmp(name, "<anomymous structure>") == 0)
+        return NULL;
+
+    return name;
+}
+
+static long structureDescriptorSize(Variable *def)
+{
+    long size = 4 + stringSize(structureName(def)) + 3 * 4 + writtenTagCount(def) * 3 * 4;
+
+    Variable *tag = NULL;
+    for (int i = 0; i < def->structInfo.nTags; i++)
+    {
+        tag = &((Variable*)def->data)[i];
+        if (tag->skipped)
+            continue;
+        size += stringSize(tag->name);
+        if (tag->isArray || tag->isStructure)
+            size += ARRAY_DESCRIPTOR_SIZE;
+        if (tag->isStructure)
+            size += structureDescriptorSize(tag);
+    }
+
+    return size;
+}
+
+static long scalarDataSize(long dataType, void *data)
+{
+    long length = 0;
+    switch (dataType)
+    {
+        case DataTypeByte:
+            return 8;
+        case DataTypeString:
+            length = data == NULL ? 0 : strlen((char*)data);
+            return length > 0 ? 8 + paddedSize(length) : 4;
+        case DataTypeInt16:
+        case DataTypeUInt16:
+            return 4;
+        default:
+            return dataTypeSize(dataType);
+    }
+}
+
+static long arrayDataSize(Variable *var)
+{
+    long nElements = var->arrayInfo.nElements;
+    long size = 0;
+    switch (var->dataType)
+    {
+        case DataTypeString:
+            for (long i = 0; i < nElements; i++)
+                size += scalarDataSize(DataTypeString, stringArrayElement(var, i));
+            return size;
+        case DataTypeByte:
+            return 4 + paddedSize(nElements);
+        case DataTypeInt16:
+        case DataTypeUInt16:
+            return 4 * nElements;
+        default:
+            return nElements * dataTypeSize(var->dataType);
+    }
+}
+
+static long structureDataSize(Variable *element)
+{
+    long size = 0;
+    Variable *tag = NULL;
+    for (int i = 0; i < element->structInfo.nTags; i++)
+    {
+        tag = &((Variable*)element->data)[i];
+        if (tag->skipped)
+            continue;
+        if (tag->isStructure)
+            size += structureDataSize(tag);
+        else if (tag->isArray)
+            size += arrayDataSize(tag);
+        else
+            size += scalarDataSize(tag->dataType, tag->data);
+    }
+
+    return size;
+}
+
+long variableRecordSize(Variable *var)
+{
+    if (var == NULL)
+        return 0;
+
+    long size = RECORD_HEADER_SIZE + stringSize(var->name) + 2 * 4;
+    if (var->isStructure)
+    {
+        Variable *elements = (Variable*)var->data;
+        size += ARRAY_DESCRIPTOR_SIZE + structureDescriptorSize(&elements[0]);
+        size += 4;
+        for (long e = 0; e < var->arrayInfo.nElements; e++)
+            size += structureDataSize(&elements[e]);
+    }
+    else if (var->isArray)
+        size += ARRAY_DESCRIPTOR_SIZE + 4 + arrayDataSize(var);
+    else
+        size += 4 + scalarDataSize(var->dataType, var->data);
+
+    return size;
+}
+
+static long elementSize(long dataType)
+{
+    return dataType == DataTypeString ? IDL_STRING_SIZE : dataTypeSize(dataType);
+}
+
+static void emitArrayDescriptor(SaveWriter *writer, long nBytesPerElement, long nElements, long nDims, long *dims)
+{
+    emitLong(writer, 8);
+    emitLong(writer, (int32_t)nBytesPerElement);
+    emitLong(writer, (int32_t)(nBytesPerElement * nElements));
+    emitLong(writer, (int32_t)nElements);
+    emitLong(writer, (int32_t)(nDims > 0 ? nDims : 1));
+    emitLong(writer, 0);
+    emitLong(writer, 0);
+    emitLong(writer, 8);
+    for (int d = 0; d < 8; d++)
+    {
+        if (nDims > 0)
+            emitLong(writer, (int32_t)(d < nDims ? dims[d] : 1));
+        else
+            emitLong(writer, (int32_t)(d == 0 ? nElements : 1));
+    }
+
+    return;
+}
+
+static void emitStructureDescriptor(SaveWriter *writer, Variable *def)
+{
+    emitLong(writer, 9);
+    emitString(writer, structureName(def));
+    emitLong(writer, 0);
+    emitLong(writer, (int32_t)writtenTagCount(def));
+    emitLong(writer, (int32_t)structureMemorySize(def));
+
+    Variable *tag = NULL;
+    long tagOffset = 0;
+    long alignment = 0;
+    for (int i = 0; i < def->structInfo.nTags; i++)
+    {
+        tag = &((Variable*)def->data)[i];
+        if (tag->skipped)
+            continue;
+        alignment = tag->isStructure || tag->dataType == DataTypeString ? 8 : dataTypeSize(tag->dataType);
+        if (alignment > 8)
+            alignment = 8;
+        if (alignment > 0)
+            tagOffset = alignment * ((tagOffset + alignment - 1) / alignment);
+        emitLong(writer, (int32_t)tagOffset);
+        emitLong(writer, (int32_t)(tag->isStructure ? DataTypeStructure : tag->dataType));
+        emitLong(writer, (int32_t)(tag->isStructure ? VariableFlagsStructure | VariableFlagsArray : flagsOf(tag)));
+        tagOffset += memorySize(tag);
+    }
+
+    for (int i = 0; i < def->structInfo.nTags; i++)
+        if (!((Variable*)def->data)[i].skipped)
+            emitString(writer, ((Variable*)def->data)[i].name);
+
+    for (int i = 0; i < def->structInfo.nTags; i++)
+    {
+        tag = &((Variable*)def->data)[i];
+        if (tag->skipped)
+            continue;
+        if (tag->isStructure)
+            emitArrayDescriptor(writer, structureMemorySize(tag), 1, 0, NULL);
+        else if (tag->isArray)
+            emitArrayDescriptor(writer, elementSize(tag->dataType), tag->arrayInfo.nElements, tag->arrayInfo.nDims, tag->arrayInfo.dims);
+    }
+
+    for (int i = 0; i < def->structInfo.nTags; i++)
+    {
+        tag = &((Variable*)def->data)[i];
+        if (tag->isStructure && !tag->skipped)
+            emitStructureDescriptor(writer, tag);
+    }
+
+    return;
+}
+
+static void emitScalarData(SaveWriter *writer, long dataType, void *data)
+{
+    long length = 0;
+    switch (dataType)
+    {
+        case DataTypeByte:
+            emitLong(writer, 1);
+            emit(writer, data, 1);
+            emitPadding(writer, 1);
+            break;
+        case DataTypeString:
+            length = data == NULL ? 0 : strlen((char*)data);
+            emitLong(writer, (int32_t)length);
+            if (length > 0)
+                emitString(writer, (char*)data);
+            break;
+        case DataTypeInt16:
+            emitLong(writer, *(int16_t*)data);
+            break;
+        case DataTypeUInt16:
+            emitULong(writer, *(uint16_t*)data);
+            break;
+        case DataTypeInt32:
+        case DataTypeUInt32:
+        case DataTypeFloat:
+            emitULong(writer, *(uint32_t*)data);
+            break;
+        case DataTypeComplexFloat:
+            emitULong(writer, ((uint32_t*)data)[0]);
+            emitULong(writer, ((uint32_t*)data)[1]);
+            break;
+        case DataTypeInt64:
+        case DataTypeUInt64:
+        case DataTypeDouble:
+        case DataTypeComplexDouble:
+            for (long i = 0; i < dataTypeSize(dataType) / 8; i++)
+            {
+                uint64_t bigEndian = __builtin_bswap64(((uint64_t*)data)[i]);
+                emit(writer, &bigEndian, sizeof(bigEndian));
+            }
+            break;
+        default:
+            break;
+    }
+
+    return;
+}
+
+// Native to big-endian in SAVEWRITER_BLOCK_SIZE blocks; each inner loop is
+// a plain swap over contiguous words that the compiler vectorizes.
+static void emitArrayData(SaveWriter *writer, Variable *var)
+{
+    long nElements = var->arrayInfo.nElements;
+    long nWords = 0;
+    long n = 0;
+    uint32_t *block32 = (uint32_t*)writer->block;
+    uint64_t *block64 = (uint64_t*)writer->block;
+    long perBlock32 = SAVEWRITER_BLOCK_SIZE / sizeof(uint32_t);
+    long perBlock64 = SAVEWRITER_BLOCK_SIZE / sizeof(uint64_t);
+
+    switch (var->dataType)
+    {
+        case DataTypeString:
+            for (long i = 0; i < nElements; i++)
+                emitScalarData(writer, DataTypeString, stringArrayElement(var, i));
+            break;
+
+        case DataTypeByte:
+            emitLong(writer, (int32_t)nElements);
+            emit(writer, var->data, nElements);
+            emitPadding(writer, nElements);
+            break;
+
+        case DataTypeInt16:
+            for (long i = 0; i < nElements; i += perBlock32)
+            {
+                n = nElements - i < perBlock32 ? nElements - i : perBlock32;
+                int16_t *src = (int16_t*)var->data + i;
+                for (long k = 0; k < n; k++)
+                    block32[k] = __builtin_bswap32((uint32_t)(int32_t)src[k]);
+                emit(writer, block32, n * sizeof(uint32_t));
+            }
+            break;
+
+        case DataTypeUInt16:
+            for (long i = 0; i < nElements; i += perBlock32)
+            {
+                n = nElements - i < perBlock32 ? nElements - i : perBlock32;
+                uint16_t *src = (uint16_t*)var->data + i;
+                for (long k = 0; k < n; k++)
+                    block32[k] = __builtin_bswap32((uint32_t)src[k]);
+                emit(writer, block32, n * sizeof(uint32_t));
+            }
+            break;
+
+        case DataTypeInt32:
+        case DataTypeUInt32:
+        case DataTypeFloat:
+        case DataTypeComplexFloat:
+            // Complex values are pairs of 32-bit words
+            nWords = nElements * dataTypeSize(var->dataType) / sizeof(uint32_t);
+            for (long i = 0; i < nWords; i += perBlock32)
+            {
+                n = nWords - i < perBlock32 ? nWords - i : perBlock32;
+                uint32_t *src = (uint32_t*)var->data + i;
+                for (long k = 0; k < n; k++)
+                    block32[k] = __builtin_bswap32(src[k]);
+                emit(writer, block32, n * sizeof(uint32_t));
+            }
+            break;
+
+        case DataTypeInt64:
+        case DataTypeUInt64:
+        case DataTypeDouble:
+        case DataTypeComplexDouble:
+            nWords = nElements * dataTypeSize(var->dataType) / sizeof(uint64_t);
+            for (long i = 0; i < nWords; i += perBlock64)
+            {
+                n = nWords - i < perBlock64 ? nWords - i : perBlock64;
+                uint64_t *src = (uint64_t*)var->data + i;
+                for (long k = 0; k < n; k++)
+                    block64[k] = __builtin_bswap64(src[k]);
+                emit(writer, block64, n * sizeof(uint64_t));
+            }
+            break;
+
+        default:
+            break;
+    }
+
+    return;
+}
+
+static void emitStructureData(SaveWriter *writer, Variable *element)
+{
+    Variable *tag = NULL;
+    for (int i = 0; i < element->structInfo.nTags; i++)
+    {
+        tag = &((Variable*)element->data)[i];
+        if (tag->skipped)
+            continue;
+        if (tag->isStructure)
+            emitStructureData(writer, tag);
+        else if (tag->isArray)
+            emitArrayData(writer, tag);
+        else
+            emitScalarData(writer, tag->dataType, tag->data);
+    }
+
+    return;
+}
+
+int writeSaveOpen(char *filename, SaveWriter *writer)
+{
+    if (filename == NULL || writer == NULL)
+        return READSAVE_ARGUMENTS;
+
+    bzero(writer, sizeof(SaveWriter));
+
+    writer->block = malloc(SAVEWRITER_BLOCK_SIZE);
+    writer->fileBuffer = malloc(SAVEWRITER_FILE_BUFFER_SIZE);
+    if (writer->block == NULL || writer->fileBuffer == NULL)
+    {
+        free(writer->block);
+        free(writer->fileBuffer);
+        return READSAVE_MEM;
+    }
+
+    writer->file = fopen(filename, "w");
+    if (writer->file == NULL)
+    {
+        free(writer->block);
+        free(writer->fileBuffer);
+        return READSAVE_INPUT_FILE;
+    }
+    setvbuf(writer->file, writer->fileBuffer, _IOFBF, SAVEWRITER_FILE_BUFFER_SIZE);
+
+    emit(writer, "SR\0\4", 4);
+
+    // Timestamp: 256 unused longs, then date, user and host
+    char date[64] = {0};
+    time_t now = time(NULL);
+    ctime_r(&now, date);
+    date[strcspn(date, "\n")] = '\0';
+    char *user = getenv("USER");
+    if (user == NULL)
+        user = "unknown";
+    char host[256] = {0};
+    if (gethostname(host, sizeof(host) - 1) != 0)
+        strcpy(host, "unknown");
+
+    long recordSize = RECORD_HEADER_SIZE + 4 * 256 + stringSize(date) + stringSize(user) + stringSize(host);
+    emitRecordHeader(writer, RecordTypeTimestamp, writer->offset + recordSize);
+    for (int i = 0; i < 256; i++)
+        emitLong(writer, 0);
+    emitString(writer, date);
+    emitString(writer, user);
+    emitString(writer, host);
+
+    struct utsname system = {0};
+    uname(&system);
+    char *os = strcasecmp(system.sysname, "Linux") == 0 ? "linux" : system.sysname;
+    recordSize = RECORD_HEADER_SIZE + 4 + stringSize(system.machine) + stringSize(os) + stringSize(IDL_RELEASE);
+    emitRecordHeader(writer, RecordTypeVersion, writer->offset + recordSize);
+    emitLong(writer, SAVEWRITER_FORMAT_VERSION);
+    emitString(writer, system.machine);
+    emitString(writer, os);
+    emitString(writer, IDL_RELEASE);
+
+    return writer->status;
+}
+
+int writeVariable(SaveWriter *writer, Variable *var)
+{
+    if (writer == NULL || writer->file == NULL || var == NULL || var->name == NULL)
+        return READSAVE_ARGUMENTS;
+    if (writer->status != READSAVE_OK)
+        return writer->status;
+    if (!writableVariable(var))
+        return READSAVE_ARGUMENTS;
+
+    // The next-record offset is known before any data is written
+    long recordStart = writer->offset;
+    long nextOffset = recordStart + variableRecordSize(var);
+
+    emitRecordHeader(writer, RecordTypeVariable, nextOffset);
+    emitString(writer, var->name);
+    emitLong(writer, (int32_t)(var->isStructure ? DataTypeStructure : var->dataType));
+    emitLong(writer, (int32_t)flagsOf(var));
+
+    if (var->isStructure)
+    {
+        Variable *elements = (Variable*)var->data;
+        emitArrayDescriptor(writer, structureMemorySize(&elements[0]), var->arrayInfo.nElements, var->arrayInfo.nDims, var->arrayInfo.dims);
+        emitStructureDescriptor(writer, &elements[0]);
+        emitLong(writer, 7);
+        for (long e = 0; e < var->arrayInfo.nElements; e++)
+            emitStructureData(writer, &elements[e]);
+    }
+    else if (var->isArray)
+    {
+        emitArrayDescriptor(writer, elementSize(var->dataType), var->arrayInfo.nElements, var->arrayInfo.nDims, var->arrayInfo.dims);
+        emitLong(writer, 7);
+        emitArrayData(writer, var);
+    }
+    else
+    {
+        emitLong(writer, 7);
+        emitScalarData(writer, var->dataType, var->data);
+    }
+
+    if (writer->status == READSAVE_OK && writer->offset != nextOffset)
+        writer->status = READSAVE_READ_VARIABLE;
+
+    return writer->status;
+}
+
+int writeSaveClose(SaveWriter *writer)
+{
+    if (writer == NULL || writer->file == NULL)
+        return READSAVE_ARGUMENTS;
+
+    emitRecordHeader(writer, RecordTypeEndMarker, 0);
+
+    if (fclose(writer->file) != 0 && writer->status == READSAVE_OK)
+        writer->status = READSAVE_INPUT_FILE;
+    writer->file = NULL;
+    free(writer->block);
+    free(writer->fileBuffer);
+    writer->block = NULL;
+    writer->fileBuffer = NULL;
+
+    return writer->status;
+}
+
+static int writeAll(int fd, const void *data, size_t n)
+{
+    const unsigned char *p = data;
+    ssize_t nWritten = 0;
+    while (n > 0)
+    {
+        nWritten = write(fd, p, n);
+        if (nWritten < 0 && errno == EINTR)
+            continue;
+        if (nWritten <= 0)
+            return READSAVE_INPUT_FILE;
+        p += nWritten;
+        n -= nWritten;
+    }
+
+    return READSAVE_OK;
+}
+
+// Kernel-side copy: copy_file_range(), then sendfile(), then read/write
+static int copyRange(int inFd, long inOffset, int outFd, long nBytes)
+{
+    loff_t offset = inOffset;
+    ssize_t n = 0;
+    bool useCopyFileRange = true;
+    bool useSendfile = true;
+
+    while (nBytes > 0)
+    {
+        if (useCopyFileRange)
+        {
+            n = copy_file_range(inFd, &offset, outFd, NULL, nBytes, 0);
+            if (n < 0 && (errno == EXDEV || errno == EINVAL || errno == ENOSYS || errno == EOPNOTSUPP))
+            {
+                useCopyFileRange = false;
+                continue;
+            }
+        }
+        else if (useSendfile)
+        {
+            off_t sendOffset = offset;
+            n = sendfile(outFd, inFd, &sendOffset, nBytes);
+            if (n < 0 && (errno == EINVAL || errno == ENOSYS))
+            {
+                useSendfile = false;
+                continue;
+            }
+            if (n > 0)
+                offset = sendOffset;
+        }
+        else
+        {
+            unsigned char buffer[SAVEWRITER_BLOCK_SIZE];
+            n = pread(inFd, buffer, nBytes < SAVEWRITER_BLOCK_SIZE ? nBytes : SAVEWRITER_BLOCK_SIZE, offset);
+            if (n > 0 && writeAll(outFd, buffer, n) != READSAVE_OK)
+                return READSAVE_INPUT_FILE;
+            if (n > 0)
+                offset += n;
+        }
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return READSAVE_INPUT_FILE;
+        nBytes -= n;
+    }
+
+    return READSAVE_OK;
+}
+
+static bool selectedRecord(int fd, long offset, long recordType, char **variableNames, int nVariableNames)
+{
+    switch (recordType)
+    {
+        case RecordTypeTimestamp:
+        case RecordTypeVersion:
+        case RecordTypePromote64:
+        // Pointers in the selected variables refer to heap variables by index
+        case RecordTypeHeapHeader:
+        case RecordTypeHeapData:
+            return true;
+        case RecordTypeVariable:
+            break;
+        default:
+            return false;
+    }
+
+    if (variableNames == NULL || nVariableNames == 0)
+        return true;
+
+    uint32_t length = 0;
+    if (pread(fd, &length, 4, offset + 16) != 4)
+        return false;
+    length = __builtin_bswap32(length);
+    char name[256] = {0};
+    if (length == 0 || length >= sizeof(name) || pread(fd, name, length, offset + 20) != length)
+        return false;
+
+    for (int i = 0; i < nVariableNames; i++)
+        if (strcasecmp(name, variableNames[i]) == 0)
+            return true;
+
+    return false;
+}
+
+// Copies the selected variable records byte for byte, rewriting only the
+// next-record offsets. Nothing is decoded.
+int extractSaveRecords(char *inputFile, char *outputFile, char **variableNames, int nVariableNames, long *nCopied)
+{
+    if (inputFile == NULL || outputFile == NULL || (variableNames == NULL && nVariableNames > 0))
+        return READSAVE_ARGUMENTS;
+
+    int inFd = open(inputFile, O_RDONLY);
+    if (inFd < 0)
+        return READSAVE_INPUT_FILE;
+
+    struct stat fileInfo = {0};
+    unsigned char signature[4] = {0};
+    if (fstat(inFd, &fileInfo) != 0 || pread(inFd, signature, 4, 0) != 4 || signature[0] != 'S' || signature[1] != 'R')
+    {
+        close(inFd);
+        return READSAVE_INPUT_FILE;
+    }
+    if (signature[2] != 0 || (signature[3] != 4 && signature[3] != 5))
+    {
+        close(inFd);
+        return READSAVE_FILE_VERSION;
+    }
+
+    int outFd = open(outputFile, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (outFd < 0)
+    {
+        close(inFd);
+        return READSAVE_INPUT_FILE;
+    }
+
+    int status = writeAll(outFd, signature, 4);
+    long outOffset = 4;
+    long offset = 4;
+    long copied = 0;
+    uint32_t header[4] = {0};
+    long recordType = RecordTypeNotHandled;
+    long nextOffset = 0;
+    long recordSize = 0;
+    while (status == READSAVE_OK && recordType != RecordTypeEndMarker && offset + 16 <= fileInfo.st_size)
+    {
+        if (pread(inFd, header, 16, offset) != 16)
+        {
+            status = READSAVE_INPUT_FILE;
+            break;
+        }
+        recordType = __builtin_bswap32(header[0]);
+        nextOffset = (long)__builtin_bswap32(header[1]) + ((long)__builtin_bswap32(header[2]) << 32);
+        if (recordType == RecordTypeEndMarker)
+            break;
+        if (nextOffset <= offset || nextOffset > fileInfo.st_size)
+        {
+            status = READSAVE_INPUT_FILE;
+            break;
+        }
+        recordSize = nextOffset - offset;
+
+        if (selectedRecord(inFd, offset, recordType, variableNames, nVariableNames))
+        {
+            header[1] = __builtin_bswap32((uint32_t)((outOffset + recordSize) & 0xffffffffL));
+            header[2] = __builtin_bswap32((uint32_t)((outOffset + recordSize) >> 32));
+            status = writeAll(outFd, header, 16);
+            if (status == READSAVE_OK)
+                status = copyRange(inFd, offset + 16, outFd, recordSize - 16);
+            outOffset += recordSize;
+            if (recordType == RecordTypeVariable)
+                copied++;
+        }
+        offset = nextOffset;
+    }
+
+    if (status == READSAVE_OK)
+    {
+        uint32_t endMarker[4] = {__builtin_bswap32(RecordTypeEndMarker), 0, 0, 0};
+        status = writeAll(outFd, endMarker, 16);
+    }
+
+    if (close(outFd) != 0 && status == READSAVE_OK)
+        status = READSAVE_INPUT_FILE;
+    close(inFd);
+
+    if (nCopied != NULL)
+        *nCopied = copied;
+
+    return status;
+}
@@ -0,0 +1,1708 @@
+/*
+
+    ReadSave: tests/roundtrip.c
+
+    Copyright (C) 2022  Johnathan K Burchill
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+// Writes one value of each data type with savewriter.c, reads it back with
+// readSave() and compares: as a scalar variable, from inline storage, as a
+// tag of a structure array and as an array, and transposed to C order.
+// Heap pointers, object references and undefined values cannot be written,
+// so their type codes are patched into a written file before it is read.
+// Files written the same way check projections, predicates, conversion,
+// the cache, hashing, decimation, virtual datasets and damaged files.
+
+#include "readsave.h"
+#include "savewriter.h"
+#include "savecache.h"
+#include "savehash.h"
+#include "saveview.h"
+#include "savedecimate.h"
+#include "savevirtual.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#define N_ELEMENTS 3
+#define N_ARRAY 5
+
+static int nFailures = 0;
+
+#define CHECK(condition, ...) \
+    do \
+    { \
+        if (!(condition)) \
+        { \
+            fprintf(stderr, "%s:%d: ", __FILE__, __LINE__); \
+            fprintf(stderr, __VA_ARGS__); \
+            fprintf(stderr, "\n"); \
+            nFailures++; \
+        } \
+    } while (0)
+
+typedef struct TypedValue
+{
+    char *name;
+    long dataType;
+    // Native value of element 0; element e adds e to the first component
+    unsigned char value[16];
+    long nBytes;
+
+} TypedValue;
+
+static uint8_t valueByte = 200;
+static int16_t valueInt16 = -12345;
+static int32_t valueInt32 = -2000000001;
+static float valueFloat = 3.5f;
+static double valueDouble = -2.25e100;
+static float valueComplexFloat[2] = {1.5f, -2.5f};
+static double valueComplexDouble[2] = {2.5, -2.25};
+static uint16_t valueUInt16 = 65000;
+static uint32_t valueUInt32 = 4000000001U;
+static int64_t valueInt64 = -9000000000000000001LL;
+static uint64_t valueUInt64 = 18000000000000000001ULL;
+
+#define NUMERIC_VALUE(variableName, type, value) {variableName, type, {0}, sizeof(value)}
+
+static TypedValue numericValues[] = {
+    NUMERIC_VALUE("B", DataTypeByte, valueByte),
+    NUMERIC_VALUE("I16", DataTypeInt16, valueInt16),
+    NUMERIC_VALUE("I32", DataTypeInt32, valueInt32),
+    NUMERIC_VALUE("F", DataTypeFloat, valueFloat),
+    NUMERIC_VALUE("D", DataTypeDouble, valueDouble),
+    NUMERIC_VALUE("CF", DataTypeComplexFloat, valueComplexFloat),
+    NUMERIC_VALUE("CD", DataTypeComplexDouble, valueComplexDouble),
+    NUMERIC_VALUE("U16", DataTypeUInt16, valueUInt16),
+    NUMERIC_VALUE("U32", DataTypeUInt32, valueUInt32),
+    NUMERIC_VALUE("I64", DataTypeInt64, valueInt64),
+    NUMERIC_VALUE("U64", DataTypeUInt64, valueUInt64),
+};
+
+#define N_NUMERIC ((int)(sizeof(numericValues) / sizeof(numericValues[0])))
+
+static char *shortString = "short";
+static char *longString = "a string longer than the inline buffer";
+
+static void initValues(void)
+{
+    void *sources[N_NUMERIC] = {&valueByte, &valueInt16, &valueInt32, &valueFloat, &valueDouble, valueComplexFloat, valueComplexDouble, &valueUInt16, &valueUInt32, &valueInt64, &valueUInt64};
+    for (int i = 0; i < N_NUMERIC; i++)
+        memcpy(numericValues[i].value, sources[i], numericValues[i].nBytes);
+
+    return;
+}
+
+// Value of element e, with e added to the first component
+static void elementValue(TypedValue *typed, long e, unsigned char *value)
+{
+    memcpy(value, typed->value, typed->nBytes);
+    switch (typed->dataType)
+    {
+        case DataTypeByte:
+            *(uint8_t*)value += e;
+            break;
+        case DataTypeInt16:
+            *(int16_t*)value += e;
+            break;
+        case DataTypeUInt16:
+            *(uint16_t*)value += e;
+            break;
+        case DataTypeInt32:
+            *(int32_t*)value += e;
+            break;
+        case DataTypeUInt32:
+            *(uint32_t*)value += e;
+            break;
+        case DataTypeInt64:
+            *(int64_t*)value += e;
+            break;
+        case DataTypeUInt64:
+            *(uint64_t*)value += e;
+            break;
+        case DataTypeFloat:
+        case DataTypeComplexFloat:
+            *(float*)value += e;
+            break;
+        case DataTypeDouble:
+        case DataTypeComplexDouble:
+            *(double*)value += e;
+            break;
+        default:
+            break;
+    }
+
+    return;
+}
+
+static Variable scalarVariable(char *name, long dataType, void *data)
+{
+    Variable var = {0};
+    var.name = name;
+    var.dataType = dataType;
+    var.isScalar = true;
+    var.data = data;
+
+    return var;
+}
+
+static Variable *findByName(VariableList *variables, char *name)
+{
+    for (size_t i = 0; i < variables->nVariables; i++)
+        if (strcmp(variables->variableList[i].name, name) == 0)
+            return &variables->variableList[i];
+
+    return NULL;
+}
+
+static Variable *tagByName(Variable *element, char *name)
+{
+    for (long i = 0; i < element->structInfo.nTags; i++)
+        if (strcmp(((Variable*)element->data)[i].name, name) == 0)
+            return &((Variable*)element->data)[i];
+
+    return NULL;
+}
+
+static void checkScalar(Variable *var, char *name, long dataType, void *expected, long nBytes, bool inlined, char *where)
+{
+    CHECK(var != NULL, "%s %s: missing", where, name);
+    if (var == NULL)
+        return;
+    CHECK(var->dataType == dataType, "%s %s: data type %ld, expected %ld", where, name, var->dataType, dataType);
+    CHECK(!var->isArray && !var->isStructure, "%s %s: not a scalar", where, name);
+    CHECK(var->data != NULL, "%s %s: no data", where, name);
+    if (var->data == NULL)
+        return;
+    if (dataType == DataTypeString)
+        CHECK(strcmp((char*)var->data, (char*)expected) == 0, "%s %s: \"%s\", expected \"%s\"", where, name, (char*)var->data, (char*)expected);
+    else
+        CHECK(memcmp(var->data, expected, nBytes) == 0, "%s %s: value differs", where, name);
+    CHECK(var->hasInlineData == inlined, "%s %s: hasInlineData %d, expected %d", where, name, var->hasInlineData, inlined);
+    if (inlined)
+        CHECK(var->data == var->inlineData, "%s %s: data does not point to inline storage", where, name);
+
+    return;
+}
+
+static int writeTestFile(char *filename)
+{
+    SaveWriter writer = {0};
+    int status = writeSaveOpen(filename, &writer);
+    if (status != READSAVE_OK)
+        return status;
+
+    Variable var = {0};
+    for (int i = 0; i < N_NUMERIC && status == READSAVE_OK; i++)
+    {
+        var = scalarVariable(numericValues[i].name, numericValues[i].dataType, numericValues[i].value);
+        status = writeVariable(&writer, &var);
+    }
+    var = scalarVariable("SHORT", DataTypeString, shortString);
+    if (status == READSAVE_OK)
+        status = writeVariable(&writer, &var);
+    var = scalarVariable("LONG", DataTypeString, longString);
+    if (status == READSAVE_OK)
+        status = writeVariable(&writer, &var);
+    var = scalarVariable("EMPTY", DataTypeString, "");
+    if (status == READSAVE_OK)
+        status = writeVariable(&writer, &var);
+
+    // A structure array with a tag of each type and a nested structure
+    unsigned char values[N_ELEMENTS][N_NUMERIC][16] = {0};
+    Variable tags[N_ELEMENTS][N_NUMERIC + 3];
+    Variable nestedTags[N_ELEMENTS][2];
+    Variable elements[N_ELEMENTS];
+    bzero(tags, sizeof(tags));
+    bzero(nestedTags, sizeof(nestedTags));
+    bzero(elements, sizeof(elements));
+    for (long e = 0; e < N_ELEMENTS; e++)
+    {
+        for (int i = 0; i < N_NUMERIC; i++)
+        {
+            elementValue(&numericValues[i], e, values[e][i]);
+            tags[e][i] = scalarVariable(numericValues[i].name, numericValues[i].dataType, values[e][i]);
+        }
+        tags[e][N_NUMERIC] = scalarVariable("SHORT", DataTypeString, shortString);
+        tags[e][N_NUMERIC + 1] = scalarVariable("LONG", DataTypeString, longString);
+        nestedTags[e][0] = scalarVariable("I32", DataTypeInt32, values[e][2]);
+        nestedTags[e][1] = scalarVariable("CD", DataTypeComplexDouble, values[e][6]);
+        Variable *nested = &tags[e][N_NUMERIC + 2];
+        nested->name = "NESTED";
+        nested->isStructure = true;
+        nested->dataType = DataTypeStructure;
+        nested->structInfo.nTags = 2;
+        nested->data = nestedTags[e];
+        elements[e].isStructure = true;
+        elements[e].dataType = DataTypeStructure;
+        elements[e].structInfo.nTags = N_NUMERIC + 3;
+        elements[e].data = tags[e];
+    }
+    Variable structure = {0};
+    structure.name = "S";
+    structure.dataType = DataTypeStructure;
+    structure.isStructure = true;
+    structure.isArray = true;
+    structure.arrayInfo.nElements = N_ELEMENTS;
+    structure.arrayInfo.nDims = 1;
+    structure.arrayInfo.dims[0] = N_ELEMENTS;
+    structure.data = elements;
+    if (status == READSAVE_OK)
+        status = writeVariable(&writer, &structure);
+
+    int closeStatus = writeSaveClose(&writer);
+
+    return status != READSAVE_OK ? status : closeStatus;
+}
+
+static void checkTestFile(char *filename)
+{
+    SaveInfo info = {0};
+    VariableList variables = {0};
+    int status = readSave(filename, &info, &variables);
+    CHECK(status == READSAVE_OK, "readSave() status %d", status);
+
+    for (int i = 0; i < N_NUMERIC; i++)
+        checkScalar(findByName(&variables, numericValues[i].name), numericValues[i].name, numericValues[i].dataType, numericValues[i].value, numericValues[i].nBytes, true, "scalar");
+    checkScalar(findByName(&variables, "SHORT"), "SHORT", DataTypeString, shortString, 0, true, "scalar");
+    checkScalar(findByName(&variables, "LONG"), "LONG", DataTypeString, longString, 0, false, "scalar");
+    checkScalar(findByName(&variables, "EMPTY"), "EMPTY", DataTypeString, "", 0, true, "scalar");
+
+    Variable *structure = findByName(&variables, "S");
+    CHECK(structure != NULL && structure->isStructure && structure->arrayInfo.nElements == N_ELEMENTS, "structure S missing or wrong size");
+    unsigned char expected[16] = {0};
+    Variable *element = NULL;
+    Variable *nested = NULL;
+    for (long e = 0; structure != NULL && structure->data != NULL && e < structure->arrayInfo.nElements; e++)
+    {
+        element = &((Variable*)structure->data)[e];
+        for (int i = 0; i < N_NUMERIC; i++)
+        {
+            elementValue(&numericValues[i], e, expected);
+            checkScalar(tagByName(element, numericValues[i].name), numericValues[i].name, numericValues[i].dataType, expected, numericValues[i].nBytes, true, "tag");
+        }
+        checkScalar(tagByName(element, "SHORT"), "SHORT", DataTypeString, shortString, 0, true, "tag");
+        checkScalar(tagByName(element, "LONG"), "LONG", DataTypeString, longString, 0, false, "tag");
+        nested = tagByName(element, "NESTED");
+        CHECK(nested != NULL && nested->isStructure && nested->data != NULL, "tag NESTED missing");
+        if (nested == NULL || nested->data == NULL)
+            continue;
+        elementValue(&numericValues[2], e, expected);
+        checkScalar(tagByName(nested, "I32"), "I32", DataTypeInt32, expected, sizeof(int32_t), true, "nested tag");
+        elementValue(&numericValues[6], e, expected);
+        checkScalar(tagByName(nested, "CD"), "CD", DataTypeComplexDouble, expected, 2 * sizeof(double), true, "nested tag");
+    }
+
+    // Pooled names and strings are left to the pool, whichever pool is active
+    Variable *longVariable = findByName(&variables, "LONG");
+    CHECK(longVariable != NULL && longVariable->pooledStrings, "LONG: strings not marked as pooled");
+    freeVariable(longVariable);
+    if (structure != NULL && structure->data != NULL && structure->arrayInfo.nElements > 1)
+    {
+        CHECK(((Variable*)structure->data)[1].pooledStrings, "structure element: strings not marked as pooled");
+        freeVariable(&((Variable*)structure->data)[1]);
+    }
+    freeVariableList(&variables);
+    freeSaveInfo(&info);
+
+    return;
+}
+
+// A projected structure is written with only the tags that were read
+static void checkProjectedStructure(char *filename)
+{
+    char *tagPaths[2] = {"S.I32", "S.NESTED.CD"};
+    ReadSaveOptions options = {0};
+    options.tagPaths = tagPaths;
+    options.nTagPaths = 2;
+    SaveInfo info = {0};
+    VariableList variables = {0};
+    int status = readSaveWithOptions(filename, &options, &info, &variables);
+    CHECK(status == READSAVE_OK, "projection: readSave() status %d", status);
+    Variable *structure = findByName(&variables, "S");
+    CHECK(structure != NULL && structure->data != NULL, "projection: structure S missing");
+    if (structure == NULL || structure->data == NULL)
+    {
+        freeVariableList(&variables);
+        freeSaveInfo(&info);
+        return;
+    }
+
+    char projectedFile[] = "/tmp/readsave_projectedXXXXXX";
+    int fd = mkstemp(projectedFile);
+    CHECK(fd >= 0, "Unable to create a temporary file");
+    if (fd >= 0)
+        close(fd);
+    SaveWriter writer = {0};
+    CHECK(writeSaveOpen(projectedFile, &writer) == READSAVE_OK, "writeSaveOpen() failed");
+    CHECK(writeVariable(&writer, structure) == READSAVE_OK, "projection: writeVariable() refused the projected structure");
+    CHECK(writeSaveClose(&writer) == READSAVE_OK, "writeSaveClose() failed");
+    freeVariableList(&variables);
+    freeSaveInfo(&info);
+
+    bzero(&variables, sizeof(variables));
+    status = readSave(projectedFile, &info, &variables);
+    CHECK(status == READSAVE_OK, "projection: reading the written file, status %d", status);
+    structure = findByName(&variables, "S");
+    CHECK(structure != NULL && structure->data != NULL && structure->arrayInfo.nElements == N_ELEMENTS, "projection: written structure S missing");
+    unsigned char expected[16] = {0};
+    Variable *element = NULL;
+    Variable *nested = NULL;
+    for (long e = 0; structure != NULL && structure->data != NULL && e < structure->arrayInfo.nElements; e++)
+    {
+        element = &((Variable*)structure->data)[e];
+        CHECK(element->structInfo.nTags == 2, "projection: %ld tags written, expected 2", element->structInfo.nTags);
+        elementValue(&numericValues[2], e, expected);
+        checkScalar(tagByName(element, "I32"), "I32", DataTypeInt32, expected, sizeof(int32_t), true, "projected tag");
+        nested = tagByName(element, "NESTED");
+        CHECK(nested != NULL && nested->data != NULL && nested->structInfo.nTags == 1, "projection: nested structure not written with one tag");
+        if (nested == NULL || nested->data == NULL)
+            continue;
+        elementValue(&numericValues[6], e, expected);
+        checkScalar(tagByName(nested, "CD"), "CD", DataTypeComplexDouble, expected, 2 * sizeof(double), true, "projected nested tag");
+    }
+    freeVariableList(&variables);
+    freeSaveInfo(&info);
+    unlink(projectedFile);
+
+    return;
+}
+
+// Reads structure name with the predicates and checks which elements were
+// kept: their elementIndices, and their Int32 tag equal to base + step * index
+static void checkSelection(char *filename, ReadSaveOptions *options, char *name, long *expected, long nExpected, char *tagName, int32_t base, int32_t step, char *where)
+{
+    SaveInfo info = {0};
+    VariableList variables = {0};
+    int status = readSaveWithOptions(filename, options, &info, &variables);
+    CHECK(status == READSAVE_OK, "%s: readSaveWithOptions() status %d", where, status);
+    Variable *structure = findByName(&variables, name);
+    CHECK(structure != NULL && structure->arrayInfo.nElements == nExpected, "%s: %ld elements selected, expected %ld", where, structure != NULL ? structure->arrayInfo.nElements : -1, nExpected);
+    if (structure == NULL || structure->arrayInfo.nElements != nExpected)
+    {
+        freeVariableList(&variables);
+        freeSaveInfo(&info);
+        return;
+    }
+    CHECK(structure->elementIndices != NULL && (nExpected == 0 || structure->data != NULL), "%s: no element indices", where);
+    Variable *tag = NULL;
+    int32_t value = 0;
+    for (long i = 0; structure->elementIndices != NULL && structure->data != NULL && i < nExpected; i++)
+    {
+        CHECK(structure->elementIndices[i] == expected[i], "%s: element %ld has index %ld, expected %ld", where, i, structure->elementIndices[i], expected[i]);
+        tag = tagByName(&((Variable*)structure->data)[i], tagName);
+        value = base + step * (int32_t)expected[i];
+        checkScalar(tag, tagName, DataTypeInt32, &value, sizeof(int32_t), true, where);
+    }
+    freeVariableList(&variables);
+    freeSaveInfo(&info);
+
+    return;
+}
+
+// Numeric, nested and string predicates on the test file's structure, and
+// string predicates that tell elements apart
+static void checkPredicates(char *filename)
+{
+    ReadSaveOptions options = {0};
+    ReadSavePredicate predicates[2] = {0};
+    options.predicates = predicates;
+    options.nPredicates = 1;
+
+    long all[4] = {0, 1, 2, 3};
+    long last[2] = {1, 2};
+    long ends[2] = {0, 2};
+    long middle[1] = {1};
+    predicates[0] = (ReadSavePredicate){"S.I32", ReadSaveGreater, valueInt32, NULL};
+    checkSelection(filename, &options, "S", last, 2, "I32", valueInt32, 1, "S.I32 > first");
+    predicates[0] = (ReadSavePredicate){"S.NESTED.I32", ReadSaveGreaterEqual, valueInt32 + 1, NULL};
+    checkSelection(filename, &options, "S", last, 2, "I32", valueInt32, 1, "S.NESTED.I32 >= second");
+    predicates[0] = (ReadSavePredicate){"S.I32", ReadSaveGreater, 0, NULL};
+    checkSelection(filename, &options, "S", NULL, 0, "I32", valueInt32, 1, "S.I32 > 0");
+    predicates[0] = (ReadSavePredicate){"S.SHORT", ReadSaveEqual, 0, "short"};
+    checkSelection(filename, &options, "S", all, N_ELEMENTS, "I32", valueInt32, 1, "S.SHORT == short");
+    predicates[0] = (ReadSavePredicate){"S.SHORT", ReadSaveLess, 0, "shorter"};
+    checkSelection(filename, &options, "S", all, N_ELEMENTS, "I32", valueInt32, 1, "S.SHORT < shorter");
+    predicates[0] = (ReadSavePredicate){"S.LONG", ReadSaveEqual, 0, "a string"};
+    checkSelection(filename, &options, "S", NULL, 0, "I32", valueInt32, 1, "S.LONG == a string");
+
+    options.nPredicates = 2;
+    predicates[0] = (ReadSavePredicate){"S.I32", ReadSaveNotEqual, valueInt32 + 1, NULL};
+    predicates[1] = (ReadSavePredicate){"S.U16", ReadSaveLessEqual, valueUInt16 + 2, NULL};
+    checkSelection(filename, &options, "S", ends, 2, "I32", valueInt32, 1, "S.I32 != second and S.U16 <= third");
+
+    // The predicate tag need not be projected
+    char *tagPaths[1] = {"S.NESTED.I32"};
+    options.tagPaths = tagPaths;
+    options.nTagPaths = 1;
+    options.nPredicates = 1;
+    predicates[0] = (ReadSavePredicate){"S.U16", ReadSaveEqual, valueUInt16 + 1, NULL};
+    SaveInfo info = {0};
+    VariableList variables = {0};
+    int status = readSaveWithOptions(filename, &options, &info, &variables);
+    CHECK(status == READSAVE_OK, "projected predicate: status %d", status);
+    Variable *structure = findByName(&variables, "S");
+    CHECK(structure != NULL && structure->data != NULL && structure->arrayInfo.nElements == 1 && structure->elementIndices != NULL && structure->elementIndices[0] == 1, "projected predicate: element 1 not selected");
+    if (structure != NULL && structure->data != NULL && structure->arrayInfo.nElements == 1)
+    {
+        Variable *element = &((Variable*)structure->data)[0];
+        Variable *skipped = tagByName(element, "U16");
+        CHECK(skipped == NULL || skipped->skipped, "projected predicate: unprojected tag decoded");
+        Variable *nested = tagByName(element, "NESTED");
+        int32_t expected = valueInt32 + 1;
+        if (nested != NULL)
+            checkScalar(tagByName(nested, "I32"), "I32", DataTypeInt32, &expected, sizeof(int32_t), true, "projected predicate");
+    }
+    freeVariableList(&variables);
+    freeSaveInfo(&info);
+    options.tagPaths = NULL;
+    options.nTagPaths = 0;
+
+    // Predicates must name a scalar tag of the structure
+    char *badPaths[3] = {"S.NOPE", "S.NESTED", "S.NESTED.NOPE"};
+    for (int i = 0; i < 3; i++)
+    {
+        predicates[0] = (ReadSavePredicate){badPaths[i], ReadSaveEqual, 0, NULL};
+        bzero(&variables, sizeof(variables));
+        status = readSaveWithOptions(filename, &options, &info, &variables);
+        CHECK(status == READSAVE_ARGUMENTS, "predicate on %s: status %d", badPaths[i], status);
+        freeVariableList(&variables);
+        freeSaveInfo(&info);
+    }
+
+    // Predicates on other variables leave the structure whole
+    predicates[0] = (ReadSavePredicate){"T.I32", ReadSaveEqual, 0, NULL};
+    bzero(&variables, sizeof(variables));
+    CHECK(readSaveWithOptions(filename, &options, &info, &variables) == READSAVE_OK, "predicate on T: readSaveWithOptions() failed");
+    structure = findByName(&variables, "S");
+    CHECK(structure != NULL && structure->arrayInfo.nElements == N_ELEMENTS && structure->elementIndices == NULL, "predicate on T: S filtered");
+    freeVariableList(&variables);
+    freeSaveInfo(&info);
+
+    // Strings that differ between elements
+    char *names[4] = {"alpha", "beta", "", "alphabet"};
+    int32_t ids[4] = {0, 10, 20, 30};
+    Variable tags[4][2];
+    Variable elements[4];
+    bzero(elements, sizeof(elements));
+    for (int e = 0; e < 4; e++)
+    {
+        tags[e][0] = scalarVariable("ID", DataTypeInt32, &ids[e]);
+        tags[e][1] = scalarVariable("NAME", DataTypeString, names[e]);
+        elements[e].isStructure = true;
+        elements[e].dataType = DataTypeStructure;
+        elements[e].structInfo.nTags = 2;
+        elements[e].data = tags[e];
+    }
+    Variable named = {0};
+    named.name = "P";
+    named.dataType = DataTypeStructure;
+    named.isStructure = true;
+    named.isArray = true;
+    named.arrayInfo.nElements = 4;
+    named.arrayInfo.nDims = 1;
+    named.arrayInfo.dims[0] = 4;
+    named.data = elements;
+    char namedFile[] = "/tmp/readsave_predicatesXXXXXX";
+    int fd = mkstemp(namedFile);
+    CHECK(fd >= 0, "Unable to create a temporary file");
+    if (fd < 0)
+        return;
+    close(fd);
+    SaveWriter writer = {0};
+    CHECK(writeSaveOpen(namedFile, &writer) == READSAVE_OK, "writeSaveOpen() failed");
+    CHECK(writeVariable(&writer, &named) == READSAVE_OK, "writeVariable() failed");
+    CHECK(writeSaveClose(&writer) == READSAVE_OK, "writeSaveClose() failed");
+
+    long alpha[1] = {0};
+    long empty[1] = {2};
+    long after[2] = {1, 3};
+    long nonEmpty[3] = {0, 1, 3};
+    predicates[0] = (ReadSavePredicate){"P.NAME", ReadSaveEqual, 0, "alpha"};
+    checkSelection(namedFile, &options, "P", alpha, 1, "ID", 0, 10, "P.NAME == alpha");
+    predicates[0] = (ReadSavePredicate){"P.NAME", ReadSaveLess, 0, "alpha"};
+    checkSelection(namedFile, &options, "P", empty, 1, "ID", 0, 10, "P.NAME < alpha");
+    predicates[0] = (ReadSavePredicate){"P.NAME", ReadSaveGreater, 0, "alpha"};
+    checkSelection(namedFile, &options, "P", after, 2, "ID", 0, 10, "P.NAME > alpha");
+    predicates[0] = (ReadSavePredicate){"P.NAME", ReadSaveNotEqual, 0, ""};
+    checkSelection(namedFile, &options, "P", nonEmpty, 3, "ID", 0, 10, "P.NAME != empty");
+    predicates[0] = (ReadSavePredicate){"p.name", ReadSaveGreaterEqual, 0, "b"};
+    checkSelection(namedFile, &options, "P", middle, 1, "ID", 0, 10, "p.name >= b");
+    unlink(namedFile);
+
+    return;
+}
+
+#define N_LARGE (2 * READSAVE_STRUCTURE_ELEMENTS_PER_THREAD + 37)
+#define N_LIST 3
+#define LONG_LENGTH 300
+
+// String j of element e; j == N_LIST is the NAME tag. Empty, short and
+// long strings alternate.
+static void largeString(long e, int j, char *str)
+{
+    switch ((e + j) % 3)
+    {
+        case 0:
+            str[0] = '\0';
+            break;
+        case 1:
+            snprintf(str, LONG_LENGTH + 1, "s%ld.%d", e, j);
+            break;
+        default:
+            for (int k = 0; k < LONG_LENGTH; k++)
+                str[k] = 'a' + (e + j + k) % 26;
+            str[0] = '0' + e % 10;
+            str[LONG_LENGTH] = '\0';
+            break;
+    }
+
+    return;
+}
+
+// An array of strings in the layout readStringArray() makes: nStrings + 1
+// offsets into the text that follows them
+static void *stringArray(char strings[][LONG_LENGTH + 1], long nStrings)
+{
+    long textLength = 0;
+    for (long i = 0; i < nStrings; i++)
+        textLength += strlen(strings[i]) + 1;
+    long *offsets = malloc((nStrings + 1) * sizeof(long) + textLength);
+    if (offsets == NULL)
+        return NULL;
+    char *text = (char*)(offsets + nStrings + 1);
+    long offset = 0;
+    for (long i = 0; i < nStrings; i++)
+    {
+        offsets[i] = offset;
+        strcpy(text + offset, strings[i]);
+        offset += strlen(strings[i]) + 1;
+    }
+    offsets[nStrings] = offset;
+
+    return offsets;
+}
+
+// A structure array large enough to be decoded in parallel, with a string
+// tag and a string array tag per element
+static void checkLargeStringStructure(char *filename)
+{
+    int32_t *ids = calloc(N_LARGE, sizeof(int32_t));
+    char (*names)[LONG_LENGTH + 1] = calloc(N_LARGE, LONG_LENGTH + 1);
+    void **lists = calloc(N_LARGE, sizeof(void*));
+    Variable (*tags)[3] = calloc(N_LARGE, sizeof(*tags));
+    Variable *elements = calloc(N_LARGE, sizeof(Variable));
+    char strings[N_LIST][LONG_LENGTH + 1] = {0};
+    bool allocated = ids != NULL && names != NULL && lists != NULL && tags != NULL && elements != NULL;
+    CHECK(allocated, "large structure: out of memory");
+    for (long e = 0; allocated && e < N_LARGE; e++)
+    {
+        ids[e] = (int32_t)e;
+        largeString(e, N_LIST, names[e]);
+        for (int j = 0; j < N_LIST; j++)
+            largeString(e, j, strings[j]);
+        lists[e] = stringArray(strings, N_LIST);
+        tags[e][0] = scalarVariable("ID", DataTypeInt32, &ids[e]);
+        tags[e][1] = scalarVariable("NAME", DataTypeString, names[e]);
+        tags[e][2].name = "LIST";
+        tags[e][2].dataType = DataTypeString;
+        tags[e][2].isArray = true;
+        tags[e][2].arrayInfo.nElements = N_LIST;
+        tags[e][2].arrayInfo.nDims = 1;
+        tags[e][2].arrayInfo.dims[0] = N_LIST;
+        tags[e][2].data = lists[e];
+        elements[e].isStructure = true;
+        elements[e].dataType = DataTypeStructure;
+        elements[e].structInfo.nTags = 3;
+        elements[e].data = tags[e];
+        allocated = lists[e] != NULL;
+    }
+    Variable structure = {0};
+    structure.name = "LARGE";
+    structure.dataType = DataTypeStructure;
+    structure.isStructure = true;
+    structure.isArray = true;
+    structure.arrayInfo.nElements = N_LARGE;
+    structure.arrayInfo.nDims = 1;
+    structure.arrayInfo.dims[0] = N_LARGE;
+    structure.data = elements;
+    Variable after = scalarVariable("AFTER", DataTypeInt32, &valueInt32);
+    if (allocated)
+    {
+        SaveWriter writer = {0};
+        CHECK(writeSaveOpen(filename, &writer) == READSAVE_OK, "writeSaveOpen() failed");
+        CHECK(writeVariable(&writer, &structure) == READSAVE_OK, "large structure: writeVariable() failed");
+        CHECK(writeVariable(&writer, &after) == READSAVE_OK, "writeVariable() failed");
+        CHECK(writeSaveClose(&writer) == READSAVE_OK, "writeSaveClose() failed");
+    }
+
+    // Once on this thread, once split across threads
+    int threadCounts[2] = {1, 4};
+    for (int t = 0; allocated && t < 2; t++)
+    {
+        ReadSaveOptions options = {0};
+        options.nThreads = threadCounts[t];
+        SaveInfo info = {0};
+        VariableList variables = {0};
+        int status = readSaveWithOptions(filename, &options, &info, &variables);
+        CHECK(status == READSAVE_OK, "large structure, %d threads: status %d", threadCounts[t], status);
+        Variable *read = findByName(&variables, "LARGE");
+        CHECK(read != NULL && read->data != NULL && read->arrayInfo.nElements == N_LARGE, "large structure, %d threads: missing or wrong size", threadCounts[t]);
+        long nDiffering = 0;
+        Variable *element = NULL;
+        Variable *tag = NULL;
+        for (long e = 0; read != NULL && read->data != NULL && e < read->arrayInfo.nElements; e++)
+        {
+            element = &((Variable*)read->data)[e];
+            tag = tagByName(element, "ID");
+            if (tag == NULL || tag->data == NULL || *(int32_t*)tag->data != ids[e])
+                nDiffering++;
+            tag = tagByName(element, "NAME");
+            if (tag == NULL || tag->data == NULL || strcmp((char*)tag->data, names[e]) != 0)
+                nDiffering++;
+            tag = tagByName(element, "LIST");
+            if (tag == NULL || !tag->isArray || tag->arrayInfo.nElements != N_LIST)
+            {
+                nDiffering++;
+                continue;
+            }
+            for (int j = 0; j < N_LIST; j++)
+            {
+                largeString(e, j, strings[j]);
+                if (stringArrayElement(tag, j) == NULL || strcmp(stringArrayElement(tag, j), strings[j]) != 0)
+                    nDiffering++;
+            }
+        }
+        CHECK(nDiffering == 0, "large structure, %d threads: %ld values differ", threadCounts[t], nDiffering);
+        checkScalar(findByName(&variables, "AFTER"), "AFTER", DataTypeInt32, &valueInt32, sizeof(int32_t), true, "after the large structure");
+        freeVariableList(&variables);
+        freeSaveInfo(&info);
+    }
+
+    for (long e = 0; lists != NULL && e < N_LARGE; e++)
+        free(lists[e]);
+    free(lists);
+    free(ids);
+    free(names);
+    free(tags);
+    free(elements);
+
+    return;
+}
+
+// Each numeric type as a 1-D array of N_ARRAY values, element i adding i
+static void checkArrays(char *filename)
+{
+    unsigned char values[N_NUMERIC][N_ARRAY][16] = {0};
+    unsigned char packed[N_NUMERIC][N_ARRAY * 16];
+    char names[N_NUMERIC][16];
+    Variable var = {0};
+    SaveWriter writer = {0};
+    CHECK(writeSaveOpen(filename, &writer) == READSAVE_OK, "writeSaveOpen() failed");
+    for (int t = 0; t < N_NUMERIC; t++)
+    {
+        for (long i = 0; i < N_ARRAY; i++)
+        {
+            elementValue(&numericValues[t], i, values[t][i]);
+            memcpy(packed[t] + i * numericValues[t].nBytes, values[t][i], numericValues[t].nBytes);
+        }
+        snprintf(names[t], sizeof(names[t]), "A%s", numericValues[t].name);
+        bzero(&var, sizeof(var));
+        var.name = names[t];
+        var.dataType = numericValues[t].dataType;
+        var.isArray = true;
+        var.arrayInfo.nElements = N_ARRAY;
+        var.arrayInfo.nDims = 1;
+        var.arrayInfo.dims[0] = N_ARRAY;
+        var.data = packed[t];
+        CHECK(writeVariable(&writer, &var) == READSAVE_OK, "%s: writeVariable() failed", names[t]);
+    }
+    CHECK(writeSaveClose(&writer) == READSAVE_OK, "writeSaveClose() failed");
+
+    SaveInfo info = {0};
+    VariableList variables = {0};
+    int status = readSave(filename, &info, &variables);
+    CHECK(status == READSAVE_OK, "arrays: readSave() status %d", status);
+    Variable *read = NULL;
+    for (int t = 0; t < N_NUMERIC; t++)
+    {
+        read = findByName(&variables, names[t]);
+        CHECK(read != NULL && read->isArray && read->dataType == numericValues[t].dataType && read->arrayInfo.nElements == N_ARRAY && read->data != NULL, "array %s: missing or wrong shape", names[t]);
+        if (read == NULL || read->data == NULL)
+            continue;
+        for (long i = 0; i < N_ARRAY; i++)
+            CHECK(memcmp((unsigned char*)read->data + i * numericValues[t].nBytes, values[t][i], numericValues[t].nBytes) == 0, "array %s: element %ld differs", names[t], i);
+    }
+    freeVariableList(&variables);
+    freeSaveInfo(&info);
+
+    return;
+}
+
+typedef struct TransposeCase
+{
+    char *name;
+    long dataType;
+    long nDims;
+    long dims[4];
+
+} TransposeCase;
+
+// Dims that are not multiples of READSAVE_TRANSPOSE_TILE; T2 and T3 are
+// large enough to be split across threads
+static TransposeCase transposeCases[] = {
+    {"T2", DataTypeInt32, 2, {1531, 1409}},
+    {"T3", DataTypeFloat, 3, {37, 45, 1900}},
+    {"S2", DataTypeInt16, 2, {33, 70}},
+    {"C3", DataTypeComplexDouble, 3, {5, 34, 3}},
+    {"B4", DataTypeByte, 4, {3, 33, 5, 2}},
+};
+#define N_TRANSPOSE (long)(sizeof(transposeCases) / sizeof(transposeCases[0]))
+
+// Value of element i in IDL order
+static void transposeValue(long dataType, long i, unsigned char *value)
+{
+    switch (dataType)
+    {
+        case DataTypeInt32:
+            *(int32_t*)value = (int32_t)i;
+            break;
+        case DataTypeFloat:
+            *(float*)value = (float)i;
+            break;
+        case DataTypeInt16:
+            *(int16_t*)value = (int16_t)(7 * i - 1000);
+            break;
+        case DataTypeComplexDouble:
+            ((double*)value)[0] = (double)i;
+            ((double*)value)[1] = -(double)i;
+            break;
+        case DataTypeByte:
+            *value = (uint8_t)(i * 3);
+            break;
+        default:
+            break;
+    }
+
+    return;
+}
+
+static long transposeElementSize(long dataType)
+{
+    switch (dataType)
+    {
+        case DataTypeByte:
+            return 1;
+        case DataTypeInt16:
+            return 2;
+        case DataTypeComplexDouble:
+            return 16;
+        default:
+            return 4;
+    }
+}
+
+// Compares a converted array with hand-computed values
+static void checkConvertedArray(VariableList *variables, char *name, long fileDataType, long dataType, double *expected, long nExpected, bool rowMajor)
+{
+    Variable *var = findByName(variables, name);
+    long size = dataType == DataTypeFloat ? sizeof(float) : sizeof(double);
+    CHECK(var != NULL && var->data != NULL && var->arrayInfo.nElements == nExpected, "converted %s: missing or wrong size", name);
+    if (var == NULL || var->data == NULL || var->arrayInfo.nElements != nExpected)
+        return;
+    CHECK(var->dataType == dataType && var->fileDataType == fileDataType, "converted %s: type %ld from %ld", name, var->dataType, var->fileDataType);
+    CHECK(var->arrayInfo.nBytesPerElement == size && var->arrayInfo.nBytes == nExpected * size, "converted %s: %ld bytes per element", name, var->arrayInfo.nBytesPerElement);
+    CHECK(var->rowMajor == rowMajor, "converted %s: layout changed", name);
+    for (long i = 0; i < nExpected; i++)
+    {
+        double value = dataType == DataTypeFloat ? ((float*)var->data)[i] : ((double*)var->data)[i];
+        CHECK(value == expected[i], "converted %s[%ld]: %.10g, expected %.10g", name, i, value, expected[i]);
+    }
+
+    return;
+}
+
+static Variable arrayVariable(char *name, long dataType, void *data, long nDims, long *dims)
+{
+    Variable var = {0};
+    var.name = name;
+    var.dataType = dataType;
+    var.isArray = true;
+    var.arrayInfo.nElements = 1;
+    var.arrayInfo.nDims = nDims;
+    for (long d = 0; d < nDims; d++)
+    {
+        var.arrayInfo.dims[d] = dims[d];
+        var.arrayInfo.nElements *= dims[d];
+    }
+    var.data = data;
+
+    return var;
+}
+
+// Integer and double arrays converted to float or double while decoding
+static void checkConversion(char *filename)
+{
+    int16_t int16Values[6] = {-32768, -1, 0, 1, 32767, 12345};
+    uint16_t uint16Values[5] = {0, 1, 65535, 40000, 7};
+    double doubleValues[5] = {1.5, -2500, 1e10, 0.25, 1e-300};
+    // Dims 3 x 2, first dim fastest; read back with the last dim fastest
+    int16_t gridValues[6] = {0, 1, 2, 3, 4, 5};
+    float complexValues[4] = {1.5f, -2.5f, 3, 4};
+    long six[1] = {6};
+    long five[1] = {5};
+    long grid[2] = {3, 2};
+    long two[1] = {2};
+    Variable vars[5] = {
+        arrayVariable("I16", DataTypeInt16, int16Values, 1, six),
+        arrayVariable("U16", DataTypeUInt16, uint16Values, 1, five),
+        arrayVariable("D", DataTypeDouble, doubleValues, 1, five),
+        arrayVariable("GRID", DataTypeInt16, gridValues, 2, grid),
+        arrayVariable("CF", DataTypeComplexFloat, complexValues, 1, two),
+    };
+    SaveWriter writer = {0};
+    CHECK(writeSaveOpen(filename, &writer) == READSAVE_OK, "writeSaveOpen() failed");
+    for (int v = 0; v < 5; v++)
+        CHECK(writeVariable(&writer, &vars[v]) == READSAVE_OK, "%s: writeVariable() failed", vars[v].name);
+    CHECK(writeSaveClose(&writer) == READSAVE_OK, "writeSaveClose() failed");
+
+    // value * 0.5 - 3, worked out by hand; 1e-300 underflows to 0 in float
+    double int16Expected[6] = {-16387, -3.5, -3, -2.5, 16380.5, 6169.5};
+    double uint16Expected[5] = {-3, -2.5, 32764.5, 19997, 0.5};
+    double doubleFloatExpected[5] = {-2.25, -1253, 5e9, -2.875, -3};
+    double doubleExpected[5] = {-2.25, -1253, 4999999997, -2.875, -3};
+    double gridExpected[6] = {-3, -1.5, -2.5, -1, -2, -0.5};
+
+    long targets[2] = {DataTypeFloat, DataTypeDouble};
+    for (int t = 0; t < 2; t++)
+    {
+        ReadSaveOptions options = {0};
+        options.convertTo = targets[t];
+        options.scaleFactor = 0.5;
+        options.addOffset = -3;
+        options.rowMajor = true;
+        SaveInfo info = {0};
+        VariableList variables = {0};
+        int status = readSaveWithOptions(filename, &options, &info, &variables);
+        CHECK(status == READSAVE_OK, "conversion to %ld: status %d", targets[t], status);
+        checkConvertedArray(&variables, "I16", DataTypeInt16, targets[t], int16Expected, 6, false);
+        checkConvertedArray(&variables, "U16", DataTypeUInt16, targets[t], uint16Expected, 5, false);
+        checkConvertedArray(&variables, "D", DataTypeDouble, targets[t], targets[t] == DataTypeFloat ? doubleFloatExpected : doubleExpected, 5, false);
+        checkConvertedArray(&variables, "GRID", DataTypeInt16, targets[t], gridExpected, 6, true);
+        // Complex values are not converted
+        Variable *complex = findByName(&variables, "CF");
+        CHECK(complex != NULL && complex->data != NULL && complex->dataType == DataTypeComplexFloat && complex->fileDataType == DataTypeUndefined && memcmp(complex->data, complexValues, sizeof(complexValues)) == 0, "conversion to %ld: complex array changed", targets[t]);
+        freeVariableList(&variables);
+        freeSaveInfo(&info);
+    }
+
+    ReadSaveOptions options = {0};
+    options.convertTo = DataTypeInt32;
+    SaveInfo info = {0};
+    VariableList variables = {0};
+    CHECK(readSaveWithOptions(filename, &options, &info, &variables) == READSAVE_ARGUMENTS, "conversion to Int32 accepted");
+    freeVariableList(&variables);
+    freeSaveInfo(&info);
+
+    return;
+}
+
+// Decimates values, of dims in IDL order, one source element at a time
+static void naiveDecimate(double *values, long nDims, long *dims, long *factors, int mode, double *out, long *outDims, long *nOut)
+{
+    long nElements = 1;
+    *nOut = 1;
+    for (long d = 0; d < nDims; d++)
+    {
+        nElements *= dims[d];
+        outDims[d] = (dims[d] + factors[d] - 1) / factors[d];
+        *nOut *= outDims[d];
+    }
+    long counts[256] = {0};
+    for (long o = 0; o < *nOut; o++)
+        out[o] = 0;
+    long rest = 0;
+    long o = 0;
+    long outStride = 0;
+    bool kept = false;
+    for (long i = 0; i < nElements; i++)
+    {
+        rest = i;
+        o = 0;
+        outStride = 1;
+        kept = true;
+        for (long d = 0; d < nDims; d++)
+        {
+            o += (rest % dims[d]) / factors[d] * outStride;
+            kept = kept && (rest % dims[d]) % factors[d] == 0;
+            outStride *= outDims[d];
+            rest /= dims[d];
+        }
+        if (mode == DecimationStride && kept)
+            out[o] = values[i];
+        else if (mode == DecimationBlockMean && !isnan(values[i]))
+        {
+            out[o] += values[i];
+            counts[o]++;
+        }
+    }
+    for (long k = 0; mode == DecimationBlockMean && k < *nOut; k++)
+        out[k] = counts[k] > 0 ? out[k] / counts[k] : NAN;
+
+    return;
+}
+
+// Decimates array name of the view and compares with naiveDecimate()
+static void checkDecimated(SaveView *view, char *name, long dataType, double *values, long nDims, long *dims, long *factors, int nFactors, int mode)
+{
+    long allFactors[3] = {1, 1, 1};
+    for (int d = 0; d < nFactors; d++)
+        allFactors[d] = factors[d];
+    double expected[256] = {0};
+    long outDims[3] = {0};
+    long nOut = 0;
+    naiveDecimate(values, nDims, dims, allFactors, mode, expected, outDims, &nOut);
+
+    Variable decimated = {0};
+    int status = decimateVariable(view, name, 0, factors, nFactors, mode, &decimated);
+    CHECK(status == READSAVE_OK, "decimating %s, mode %d: status %d", name, mode, status);
+    if (status != READSAVE_OK)
+        return;
+    CHECK(decimated.arrayInfo.nElements == nOut && decimated.arrayInfo.nDims == nDims, "decimated %s, mode %d: %ld elements, expected %ld", name, mode, decimated.arrayInfo.nElements, nOut);
+    for (long d = 0; d < nDims; d++)
+        CHECK(decimated.arrayInfo.dims[d] == outDims[d], "decimated %s, mode %d: dim %ld is %ld, expected %ld", name, mode, d, decimated.arrayInfo.dims[d], outDims[d]);
+    CHECK(decimated.dataType == (mode == DecimationBlockMean ? DataTypeDouble : dataType), "decimated %s, mode %d: type %ld", name, mode, decimated.dataType);
+    double value = 0;
+    for (long i = 0; decimated.arrayInfo.nElements == nOut && i < nOut; i++)
+    {
+        value = decimated.dataType == DataTypeInt16 ? ((int16_t*)decimated.data)[i] : ((double*)decimated.data)[i];
+        CHECK(value == expected[i] || (isnan(value) && isnan(expected[i])), "decimated %s, mode %d, element %ld: %g, expected %g", name, mode, i, value, expected[i]);
+    }
+    freeVariable(&decimated);
+
+    return;
+}
+
+// Stride and block-mean decimation of arrays whose dims are not multiples
+// of the factors, with NaN values and an edge block holding only NaN
+static void checkDecimation(char *filename)
+{
+    long gridDims[2] = {7, 5};
+    double grid[35] = {0};
+    for (long i = 0; i < 35; i++)
+        grid[i] = i % 7 + 10 * (i / 7);
+    // In a full block, and alone in the corner edge block
+    grid[0] = NAN;
+    grid[34] = NAN;
+    long cubeDims[3] = {5, 4, 3};
+    int16_t cube[60] = {0};
+    double cubeValues[60] = {0};
+    for (long i = 0; i < 60; i++)
+    {
+        cube[i] = (int16_t)(i * 37 % 101 - 50);
+        cubeValues[i] = cube[i];
+    }
+    Variable vars[2] = {arrayVariable("GRID", DataTypeDouble, grid, 2, gridDims), arrayVariable("CUBE", DataTypeInt16, cube, 3, cubeDims)};
+    SaveWriter writer = {0};
+    CHECK(writeSaveOpen(filename, &writer) == READSAVE_OK, "writeSaveOpen() failed");
+    for (int v = 0; v < 2; v++)
+        CHECK(writeVariable(&writer, &vars[v]) == READSAVE_OK, "%s: writeVariable() failed", vars[v].name);
+    CHECK(writeSaveClose(&writer) == READSAVE_OK, "writeSaveClose() failed");
+
+    SaveView view = {0};
+    CHECK(openSaveView(filename, &view) == READSAVE_OK, "openSaveView() failed");
+    if (view.bytes == NULL)
+        return;
+
+    long gridFactors[2] = {3, 2};
+    long wideFactors[1] = {10};
+    long cubeFactors[2] = {2, 3};
+    int modes[2] = {DecimationStride, DecimationBlockMean};
+    for (int m = 0; m < 2; m++)
+    {
+        checkDecimated(&view, "GRID", DataTypeDouble, grid, 2, gridDims, gridFactors, 2, modes[m]);
+        // A factor larger than the dimension leaves one block
+        checkDecimated(&view, "GRID", DataTypeDouble, grid, 2, gridDims, wideFactors, 1, modes[m]);
+        // The last dimension has no factor and is kept
+        checkDecimated(&view, "CUBE", DataTypeInt16, cubeValues, 3, cubeDims, cubeFactors, 2, modes[m]);
+    }
+
+    Variable decimated = {0};
+    long zero[1] = {0};
+    CHECK(decimateVariable(&view, "GRID", 0, zero, 1, DecimationStride, &decimated) == READSAVE_ARGUMENTS, "zero factor accepted");
+    CHECK(decimateVariable(&view, "GRID", 0, gridFactors, 2, 7, &decimated) == READSAVE_ARGUMENTS, "unknown mode accepted");
+    closeSaveView(&view);
+
+    return;
+}
+
+#define N_VIRTUAL 3
+
+// Writes part f of a virtual dataset: IMG, Int32 4 x nSteps[f], holds its
+// global index; SKY holds nSteps[f] elements g with T = g and a 3 x 2 ELEV
+// holding 10 * g + j. With wrongLayout, the dims of both differ.
+static void writeVirtualPart(char *filename, long firstStep, long nSteps, bool wrongLayout)
+{
+    long imgDims[2] = {wrongLayout ? 5 : 4, nSteps};
+    long elevDims[2] = {wrongLayout ? 2 : 3, wrongLayout ? 3 : 2};
+    int32_t img[5 * 8] = {0};
+    for (long i = 0; i < imgDims[0] * nSteps; i++)
+        img[i] = (int32_t)(firstStep * imgDims[0] + i);
+    double t[8] = {0};
+    int16_t elev[8][6] = {0};
+    Variable tags[8][2];
+    Variable elements[8];
+    bzero(tags, sizeof(tags));
+    bzero(elements, sizeof(elements));
+    for (long e = 0; e < nSteps; e++)
+    {
+        t[e] = (double)(firstStep + e);
+        for (int j = 0; j < 6; j++)
+            elev[e][j] = (int16_t)(10 * (firstStep + e) + j);
+        tags[e][0] = scalarVariable("T", DataTypeDouble, &t[e]);
+        tags[e][1] = arrayVariable("ELEV", DataTypeInt16, elev[e], 2, elevDims);
+        elements[e].isStructure = true;
+        elements[e].dataType = DataTypeStructure;
+        elements[e].structInfo.nTags = 2;
+        elements[e].data = tags[e];
+    }
+    Variable sky = {0};
+    sky.name = "SKY";
+    sky.dataType = DataTypeStructure;
+    sky.isStructure = true;
+    sky.isArray = true;
+    sky.arrayInfo.nElements = nSteps;
+    sky.arrayInfo.nDims = 1;
+    sky.arrayInfo.dims[0] = nSteps;
+    sky.data = elements;
+    Variable image = arrayVariable("IMG", DataTypeInt32, img, 2, imgDims);
+
+    SaveWriter writer = {0};
+    CHECK(writeSaveOpen(filename, &writer) == READSAVE_OK, "writeSaveOpen() failed");
+    CHECK(writeVariable(&writer, &image) == READSAVE_OK, "IMG: writeVariable() failed");
+    CHECK(writeVariable(&writer, &sky) == READSAVE_OK, "SKY: writeVariable() failed");
+    CHECK(writeSaveClose(&writer) == READSAVE_OK, "writeSaveClose() failed");
+
+    return;
+}
+
+// Opens the files as one dataset and expects it to fail on file failedFile
+static void checkVirtualFailure(char **files, char *name, int expected, long failedFile, char *where)
+{
+    VirtualDataset dataset = {0};
+    int status = openVirtualDataset(files, N_VIRTUAL, name, 2, &dataset);
+    CHECK(status == expected && dataset.failedFile == failedFile, "%s %s: status %d on file %ld, expected %d on file %ld", where, name, status, dataset.failedFile, expected, failedFile);
+    closeVirtualDataset(&dataset);
+
+    return;
+}
+
+// Arrays and a structure array tag concatenated across files, read in
+// slices that span file boundaries
+static void checkVirtualDataset(void)
+{
+    char paths[N_VIRTUAL + 1][32] = {0};
+    long nSteps[N_VIRTUAL] = {3, 2, 4};
+    long firstStep = 0;
+    for (int f = 0; f <= N_VIRTUAL; f++)
+    {
+        snprintf(paths[f], sizeof(paths[f]), "/tmp/readsave_virtualXXXXXX");
+        int fd = mkstemp(paths[f]);
+        CHECK(fd >= 0, "Unable to create a temporary file");
+        if (fd < 0)
+            return;
+        close(fd);
+        // The last file is an incompatible copy of the second
+        writeVirtualPart(paths[f], f < N_VIRTUAL ? firstStep : nSteps[0], f < N_VIRTUAL ? nSteps[f] : nSteps[1], f == N_VIRTUAL);
+        if (f < N_VIRTUAL)
+            firstStep += nSteps[f];
+    }
+    char *files[N_VIRTUAL] = {paths[0], paths[1], paths[2]};
+
+    VirtualDataset dataset = {0};
+    int status = openVirtualDataset(files, N_VIRTUAL, "IMG", 2, &dataset);
+    CHECK(status == READSAVE_OK, "virtual IMG: status %d", status);
+    CHECK(!dataset.isStructureTag && dataset.dataType == DataTypeInt32 && dataset.nDims == 2 && dataset.dims[0] == 4 && dataset.dims[1] == firstStep && dataset.nElements == 4 * firstStep && dataset.failedFile == -1, "virtual IMG: wrong shape");
+    CHECK(dataset.nFiles == N_VIRTUAL && dataset.files[1].first == 12 && dataset.files[1].nElements == 8 && dataset.files[2].first == 20, "virtual IMG: wrong file extents");
+    int32_t img[36] = {0};
+    // From the middle of the first file to the middle of the last
+    long starts[3] = {10, 0, 12};
+    long counts[3] = {16, 36, 8};
+    for (int s = 0; status == READSAVE_OK && s < 3; s++)
+    {
+        bzero(img, sizeof(img));
+        CHECK(readVirtualSlice(&dataset, starts[s], counts[s], img, 1 + s) == READSAVE_OK, "virtual IMG: slice %ld, %ld failed", starts[s], counts[s]);
+        for (long i = 0; i < counts[s]; i++)
+            CHECK(img[i] == starts[s] + i, "virtual IMG: value %ld is %d", starts[s] + i, img[i]);
+    }
+    CHECK(readVirtualSlice(&dataset, 30, 7, img, 1) == READSAVE_ARGUMENTS, "virtual IMG: slice past the end accepted");
+    closeVirtualDataset(&dataset);
+
+    status = openVirtualDataset(files, N_VIRTUAL, "SKY.ELEV", 2, &dataset);
+    CHECK(status == READSAVE_OK, "virtual SKY.ELEV: status %d", status);
+    CHECK(dataset.isStructureTag && dataset.dataType == DataTypeInt16 && dataset.nDims == 3 && dataset.dims[0] == 3 && dataset.dims[1] == 2 && dataset.dims[2] == firstStep && dataset.nElementsPerStep == 6, "virtual SKY.ELEV: wrong shape");
+    int16_t elev[54] = {0};
+    if (status == READSAVE_OK)
+    {
+        // Starts inside the second element of the first file, ends inside the last file
+        CHECK(readVirtualSlice(&dataset, 8, 35, elev, 2) == READSAVE_OK, "virtual SKY.ELEV: slice failed");
+        for (long v = 8; v < 8 + 35; v++)
+            CHECK(elev[v - 8] == 10 * (v / 6) + v % 6, "virtual SKY.ELEV: value %ld is %d", v, elev[v - 8]);
+    }
+    closeVirtualDataset(&dataset);
+
+    status = openVirtualDataset(files, N_VIRTUAL, "SKY.T", 1, &dataset);
+    CHECK(status == READSAVE_OK && dataset.nDims == 1 && dataset.dims[0] == firstStep, "virtual SKY.T: status %d", status);
+    double t[9] = {0};
+    CHECK(status == READSAVE_OK && readVirtualSlice(&dataset, 2, 5, t, 2) == READSAVE_OK && t[0] == 2 && t[4] == 6, "virtual SKY.T: slice differs");
+    closeVirtualDataset(&dataset);
+
+    // The incompatible file in the middle
+    files[1] = paths[N_VIRTUAL];
+    checkVirtualFailure(files, "IMG", READSAVE_ARGUMENTS, 1, "incompatible file");
+    checkVirtualFailure(files, "SKY.ELEV", READSAVE_ARGUMENTS, 1, "incompatible file");
+    // T is the same in every file
+    status = openVirtualDataset(files, N_VIRTUAL, "SKY.T", 1, &dataset);
+    CHECK(status == READSAVE_ARGUMENTS && dataset.failedFile == 1, "incompatible structure layout accepted for SKY.T");
+    closeVirtualDataset(&dataset);
+    files[1] = paths[1];
+    files[2] = "/tmp/readsave_virtual_missing.sav";
+    checkVirtualFailure(files, "IMG", READSAVE_INPUT_FILE, 2, "missing file");
+    files[2] = paths[2];
+    checkVirtualFailure(files, "NOPE", READSAVE_VARIABLE_NOT_FOUND, 0, "unknown variable");
+    checkVirtualFailure(files, "SKY.NOPE", READSAVE_VARIABLE_NOT_FOUND, 0, "unknown tag");
+
+    for (int f = 0; f <= N_VIRTUAL; f++)
+        unlink(paths[f]);
+
+    return;
+}
+
+// Arrays read with rowMajor match a naive transpose of the IDL order values
+static void checkRowMajor(char *filename)
+{
+    unsigned char *data[N_TRANSPOSE] = {0};
+    long nElements[N_TRANSPOSE] = {0};
+    Variable var = {0};
+    SaveWriter writer = {0};
+    CHECK(writeSaveOpen(filename, &writer) == READSAVE_OK, "writeSaveOpen() failed");
+    for (long c = 0; c < N_TRANSPOSE; c++)
+    {
+        TransposeCase *tc = &transposeCases[c];
+        long size = transposeElementSize(tc->dataType);
+        nElements[c] = 1;
+        for (long d = 0; d < tc->nDims; d++)
+            nElements[c] *= tc->dims[d];
+        data[c] = malloc(nElements[c] * size);
+        if (data[c] == NULL)
+            continue;
+        for (long i = 0; i < nElements[c]; i++)
+            transposeValue(tc->dataType, i, data[c] + i * size);
+        bzero(&var, sizeof(var));
+        var.name = tc->name;
+        var.dataType = tc->dataType;
+        var.isArray = true;
+        var.arrayInfo.nElements = nElements[c];
+        var.arrayInfo.nDims = tc->nDims;
+        memcpy(var.arrayInfo.dims, tc->dims, tc->nDims * sizeof(long));
+        var.data = data[c];
+        CHECK(writeVariable(&writer, &var) == READSAVE_OK, "%s: writeVariable() failed", tc->name);
+    }
+    CHECK(writeSaveClose(&writer) == READSAVE_OK, "writeSaveClose() failed");
+
+    ReadSaveOptions options = {0};
+    options.rowMajor = true;
+    options.nThreads = 4;
+    SaveInfo info = {0};
+    VariableList variables = {0};
+    int status = readSaveWithOptions(filename, &options, &info, &variables);
+    CHECK(status == READSAVE_OK, "row-major: readSaveWithOptions() status %d", status);
+    long index[4] = {0};
+    long rest = 0;
+    long rowMajorIndex = 0;
+    for (long c = 0; c < N_TRANSPOSE; c++)
+    {
+        TransposeCase *tc = &transposeCases[c];
+        long size = transposeElementSize(tc->dataType);
+        Variable *read = findByName(&variables, tc->name);
+        CHECK(read != NULL && read->rowMajor && read->data != NULL && read->arrayInfo.nElements == nElements[c] && read->arrayInfo.nDims == tc->nDims, "row-major %s: missing or wrong shape", tc->name);
+        if (read == NULL || read->data == NULL || data[c] == NULL)
+            continue;
+        for (long d = 0; d < tc->nDims; d++)
+            CHECK(read->arrayInfo.dims[d] == tc->dims[d], "row-major %s: dim %ld changed", tc->name, d);
+        long nDiffering = 0;
+        for (long i = 0; i < nElements[c]; i++)
+        {
+            rest = i;
+            for (long d = 0; d < tc->nDims; d++)
+            {
+                index[d] = rest % tc->dims[d];
+                rest /= tc->dims[d];
+            }
+            rowMajorIndex = 0;
+            for (long d = 0; d < tc->nDims; d++)
+                rowMajorIndex = rowMajorIndex * tc->dims[d] + index[d];
+            if (memcmp((unsigned char*)read->data + rowMajorIndex * size, data[c] + i * size, size) != 0)
+                nDiffering++;
+        }
+        CHECK(nDiffering == 0, "row-major %s: %ld elements differ from the transpose", tc->name, nDiffering);
+    }
+    freeVariableList(&variables);
+    freeSaveInfo(&info);
+    for (long c = 0; c < N_TRANSPOSE; c++)
+        free(data[c]);
+
+    return;
+}
+
+// Arrays decoded in C order are refused rather than written transposed
+static void checkRowMajorRefused(char *filename)
+{
+    double values[6] = {0, 1, 2, 3, 4, 5};
+    Variable var = {0};
+    var.name = "RM";
+    var.dataType = DataTypeDouble;
+    var.isArray = true;
+    var.rowMajor = true;
+    var.arrayInfo.nElements = 6;
+    var.arrayInfo.nDims = 2;
+    var.arrayInfo.dims[0] = 2;
+    var.arrayInfo.dims[1] = 3;
+    var.data = values;
+    Variable tag = var;
+    tag.name = "T";
+    Variable element = {0};
+    element.isStructure = true;
+    element.dataType = DataTypeStructure;
+    element.structInfo.nTags = 1;
+    element.data = &tag;
+    Variable structure = {0};
+    structure.name = "S";
+    structure.dataType = DataTypeStructure;
+    structure.isStructure = true;
+    structure.isArray = true;
+    structure.arrayInfo.nElements = 1;
+    structure.arrayInfo.nDims = 1;
+    structure.arrayInfo.dims[0] = 1;
+    structure.data = &element;
+
+    SaveWriter writer = {0};
+    CHECK(writeSaveOpen(filename, &writer) == READSAVE_OK, "writeSaveOpen() failed");
+    CHECK(writeVariable(&writer, &var) == READSAVE_ARGUMENTS, "row-major array written");
+    CHECK(writeVariable(&writer, &structure) == READSAVE_ARGUMENTS, "row-major tag written");
+    CHECK(writeSaveClose(&writer) == READSAVE_OK, "writeSaveClose() failed");
+
+    VariableList variables = {0};
+    variables.variableList = &var;
+    variables.nVariables = 1;
+    CHECK(writeSaveCache(filename, &variables, NULL) == READSAVE_ARGUMENTS, "row-major array cached");
+    variables.variableList = &structure;
+    CHECK(writeSaveCache(filename, &variables, NULL) == READSAVE_ARGUMENTS, "row-major tag cached");
+
+    return;
+}
+
+// Replaces the first big-endian 32-bit pattern in the file
+static bool patchWords(unsigned char *bytes, long nBytes, uint32_t *from, uint32_t *to, int nWords)
+{
+    uint32_t find[8] = {0};
+    uint32_t replace[8] = {0};
+    for (int w = 0; w < nWords; w++)
+    {
+        find[w] = __builtin_bswap32(from[w]);
+        replace[w] = __builtin_bswap32(to[w]);
+    }
+    for (long offset = 0; offset + 4 * nWords <= nBytes; offset += 4)
+        if (memcmp(bytes + offset, find, 4 * nWords) == 0)
+        {
+            memcpy(bytes + offset, replace, 4 * nWords);
+            return true;
+        }
+
+    return false;
+}
+
+static bool writeFileBytes(char *filename, unsigned char *bytes, long nBytes)
+{
+    FILE *file = fopen(filename, "wb");
+    if (file == NULL)
+        return false;
+    bool written = fwrite(bytes, 1, nBytes, file) == (size_t)nBytes;
+
+    return fclose(file) == 0 && written;
+}
+
+// Reads bytes written to filename; returns the readSave() status
+static int readBytes(char *filename, unsigned char *bytes, long nBytes)
+{
+    CHECK(writeFileBytes(filename, bytes, nBytes), "writing %s failed", filename);
+    SaveInfo info = {0};
+    VariableList variables = {0};
+    int status = readSave(filename, &info, &variables);
+    freeVariableList(&variables);
+    freeSaveInfo(&info);
+
+    return status;
+}
+
+// Damaged record offsets, array extents and truncated files are reported, not read past
+static void checkCorruptFile(char *filename)
+{
+    int32_t values[N_ARRAY] = {0, 1, 2, 3, 4};
+    Variable var = {0};
+    var.name = "A";
+    var.dataType = DataTypeInt32;
+    var.isArray = true;
+    var.arrayInfo.nElements = N_ARRAY;
+    var.arrayInfo.nDims = 1;
+    var.arrayInfo.dims[0] = N_ARRAY;
+    var.data = values;
+    Variable scalar = scalarVariable("B", DataTypeInt32, &valueInt32);
+    SaveWriter writer = {0};
+    CHECK(writeSaveOpen(filename, &writer) == READSAVE_OK, "writeSaveOpen() failed");
+    CHECK(writeVariable(&writer, &var) == READSAVE_OK, "writeVariable() failed");
+    CHECK(writeVariable(&writer, &scalar) == READSAVE_OK, "writeVariable() failed");
+    CHECK(writeSaveClose(&writer) == READSAVE_OK, "writeSaveClose() failed");
+
+    FILE *file = fopen(filename, "rb");
+    unsigned char original[4096] = {0};
+    long nBytes = file == NULL ? 0 : (long)fread(original, 1, sizeof(original), file);
+    if (file != NULL)
+        fclose(file);
+    CHECK(nBytes > 0 && readBytes(filename, original, nBytes) == READSAVE_OK, "corrupt file: unpatched file not read");
+
+    // The header of the record holding A
+    long recordStart = 4;
+    long recordType = RecordTypeNotHandled;
+    long nextOffset = 0;
+    long offset = 0;
+    while (recordStart > 0 && recordStart < nBytes - 16)
+    {
+        offset = recordStart;
+        readRecordHeader(original, nBytes, &offset, &recordType, &nextOffset);
+        if (recordType == RecordTypeVariable || nextOffset <= recordStart)
+            break;
+        recordStart = nextOffset;
+    }
+    CHECK(recordType == RecordTypeVariable, "corrupt file: variable record not found");
+    if (recordType != RecordTypeVariable)
+        return;
+
+    unsigned char bytes[4096] = {0};
+    uint32_t header[2] = {RecordTypeVariable, (uint32_t)nextOffset};
+    uint32_t badHeader[2] = {RecordTypeVariable, 0};
+    long badOffsets[3] = {nBytes + 400, recordStart, nextOffset - 8};
+    int expected[3] = {READSAVE_CORRUPT_RECORD, READSAVE_CORRUPT_RECORD, READSAVE_READ_ARRAY};
+    int status = READSAVE_OK;
+    for (int i = 0; i < 3; i++)
+    {
+        memcpy(bytes, original, nBytes);
+        badHeader[1] = (uint32_t)badOffsets[i];
+        CHECK(patchWords(bytes, nBytes, header, badHeader, 2), "corrupt file: record header not found");
+        status = readBytes(filename, bytes, nBytes);
+        CHECK(status == expected[i], "next record offset %ld: status %d, expected %d", badOffsets[i], status, expected[i]);
+    }
+
+    // Array descriptor: start, bytes per element, bytes, elements, dims
+    uint32_t descriptor[5] = {8, sizeof(int32_t), N_ARRAY * sizeof(int32_t), N_ARRAY, 1};
+    uint32_t longer[5] = {8, sizeof(int32_t), 1000 * sizeof(int32_t), 1000, 1};
+    uint32_t negative[5] = {8, sizeof(int32_t), N_ARRAY * sizeof(int32_t), (uint32_t)-1, 1};
+    uint32_t *badDescriptors[2] = {longer, negative};
+    for (int i = 0; i < 2; i++)
+    {
+        memcpy(bytes, original, nBytes);
+        CHECK(patchWords(bytes, nBytes, descriptor, badDescriptors[i], 5), "corrupt file: array descriptor not found");
+        status = readBytes(filename, bytes, nBytes);
+        CHECK(status == READSAVE_READ_ARRAY, "array extent %d: status %d", i, status);
+    }
+
+    // Cut anywhere inside A's record, the file no longer holds the record
+    for (long length = recordStart + 16; length < nextOffset; length++)
+    {
+        status = readBytes(filename, original, length);
+        CHECK(status == READSAVE_CORRUPT_RECORD || status == READSAVE_READ_ARRAY, "truncated to %ld bytes: status %d", length, status);
+    }
+    for (long length = 0; length < nBytes; length++)
+        readBytes(filename, original, length);
+
+    return;
+}
+
+// Writes an Int32 scalar and an Int32 tag holding 5, then relabels both as dataType
+static void checkUnwritableType(char *filename, long dataType)
+{
+    Variable var = scalarVariable("P", dataType, &valueInt32);
+    SaveWriter writer = {0};
+    CHECK(writeSaveOpen(filename, &writer) == READSAVE_OK, "writeSaveOpen() failed");
+    CHECK(writeVariable(&writer, &var) == READSAVE_ARGUMENTS, "type %ld: writeVariable() did not refuse it", dataType);
+
+    int32_t heapIndex = 5;
+    var = scalarVariable("P", DataTypeInt32, &heapIndex);
+    Variable tag = scalarVariable("T", DataTypeInt32, &heapIndex);
+    Variable element = {0};
+    element.isStructure = true;
+    element.dataType = DataTypeStructure;
+    element.structInfo.nTags = 1;
+    element.data = &tag;
+    Variable structure = {0};
+    structure.name = "S";
+    structure.dataType = DataTypeStructure;
+    structure.isStructure = true;
+    structure.isArray = true;
+    structure.arrayInfo.nElements = 1;
+    structure.arrayInfo.nDims = 1;
+    structure.arrayInfo.dims[0] = 1;
+    structure.data = &element;
+    CHECK(writeVariable(&writer, &var) == READSAVE_OK, "writeVariable() failed");
+    CHECK(writeVariable(&writer, &structure) == READSAVE_OK, "writeVariable() failed");
+    CHECK(writeSaveClose(&writer) == READSAVE_OK, "writeSaveClose() failed");
+
+    FILE *file = fopen(filename, "r+b");
+    unsigned char bytes[4096] = {0};
+    long nBytes = file == NULL ? 0 : (long)fread(bytes, 1, sizeof(bytes), file);
+    // Variable: type, flags, start of data. Tag descriptor: offset, type, flags.
+    uint32_t scalarFrom[3] = {DataTypeInt32, 0, 7};
+    uint32_t scalarTo[3] = {(uint32_t)dataType, 0, 7};
+    uint32_t tagFrom[3] = {0, DataTypeInt32, 0};
+    uint32_t tagTo[3] = {0, (uint32_t)dataType, 0};
+    CHECK(patchWords(bytes, nBytes, scalarFrom, scalarTo, 3), "type %ld: variable type not found", dataType);
+    CHECK(patchWords(bytes, nBytes, tagFrom, tagTo, 3), "type %ld: tag type not found", dataType);
+    if (file != NULL)
+    {
+        rewind(file);
+        CHECK(fwrite(bytes, 1, nBytes, file) == (size_t)nBytes, "rewrite failed");
+        fclose(file);
+    }
+
+    SaveInfo info = {0};
+    VariableList variables = {0};
+    int status = readSave(filename, &info, &variables);
+    CHECK(status == READSAVE_OK, "type %ld: readSave() status %d", dataType, status);
+    Variable *structureRead = findByName(&variables, "S");
+    Variable *tagRead = structureRead != NULL && structureRead->data != NULL ? tagByName(&((Variable*)structureRead->data)[0], "T") : NULL;
+    if (dataType == DataTypeUndefined)
+    {
+        // Undefined values have no data
+        Variable *p = findByName(&variables, "P");
+        CHECK(p != NULL && p->dataType == DataTypeUndefined && p->data == NULL, "undefined scalar: unexpected data");
+        CHECK(tagRead != NULL && tagRead->dataType == DataTypeUndefined && tagRead->data == NULL, "undefined tag: unexpected data");
+    }
+    else
+    {
+        // Heap pointers and object references keep their 32-bit heap index
+        checkScalar(findByName(&variables, "P"), "P", dataType, &heapIndex, sizeof(heapIndex), true, "scalar");
+        checkScalar(tagRead, "T", dataType, &heapIndex, sizeof(heapIndex), true, "tag");
+    }
+    freeVariableList(&variables);
+    freeSaveInfo(&info);
+
+    return;
+}
+
+// Opens the cache after setting one field of a column's index entry,
+// then restores it
+static int openPatchedCache(char *cacheFile, char *columnName, size_t field, long value)
+{
+    SaveCache cache = {0};
+    int status = openSaveCache(cacheFile, &cache);
+    CacheColumn *column = status == READSAVE_OK ? findCacheColumn(&cache, columnName) : NULL;
+    CHECK(column != NULL, "cache column %s not found", columnName);
+    if (column == NULL)
+    {
+        closeSaveCache(&cache);
+        return READSAVE_OK;
+    }
+    off_t position = (unsigned char*)column - cache.bytes + field;
+    long original = 0;
+    memcpy(&original, (unsigned char*)column + field, sizeof(long));
+    closeSaveCache(&cache);
+
+    int fd = open(cacheFile, O_RDWR);
+    CHECK(fd >= 0 && pwrite(fd, &value, sizeof(long), position) == sizeof(long), "patching %s failed", cacheFile);
+    status = openSaveCache(cacheFile, &cache);
+    closeSaveCache(&cache);
+    CHECK(fd >= 0 && pwrite(fd, &original, sizeof(long), position) == sizeof(long), "restoring %s failed", cacheFile);
+    if (fd >= 0)
+        close(fd);
+
+    return status;
+}
+
+// Uncompressed column extents that do not cover their elements are refused
+static void checkCacheColumns(char *filename)
+{
+    char cacheFile[] = "/tmp/readsave_cacheXXXXXX";
+    int fd = mkstemp(cacheFile);
+    CHECK(fd >= 0, "Unable to create a temporary file");
+    if (fd < 0)
+        return;
+    close(fd);
+
+    SaveInfo info = {0};
+    VariableList variables = {0};
+    int status = readSave(filename, &info, &variables);
+    CHECK(status == READSAVE_OK, "cache: readSave() status %d", status);
+    CHECK(writeSaveCache(cacheFile, &variables, NULL) == READSAVE_OK, "writeSaveCache() failed");
+    freeVariableList(&variables);
+    freeSaveInfo(&info);
+
+    SaveCache cache = {0};
+    status = openSaveCache(cacheFile, &cache);
+    CHECK(status == READSAVE_OK, "openSaveCache() status %d", status);
+    CacheColumn *column = findCacheColumn(&cache, "LONG");
+    char *str = column != NULL ? cacheString(&cache, column, 0) : NULL;
+    CHECK(str != NULL && strcmp(str, longString) == 0, "cache: LONG differs");
+    column = findCacheColumn(&cache, "I32");
+    int32_t value = 0;
+    CHECK(column != NULL && readCacheColumn(&cache, column, 0, 1, &value, 1) == READSAVE_OK && value == valueInt32, "cache: I32 differs");
+    long nBytes = column != NULL ? column->nBytes : 0;
+    long nStringBytes = (column = findCacheColumn(&cache, "LONG")) != NULL ? column->nBytes : 0;
+    closeSaveCache(&cache);
+
+    CHECK(openPatchedCache(cacheFile, "I32", offsetof(CacheColumn, nElements), nBytes / (long)sizeof(int32_t) + 1) == READSAVE_INPUT_FILE, "numeric column longer than its data accepted");
+    CHECK(openPatchedCache(cacheFile, "I32", offsetof(CacheColumn, nElements), -1) == READSAVE_INPUT_FILE, "negative element count accepted");
+    CHECK(openPatchedCache(cacheFile, "I32", offsetof(CacheColumn, nBytesPerElement), 2 * sizeof(int32_t)) == READSAVE_INPUT_FILE, "wrong element size accepted");
+    CHECK(openPatchedCache(cacheFile, "LONG", offsetof(CacheColumn, nElements), nStringBytes / (long)sizeof(long)) == READSAVE_INPUT_FILE, "string offsets past the column accepted");
+    CHECK(openPatchedCache(cacheFile, "LONG", offsetof(CacheColumn, nBytes), nStringBytes - 1) == READSAVE_INPUT_FILE, "unterminated string column accepted");
+    CHECK(openPatchedCache(cacheFile, "LONG", offsetof(CacheColumn, compression), SaveCacheCompressionLZ4) == READSAVE_INPUT_FILE, "compressed string column accepted");
+    CHECK(openSaveCache(cacheFile, &cache) == READSAVE_OK, "restored cache refused");
+    closeSaveCache(&cache);
+
+    unlink(cacheFile);
+
+    return;
+}
+
+// XXH64 reference values for bytes (7 * i + 3) mod 256, with seeds 0 and 2654435761
+static struct
+{
+    long nBytes;
+    uint64_t hash;
+    uint64_t seededHash;
+
+} hashVectors[] = {
+    {0, 0xef46db3751d8e999ULL, 0xac75fda2929b17efULL},
+    {3, 0x31d2363f52e564c9ULL, 0x96d2a5e583ddd738ULL},
+    {4, 0x9bb64b7d66ee9fdaULL, 0x4a862fbb4b73776eULL},
+    {8, 0xdab99d95c6f90092ULL, 0xc6e75e2cbd8e07eeULL},
+    {31, 0xa2aa5f33cc4a6119ULL, 0x381822f33376d6b6ULL},
+    {32, 0x23c3c17ef790fd97ULL, 0x9abd315470ac276aULL},
+    {100, 0xa61f8d4c170fe531ULL, 0x86f549ede5ac87e2ULL},
+};
+
+// hashBytes() against XXH64, and recordHash only when asked for
+static void checkHashes(char *filename)
+{
+    unsigned char bytes[101] = {0};
+    for (int i = 0; i < 100; i++)
+        bytes[i + 1] = (unsigned char)(7 * i + 3);
+    for (size_t v = 0; v < sizeof(hashVectors) / sizeof(hashVectors[0]); v++)
+    {
+        // Unaligned on purpose
+        CHECK(hashBytes(bytes + 1, hashVectors[v].nBytes, 0) == hashVectors[v].hash, "hashBytes() of %ld bytes differs from XXH64", hashVectors[v].nBytes);
+        CHECK(hashBytes(bytes + 1, hashVectors[v].nBytes, 2654435761ULL) == hashVectors[v].seededHash, "seeded hashBytes() of %ld bytes differs from XXH64", hashVectors[v].nBytes);
+    }
+
+    Variable first = scalarVariable("FIRST", DataTypeDouble, &valueDouble);
+    Variable second = scalarVariable("SECOND", DataTypeDouble, &valueDouble);
+    Variable other = scalarVariable("OTHER", DataTypeFloat, &valueFloat);
+    SaveWriter writer = {0};
+    CHECK(writeSaveOpen(filename, &writer) == READSAVE_OK, "writeSaveOpen() failed");
+    CHECK(writeVariable(&writer, &first) == READSAVE_OK, "writeVariable() failed");
+    CHECK(writeVariable(&writer, &second) == READSAVE_OK, "writeVariable() failed");
+    CHECK(writeVariable(&writer, &other) == READSAVE_OK, "writeVariable() failed");
+    CHECK(writeSaveClose(&writer) == READSAVE_OK, "writeSaveClose() failed");
+
+    SaveInfo info = {0};
+    VariableList variables = {0};
+    CHECK(readSave(filename, &info, &variables) == READSAVE_OK, "hashes: readSave() failed");
+    for (size_t i = 0; i < variables.nVariables; i++)
+        CHECK(variables.variableList[i].recordHash == 0, "%s: hashed without hashRecords", variables.variableList[i].name);
+    freeVariableList(&variables);
+    freeSaveInfo(&info);
+
+    ReadSaveOptions options = {0};
+    options.hashRecords = true;
+    CHECK(readSaveWithOptions(filename, &options, &info, &variables) == READSAVE_OK, "hashes: readSaveWithOptions() failed");
+    Variable *firstRead = findByName(&variables, "FIRST");
+    Variable *secondRead = findByName(&variables, "SECOND");
+    Variable *otherRead = findByName(&variables, "OTHER");
+    CHECK(firstRead != NULL && secondRead != NULL && otherRead != NULL, "hashes: variables missing");
+    if (firstRead != NULL && secondRead != NULL && otherRead != NULL)
+    {
+        CHECK(firstRead->recordHash != 0 && firstRead->recordHash == secondRead->recordHash, "equal records hash differently");
+        CHECK(firstRead->recordHash != otherRead->recordHash, "different records hash equal");
+    }
+    freeVariableList(&variables);
+    freeSaveInfo(&info);
+
+    return;
+}
+
+int main(void)
+{
+    initValues();
+
+    char filename[] = "/tmp/readsave_roundtripXXXXXX";
+    int fd = mkstemp(filename);
+    if (fd < 0)
+    {
+        fprintf(stderr, "Unable to create a temporary file\n");
+        return EXIT_FAILURE;
+    }
+    close(fd);
+
+    int status = writeTestFile(filename);
+    CHECK(status == READSAVE_OK, "writing %s: status %d", filename, status);
+    if (status == READSAVE_OK)
+    {
+        checkTestFile(filename);
+        checkProjectedStructure(filename);
+        checkPredicates(filename);
+        checkCacheColumns(filename);
+    }
+
+    checkArrays(filename);
+    checkLargeStringStructure(filename);
+    checkRowMajor(filename);
+    checkConversion(filename);
+    checkDecimation(filename);
+    checkVirtualDataset();
+    checkRowMajorRefused(filename);
+    checkCorruptFile(filename);
+    checkHashes(filename);
+
+    checkUnwritableType(filename, DataTypeHeapPointer);
+    checkUnwritableType(filename, DataTypeObjectReference);
+    checkUnwritableType(filename, DataTypeUndefined);
+
+    unlink(filename);
+
+    if (nFailures > 0)
+    {
+        fprintf(stderr, "%d checks failed\n", nFailures);
+        return EXIT_FAILURE;
+    }
+    fprintf(stdout, "All round-trip checks passed\n");
+
+    return EXIT_SUCCESS;
+}